@@ -2,11 +2,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
 #include <script/signingprovider.h>
 
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -86,3 +88,45 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// Microbenchmarks for the coins cache map: fill a map the way a cache filling
+// up during a sync does, look up every entry, and empty it the way BatchWrite
+// does. Compares std::unordered_map, which CCoinsMap used to be, with
+// nodepoolmap.
+template <typename Map>
+static void CoinsMapCycle(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints;
+    for (uint32_t i = 0; i < 10000; i++) {
+        outpoints.emplace_back(ArithToUint256(arith_uint256(i / 4 + 1)), i % 4);
+    }
+    Coin coin(CTxOut(50 * COIN, CScript() << OP_TRUE), 1, false);
+
+    while (state.KeepRunning()) {
+        Map map;
+        for (const COutPoint& outpoint : outpoints) {
+            CCoinsCacheEntry& entry = map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>()).first->second;
+            entry.coin = coin;
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+        CAmount total = 0;
+        for (const COutPoint& outpoint : outpoints) {
+            total += map.find(outpoint)->second.coin.out.nValue;
+        }
+        assert(total == 10000 * 50 * COIN);
+        for (auto it = map.begin(); it != map.end(); it = map.erase(it)) {}
+    }
+}
+
+static void CoinsMapStd(benchmark::State& state)
+{
+    CoinsMapCycle<std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>>(state);
+}
+
+static void CoinsMapNodePool(benchmark::State& state)
+{
+    CoinsMapCycle<nodepoolmap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>>(state);
+}
+
+BENCHMARK(CoinsMapStd, 20);
+BENCHMARK(CoinsMapNodePool, 20);
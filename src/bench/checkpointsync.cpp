@@ -0,0 +1,62 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <checkpointsync.h>
+#include <validation.h>
+
+#include <vector>
+
+// Validate a new sync-checkpoint that is nDistance blocks above the current
+// one, as happens when a checkpoint message arrives after a long outage or
+// a deep reorg.
+static void ValidateSyncCheckpointAtDistance(benchmark::State& state, int nDistance)
+{
+    std::vector<uint256> hashes(nDistance + 1);
+    std::vector<CBlockIndex> chain(nDistance + 1);
+    {
+        LOCK(cs_main);
+        for (int i = 0; i <= nDistance; i++) {
+            hashes[i] = ArithToUint256(arith_uint256(i + 1) << 128);
+            chain[i].phashBlock = &hashes[i];
+            chain[i].pprev = i ? &chain[i - 1] : nullptr;
+            chain[i].nHeight = i;
+            chain[i].BuildSkip();
+            ::BlockIndex().emplace(hashes[i], &chain[i]);
+        }
+    }
+
+    uint256 hashSaved;
+    {
+        LOCK(cs_hashSyncCheckpoint);
+        hashSaved = hashSyncCheckpoint;
+        hashSyncCheckpoint = hashes.front();
+    }
+
+    while (state.KeepRunning()) {
+        bool ret = ValidateSyncCheckpoint(hashes.back());
+        assert(ret);
+    }
+
+    {
+        LOCK(cs_hashSyncCheckpoint);
+        hashSyncCheckpoint = hashSaved;
+    }
+    UnloadSyncCheckpoint();
+    {
+        LOCK(cs_main);
+        for (const uint256& hash : hashes) {
+            ::BlockIndex().erase(hash);
+        }
+    }
+}
+
+static void ValidateSyncCheckpoint1000(benchmark::State& state) { ValidateSyncCheckpointAtDistance(state, 1000); }
+static void ValidateSyncCheckpoint100000(benchmark::State& state) { ValidateSyncCheckpointAtDistance(state, 100000); }
+
+BENCHMARK(ValidateSyncCheckpoint1000, 500 * 1000);
+BENCHMARK(ValidateSyncCheckpoint100000, 500 * 1000);
@@ -26,7 +26,7 @@ static void addCoin(const CAmount& nValue, const CWallet& wallet, std::vector<st
 // same one over and over isn't too useful. Generating random isn't useful
 // either for measurements."
 // (https://github.com/bitcoin/bitcoin/issues/7883#issuecomment-224807484)
-static void CoinSelection(benchmark::State& state)
+static void CoinSelectionWithCoins(benchmark::State& state, const int num_coins)
 {
     auto chain = interfaces::MakeChain();
     const CWallet wallet(chain.get(), WalletLocation(), WalletDatabase::CreateDummy());
@@ -34,7 +34,7 @@ static void CoinSelection(benchmark::State& state)
     LOCK(wallet.cs_wallet);
 
     // Add coins.
-    for (int i = 0; i < 1000; ++i) {
+    for (int i = 0; i < num_coins; ++i) {
         addCoin(1000 * COIN, wallet, wtxs);
     }
     addCoin(3 * COIN, wallet, wtxs);
@@ -59,6 +59,9 @@ static void CoinSelection(benchmark::State& state)
     }
 }
 
+static void CoinSelection(benchmark::State& state) { CoinSelectionWithCoins(state, 1000); }
+static void CoinSelectionLargeWallet(benchmark::State& state) { CoinSelectionWithCoins(state, 100000); }
+
 typedef std::set<CInputCoin> CoinSet;
 static auto testChain = interfaces::MakeChain();
 static const CWallet testWallet(testChain.get(), WalletLocation(), WalletDatabase::CreateDummy());
@@ -107,4 +110,5 @@ static void BnBExhaustion(benchmark::State& state)
 }
 
 BENCHMARK(CoinSelection, 650);
+BENCHMARK(CoinSelectionLargeWallet, 5);
 BENCHMARK(BnBExhaustion, 650);
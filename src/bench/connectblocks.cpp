@@ -0,0 +1,61 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <blockprefetch.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <test/util.h>
+#include <validation.h>
+
+#include <boost/thread/thread.hpp>
+
+// Reconnect a chain of blocks that are already on disk, the way a reindex
+// connects them. Every iteration connects NUM_BLOCKS blocks, so blocks/sec is
+// NUM_BLOCKS divided by the time per iteration (which also includes
+// disconnecting them again).
+
+static constexpr int NUM_BLOCKS = 100;
+
+static void ConnectBlocks(benchmark::State& state, bool prefetch)
+{
+    const CScript SCRIPT_PUB{CScript(OP_TRUE)};
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+        MineBlock(SCRIPT_PUB);
+    }
+    CBlockIndex* pindexFirst = WITH_LOCK(cs_main, return ::ChainActive()[1]);
+
+    boost::thread_group threads;
+    if (prefetch) {
+        threads.create_thread([]() { return ThreadBlockPrefetch(DEFAULT_BLOCK_PREFETCH); });
+    }
+
+    while (state.KeepRunning()) {
+        CValidationState validation_state;
+        bool ret = InvalidateBlock(validation_state, Params(), pindexFirst);
+        assert(ret);
+        WITH_LOCK(cs_main, ResetBlockFailureFlags(pindexFirst));
+        ret = ActivateBestChain(validation_state, Params());
+        assert(ret);
+        assert(WITH_LOCK(cs_main, return ::ChainActive().Height()) == NUM_BLOCKS);
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+static void ConnectBlocksSerial(benchmark::State& state)
+{
+    ConnectBlocks(state, false);
+}
+
+static void ConnectBlocksPrefetch(benchmark::State& state)
+{
+    ConnectBlocks(state, true);
+}
+
+BENCHMARK(ConnectBlocksSerial, 5);
+BENCHMARK(ConnectBlocksPrefetch, 5);
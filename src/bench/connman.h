@@ -0,0 +1,32 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_CONNMAN_H
+#define BITCOIN_BENCH_CONNMAN_H
+
+#include <net.h>
+#include <sync.h>
+
+/** Access to the internals of CConnman for the network benchmarks */
+struct CConnmanTest : public CConnman {
+    using CConnman::CConnman;
+    using CConnman::InitSocketEvents;
+    using CConnman::SocketHandler;
+
+    void AddNode(CNode& node)
+    {
+        RegisterSocketEvents(&node);
+        LOCK(cs_vNodes);
+        vNodes.push_back(&node);
+    }
+    void StartMessageHandlers()
+    {
+        WITH_LOCK(mutexMsgProc, fMsgProcWake = false);
+        for (int i = 0; i < nMsgHandlerThreads; i++) {
+            threadMessageHandlers.emplace_back(&CConnman::ThreadMessageHandler, this, i);
+        }
+    }
+};
+
+#endif // BITCOIN_BENCH_CONNMAN_H
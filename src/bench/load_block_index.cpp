@@ -0,0 +1,126 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <memusage.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+static const int HEADERS = 100000;
+
+/** The block index layout before the arena: one heap allocation per entry, in an unordered_map */
+typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> HeapBlockMap;
+
+// Write a block tree of HEADERS headers to an in-memory block tree database.
+static void WriteBlockTree(CBlockTreeDB& blocktree)
+{
+    std::vector<CBlockIndex> chain(HEADERS);
+    std::vector<uint256> hashes(HEADERS);
+    std::vector<const CBlockIndex*> blockinfo;
+    for (int i = 0; i < HEADERS; i++) {
+        chain[i].pprev = i ? &chain[i - 1] : nullptr;
+        chain[i].nHeight = i;
+        chain[i].nTime = 1500000000 + 5 * i;
+        chain[i].nBits = 0x1e0ffff0;
+        chain[i].nNonce = i;
+        chain[i].nTx = 1;
+        chain[i].nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+        chain[i].nDataPos = 8 + 300 * i;
+        hashes[i] = CDiskBlockIndex(&chain[i]).GetBlockHash();
+        chain[i].phashBlock = &hashes[i];
+        blockinfo.push_back(&chain[i]);
+    }
+    bool ret = blocktree.WriteBatchSync({}, 0, blockinfo);
+    assert(ret);
+}
+
+static bool LoadIntoHeapBlockMap(CBlockTreeDB& blocktree, HeapBlockMap& map) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    return blocktree.LoadBlockIndexGuts(Params().GetConsensus(), [&map](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) -> CBlockIndex* {
+        if (hash.IsNull()) return nullptr;
+        HeapBlockMap::iterator mi = map.find(hash);
+        if (mi != map.end()) return mi->second;
+        CBlockIndex* pindexNew = new CBlockIndex();
+        mi = map.emplace(hash, pindexNew).first;
+        pindexNew->phashBlock = &mi->first;
+        return pindexNew;
+    });
+}
+
+static void UnloadHeapBlockMap(HeapBlockMap& map)
+{
+    for (const auto& entry : map) delete entry.second;
+    map.clear();
+}
+
+// Print the memory used per header by both layouts once, next to the timings.
+static void PrintBytesPerHeader(CBlockTreeDB& blocktree)
+{
+    static bool printed = false;
+    if (printed) return;
+    printed = true;
+
+    LOCK(cs_main);
+    HeapBlockMap heap_map;
+    bool ret = LoadIntoHeapBlockMap(blocktree, heap_map);
+    assert(ret);
+    const size_t heap_bytes = memusage::DynamicUsage(heap_map) + heap_map.size() * memusage::MallocUsage(sizeof(CBlockIndex));
+    UnloadHeapBlockMap(heap_map);
+
+    BlockManager blockman;
+    ret = blocktree.LoadBlockIndexGuts(Params().GetConsensus(), [&blockman](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return blockman.InsertBlockIndex(hash); });
+    assert(ret);
+    const size_t arena_bytes = memusage::DynamicUsage(blockman.m_block_index) + blockman.m_block_index_arena.AllocatedBytes();
+    blockman.Unload();
+
+    std::cout << "LoadBlockIndexGuts bytes per header: unordered_map + heap " << heap_bytes / HEADERS
+              << ", nodepoolmap + arena " << arena_bytes / HEADERS
+              << " (sizeof(CBlockIndex) " << sizeof(CBlockIndex) << ")" << std::endl;
+}
+
+// Load the block tree into a block manager, and unload it again, to time the
+// block index layout.
+static void LoadBlockIndexGuts(benchmark::State& state)
+{
+    CBlockTreeDB blocktree(1 << 20, true, false);
+    WriteBlockTree(blocktree);
+    PrintBytesPerHeader(blocktree);
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+    while (state.KeepRunning()) {
+        BlockManager blockman;
+        LOCK(cs_main);
+        bool ret = blocktree.LoadBlockIndexGuts(consensus, [&blockman](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return blockman.InsertBlockIndex(hash); });
+        assert(ret);
+        assert(blockman.m_block_index.size() == HEADERS);
+        blockman.Unload();
+    }
+}
+
+// The same with the layout the arena replaced, for comparison.
+static void LoadBlockIndexGutsHeap(benchmark::State& state)
+{
+    CBlockTreeDB blocktree(1 << 20, true, false);
+    WriteBlockTree(blocktree);
+    PrintBytesPerHeader(blocktree);
+
+    while (state.KeepRunning()) {
+        HeapBlockMap map;
+        LOCK(cs_main);
+        bool ret = LoadIntoHeapBlockMap(blocktree, map);
+        assert(ret);
+        assert(map.size() == HEADERS);
+        UnloadHeapBlockMap(map);
+    }
+}
+
+BENCHMARK(LoadBlockIndexGuts, 1);
+BENCHMARK(LoadBlockIndexGutsHeap, 1);
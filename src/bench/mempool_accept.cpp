@@ -0,0 +1,58 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coins.h>
+#include <consensus/validation.h>
+#include <crypto/sha256.h>
+#include <random.h>
+#include <script/script.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <vector>
+
+// Check a transaction spending many inputs for entry into the memory pool.
+// Each input runs a witness script of 200 hashes, which costs about as much
+// as a signature check but, unlike one, is not cached from one run to the
+// next.
+static void MempoolAcceptManyInputs(benchmark::State& state, size_t inputs, bool parallel)
+{
+    CScript witness_script;
+    for (int i = 0; i < 200; i++) witness_script << OP_SHA256;
+    uint256 witness_program;
+    CSHA256().Write(witness_script.data(), witness_script.size()).Finalize(witness_program.begin());
+    const CScript script_pub{CScript(OP_0) << std::vector<unsigned char>{witness_program.begin(), witness_program.end()}};
+
+    CMutableTransaction mtx;
+    {
+        LOCK(cs_main);
+        CCoinsViewCache& coins_tip = ::ChainstateActive().CoinsTip();
+        for (size_t i = 0; i < inputs; i++) {
+            const COutPoint prevout(GetRandHash(), 0);
+            coins_tip.AddCoin(prevout, Coin(CTxOut(COIN, script_pub), 1, false), false);
+            mtx.vin.emplace_back(prevout);
+            mtx.vin.back().scriptWitness.stack.emplace_back(80, 0x42);
+            mtx.vin.back().scriptWitness.stack.emplace_back(witness_script.begin(), witness_script.end());
+        }
+    }
+    mtx.vout.emplace_back(inputs * COIN / 2, script_pub);
+    const CTransactionRef tx = MakeTransactionRef(mtx);
+
+    const int script_check_threads = nScriptCheckThreads;
+    if (!parallel) nScriptCheckThreads = 0;
+    while (state.KeepRunning()) {
+        LOCK(cs_main);
+        CValidationState vstate;
+        bool ret{::AcceptToMemoryPool(::mempool, vstate, tx, nullptr /* pfMissingInputs */, nullptr /* plTxnReplaced */, false /* bypass_limits */, /* nAbsurdFee */ 0, /* test_accept */ true)};
+        assert(ret);
+    }
+    nScriptCheckThreads = script_check_threads;
+}
+
+static void MempoolAccept500Inputs(benchmark::State& state) { MempoolAcceptManyInputs(state, 500, false); }
+static void MempoolAccept500InputsParallel(benchmark::State& state) { MempoolAcceptManyInputs(state, 500, true); }
+
+BENCHMARK(MempoolAccept500Inputs, 10);
+BENCHMARK(MempoolAccept500InputsParallel, 10);
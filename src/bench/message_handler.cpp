@@ -0,0 +1,98 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/connman.h>
+
+#include <crypto/sha256.h>
+#include <net.h>
+#include <sync.h>
+
+#include <condition_variable>
+#include <memory>
+
+namespace {
+/**
+ * Stands in for PeerLogicValidation. Each queued message costs a fixed amount
+ * of hashing, the first peer's messages a hundred times as much, like a peer
+ * asking for large blocks.
+ */
+class BenchMsgProc : public NetEventsInterface
+{
+public:
+    explicit BenchMsgProc(int peers) : nPeers(peers), nPending(new std::atomic<int>[peers]) {}
+
+    //! Queue messages for every peer and wait until they are all processed
+    void Run(CConnman& connman, int messages)
+    {
+        WAIT_LOCK(mutex, lock);
+        nRemaining = nPeers * messages;
+        for (int i = 0; i < nPeers; i++) nPending[i] = messages;
+        connman.WakeMessageHandler();
+        cond.wait(lock, [this] { return nRemaining == 0; });
+    }
+
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        const NodeId id = pnode->GetId();
+        if (nPending[id] == 0) return false;
+        unsigned char hash[CSHA256::OUTPUT_SIZE] = {};
+        for (int i = 0; i < (id == 0 ? 100 : 1); i++) {
+            CSHA256().Write(payload, sizeof(payload)).Write(hash, sizeof(hash)).Finalize(hash);
+        }
+        const bool fMoreWork = --nPending[id] > 0;
+        {
+            LOCK(mutex);
+            if (--nRemaining == 0) cond.notify_all();
+        }
+        return fMoreWork;
+    }
+
+    bool SendMessages(CNode* pnode) override { return true; }
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override {}
+
+private:
+    const int nPeers;
+    std::unique_ptr<std::atomic<int>[]> nPending;
+    unsigned char payload[1000] = {};
+    Mutex mutex;
+    std::condition_variable cond;
+    int nRemaining GUARDED_BY(mutex) = 0;
+};
+} // namespace
+
+// Process ten messages from each peer, through the given number of message
+// handler threads. The time per iteration over the message count gives the
+// message rate for that many peers.
+static void MessageHandler(benchmark::State& state, int peers, int threads)
+{
+    BenchMsgProc msgproc(peers);
+    CConnmanTest connman(0x1337, 0x1337);
+    CConnman::Options options;
+    options.m_msgproc = &msgproc;
+    options.nMsgHandlerThreads = threads;
+    connman.Init(options);
+    for (int i = 0; i < peers; i++) {
+        connman.AddNode(*new CNode(i, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(), 0, 0, CAddress(), "", /*fInboundIn=*/ true));
+    }
+    connman.StartMessageHandlers();
+
+    while (state.KeepRunning()) {
+        msgproc.Run(connman, 10);
+    }
+
+    connman.Interrupt();
+    connman.Stop();
+}
+
+static void MessageHandler8Peers(benchmark::State& state) { MessageHandler(state, 8, 1); }
+static void MessageHandler8PeersThreads4(benchmark::State& state) { MessageHandler(state, 8, 4); }
+static void MessageHandler125Peers(benchmark::State& state) { MessageHandler(state, 125, 1); }
+static void MessageHandler125PeersThreads4(benchmark::State& state) { MessageHandler(state, 125, 4); }
+
+BENCHMARK(MessageHandler8Peers, 100);
+BENCHMARK(MessageHandler8PeersThreads4, 100);
+BENCHMARK(MessageHandler125Peers, 10);
+BENCHMARK(MessageHandler125PeersThreads4, 10);
@@ -0,0 +1,107 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/neoscrypt.h>
+#include <util/system.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Profiles used by CBlockHeader::GetPoWHash: NeoScrypt after nNeoScryptFork,
+// Scrypt with PBKDF2-SHA256 before it.
+static const unsigned int PROFILE_NEOSCRYPT = 0x0;
+static const unsigned int PROFILE_SCRYPT = 0x3;
+
+/* Number of headers hashed per iteration by the batch benchmarks */
+static const size_t BATCH_SIZE = 64;
+
+static std::vector<unsigned char> MakeHeaders(size_t count)
+{
+    std::vector<unsigned char> in(80 * count);
+    for (size_t i = 0; i < in.size(); i++) in[i] = (unsigned char)i;
+    return in;
+}
+
+static void HashSingle(benchmark::State& state, unsigned int profile)
+{
+    std::vector<unsigned char> in = MakeHeaders(1);
+    unsigned char hash[32];
+    while (state.KeepRunning()) {
+        neoscrypt(in.data(), hash, profile);
+        in[76] = hash[0]; // vary the nonce
+    }
+}
+
+static void HashBatch(benchmark::State& state, unsigned int profile)
+{
+    std::vector<unsigned char> in = MakeHeaders(BATCH_SIZE);
+    std::vector<unsigned char> out(32 * BATCH_SIZE);
+    while (state.KeepRunning()) {
+        NeoScryptBatch(out.data(), in.data(), BATCH_SIZE, profile);
+    }
+}
+
+static void HashBatchMultiThread(benchmark::State& state, unsigned int profile)
+{
+    // Split one batch over all cores, as the header check queue does
+    const size_t threads = std::max(1, GetNumCores());
+    const size_t per_thread = (BATCH_SIZE + threads - 1) / threads;
+    std::vector<unsigned char> in = MakeHeaders(BATCH_SIZE);
+    std::vector<unsigned char> out(32 * BATCH_SIZE);
+    while (state.KeepRunning()) {
+        std::vector<std::thread> workers;
+        for (size_t begin = 0; begin < BATCH_SIZE; begin += per_thread) {
+            const size_t count = std::min(per_thread, BATCH_SIZE - begin);
+            workers.emplace_back([&, begin, count] { NeoScryptBatch(&out[32 * begin], &in[80 * begin], count, profile); });
+        }
+        for (std::thread& worker : workers) worker.join();
+    }
+}
+
+static void NeoScrypt(benchmark::State& state) { HashSingle(state, PROFILE_NEOSCRYPT); }
+static void NeoScryptBatch64(benchmark::State& state) { HashBatch(state, PROFILE_NEOSCRYPT); }
+static void NeoScryptBatch64MultiThread(benchmark::State& state) { HashBatchMultiThread(state, PROFILE_NEOSCRYPT); }
+static void Scrypt(benchmark::State& state) { HashSingle(state, PROFILE_SCRYPT); }
+static void ScryptBatch64(benchmark::State& state) { HashBatch(state, PROFILE_SCRYPT); }
+static void ScryptBatch64MultiThread(benchmark::State& state) { HashBatchMultiThread(state, PROFILE_SCRYPT); }
+
+static void NeoScryptFastKDF(benchmark::State& state)
+{
+    std::vector<unsigned char> in = MakeHeaders(1);
+    unsigned char out[256];
+    while (state.KeepRunning()) {
+        neoscrypt_fastkdf(in.data(), 80, in.data(), 80, 32, out, sizeof(out));
+    }
+}
+
+static void NeoScryptFastKDFOpt(benchmark::State& state)
+{
+    std::vector<unsigned char> in = MakeHeaders(1);
+    unsigned char out[256];
+    while (state.KeepRunning()) {
+        neoscrypt_fastkdf_opt(in.data(), in.data(), out, 0);
+    }
+}
+
+static void NeoScryptBLAKE2s(benchmark::State& state)
+{
+    // One FastKDF PRF call: 64-byte input, 32-byte key, 32-byte output
+    std::vector<unsigned char> in(64, 0);
+    unsigned char key[32] = {0};
+    while (state.KeepRunning()) {
+        neoscrypt_blake2s(in.data(), in.size(), key, sizeof(key), in.data(), 32);
+    }
+}
+
+BENCHMARK(NeoScrypt, 4000);
+BENCHMARK(NeoScryptBatch64, 100);
+BENCHMARK(NeoScryptBatch64MultiThread, 200);
+BENCHMARK(Scrypt, 4000);
+BENCHMARK(ScryptBatch64, 100);
+BENCHMARK(ScryptBatch64MultiThread, 200);
+BENCHMARK(NeoScryptFastKDF, 100 * 1000);
+BENCHMARK(NeoScryptFastKDFOpt, 100 * 1000);
+BENCHMARK(NeoScryptBLAKE2s, 3000 * 1000);
@@ -0,0 +1,70 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <validation.h>
+
+// Reading a block by position treats the data as untrusted and re-checks its
+// NeoScrypt proof of work; reading it through the block index does not.
+
+static void ReadBlockFromDiskUntrusted(benchmark::State& state)
+{
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    const FlatFilePos pos = WITH_LOCK(cs_main, return pindex->GetBlockPos());
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        bool ret = ReadBlockFromDisk(block, pos, consensus_params);
+        assert(ret);
+    }
+}
+
+static void ReadBlockFromDiskIndexed(benchmark::State& state)
+{
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        bool ret = ReadBlockFromDisk(block, pindex, consensus_params);
+        assert(ret);
+    }
+}
+
+// Serving a block to a peer reads its raw bytes, either copied out of the
+// block file or pointed to in a mapping of it.
+
+static void ReadRawBlockFromDiskCopied(benchmark::State& state)
+{
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    const CChainParams& chainparams = Params();
+
+    while (state.KeepRunning()) {
+        std::vector<uint8_t> block_data;
+        bool ret = ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart(), chainparams.MessageStartOld());
+        assert(ret);
+    }
+}
+
+static void ReadRawBlockFromDiskMapped(benchmark::State& state)
+{
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return ::ChainActive().Genesis());
+    const CChainParams& chainparams = Params();
+
+    while (state.KeepRunning()) {
+        std::shared_ptr<const MappedFlatFile> block_file;
+        Span<const uint8_t> block_span;
+        bool ret = MapRawBlockFromDisk(block_file, block_span, pindex, chainparams.MessageStart(), chainparams.MessageStartOld());
+        assert(ret);
+    }
+}
+
+BENCHMARK(ReadBlockFromDiskUntrusted, 5000);
+BENCHMARK(ReadBlockFromDiskIndexed, 50000);
+BENCHMARK(ReadRawBlockFromDiskCopied, 50000);
+BENCHMARK(ReadRawBlockFromDiskMapped, 50000);
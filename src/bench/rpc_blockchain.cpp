@@ -9,25 +9,57 @@
 #include <streams.h>
 #include <consensus/validation.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
 
 #include <univalue.h>
 
-static void BlockToJsonVerbose(benchmark::State& state) {
-    CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
-    char a = '\0';
-    stream.write(&a, 1); // Prevent compaction
+#include <assert.h>
 
+struct TestBlockAndIndex {
     CBlock block;
-    stream >> block;
-
+    uint256 blockHash;
     CBlockIndex blockindex;
-    const uint256 blockHash = block.GetHash();
-    blockindex.phashBlock = &blockHash;
-    blockindex.nBits = 403014710;
 
+    TestBlockAndIndex()
+    {
+        CDataStream stream(benchmark::data::block413567, SER_NETWORK, PROTOCOL_VERSION);
+        char a = '\0';
+        stream.write(&a, 1); // Prevent compaction
+
+        stream >> block;
+
+        blockHash = block.GetHash();
+        blockindex.phashBlock = &blockHash;
+        blockindex.nBits = 403014710;
+    }
+};
+
+static void BlockToJsonVerbose(benchmark::State& state) {
+    TestBlockAndIndex data;
+    while (state.KeepRunning()) {
+        (void)blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true);
+    }
+}
+
+static void BlockToJsonVerboseWrite(benchmark::State& state) {
+    TestBlockAndIndex data;
+    while (state.KeepRunning()) {
+        std::string str = blockToJSON(data.block, &data.blockindex, &data.blockindex, /*verbose*/ true).write();
+        assert(!str.empty());
+    }
+}
+
+static void BlockToJsonVerboseStream(benchmark::State& state) {
+    TestBlockAndIndex data;
+    size_t written = 0;
+    JSONStreamWriter writer([&written](const std::string& chunk) { written += chunk.size(); });
     while (state.KeepRunning()) {
-        (void)blockToJSON(block, &blockindex, &blockindex, /*verbose*/ true);
+        blockToJSONStream(writer, data.block, &data.blockindex, &data.blockindex);
+        writer.Flush();
     }
+    assert(written > 0);
 }
 
 BENCHMARK(BlockToJsonVerbose, 10);
+BENCHMARK(BlockToJsonVerboseWrite, 10);
+BENCHMARK(BlockToJsonVerboseStream, 10);
@@ -4,10 +4,12 @@
 
 #include <bench/bench.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
 #include <txmempool.h>
 
 #include <univalue.h>
 
+#include <assert.h>
 #include <list>
 #include <vector>
 
@@ -17,11 +19,8 @@ static void AddTx(const CTransactionRef& tx, const CAmount& fee, CTxMemPool& poo
     pool.addUnchecked(CTxMemPoolEntry(tx, fee, /* time */ 0, /* height */ 1, /* spendsCoinbase */ false, /* sigOpCost */ 4, lp));
 }
 
-static void RpcMempool(benchmark::State& state)
+static void FillPool(CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
 {
-    CTxMemPool pool;
-    LOCK2(cs_main, pool.cs);
-
     for (int i = 0; i < 1000; ++i) {
         CMutableTransaction tx = CMutableTransaction();
         tx.vin.resize(1);
@@ -33,10 +32,48 @@ static void RpcMempool(benchmark::State& state)
         const CTransactionRef tx_r{MakeTransactionRef(tx)};
         AddTx(tx_r, /* fee */ i, pool);
     }
+}
+
+static void RpcMempool(benchmark::State& state)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    FillPool(pool);
 
     while (state.KeepRunning()) {
         (void)MempoolToJSON(pool, /*verbose*/ true);
     }
 }
 
+static void RpcMempoolWrite(benchmark::State& state)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    FillPool(pool);
+
+    while (state.KeepRunning()) {
+        std::string str = MempoolToJSON(pool, /*verbose*/ true).write();
+        assert(!str.empty());
+    }
+}
+
+static void RpcMempoolStream(benchmark::State& state)
+{
+    CTxMemPool pool;
+    {
+        LOCK2(cs_main, pool.cs);
+        FillPool(pool);
+    }
+
+    size_t written = 0;
+    JSONStreamWriter writer([&written](const std::string& chunk) { written += chunk.size(); });
+    while (state.KeepRunning()) {
+        MempoolToJSONStream(writer, pool);
+        writer.Flush();
+    }
+    assert(written > 0);
+}
+
 BENCHMARK(RpcMempool, 40);
+BENCHMARK(RpcMempoolWrite, 40);
+BENCHMARK(RpcMempoolStream, 40);
@@ -0,0 +1,154 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/connman.h>
+
+#include <chainparams.h>
+#include <hash.h>
+#include <net.h>
+#include <protocol.h>
+#include <streams.h>
+#include <sync.h>
+
+#include <list>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+class NullMsgProc : public NetEventsInterface
+{
+public:
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override { return false; }
+    bool SendMessages(CNode* pnode) override { return true; }
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override {}
+};
+} // namespace
+
+// Many connected peers, of which a few send a ping at a time. Each iteration
+// runs the socket handler until the pings of ten peers are received, so the
+// time per iteration grows with the number of idle peers the handler looks at.
+static void SocketHandler(benchmark::State& state, int peers, bool epoll)
+{
+    static const int ACTIVE_PEERS = 10;
+
+    NullMsgProc msgproc;
+    CConnmanTest connman(0x1337, 0x1337);
+    CConnman::Options options;
+    options.m_msgproc = &msgproc;
+    connman.Init(options);
+    if (epoll) {
+        bool fEpoll = connman.InitSocketEvents();
+        assert(fEpoll);
+    }
+
+    std::vector<CNode*> nodes;
+    std::vector<int> remotes;
+    for (int i = 0; i < peers; i++) {
+        int fds[2];
+        int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        assert(ret == 0);
+        nodes.push_back(new CNode(i, NODE_NETWORK, 0, fds[0], CAddress(), 0, 0, CAddress(), "", /*fInboundIn=*/ true));
+        remotes.push_back(fds[1]);
+        connman.AddNode(*nodes.back());
+    }
+
+    std::vector<unsigned char> ping;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, ping, 0, CMessageHeader(Params().MessageStart(), NetMsgType::PING, 8), uint64_t(0));
+
+    int next = 0;
+    while (state.KeepRunning()) {
+        std::vector<CNode*> active;
+        for (int i = 0; i < ACTIVE_PEERS; i++, next = (next + 1) % peers) {
+            ssize_t nBytes = write(remotes[next], ping.data(), ping.size());
+            assert(nBytes == (ssize_t)ping.size());
+            active.push_back(nodes[next]);
+        }
+        while (!active.empty()) {
+            connman.SocketHandler();
+            for (size_t i = 0; i < active.size();) {
+                CNode* pnode = active[i];
+                LOCK(pnode->cs_vProcessMsg);
+                if (pnode->vProcessMsg.empty()) {
+                    i++;
+                    continue;
+                }
+                pnode->vProcessMsg.clear();
+                pnode->nProcessQueueSize = 0;
+                pnode->fPauseRecv = false;
+                active[i] = active.back();
+                active.pop_back();
+            }
+        }
+    }
+
+    connman.Stop();
+    for (int fd : remotes) close(fd);
+}
+
+// Replay a burst of transaction-sized messages from one peer through the
+// socket handler, and take them off the process queue one at a time like
+// ProcessMessages does.
+static void ReceiveMessages(benchmark::State& state)
+{
+    static const int MESSAGES = 100;
+
+    NullMsgProc msgproc;
+    CConnmanTest connman(0x1337, 0x1337);
+    CConnman::Options options;
+    options.m_msgproc = &msgproc;
+    options.nReceiveFloodSize = 1000 * 1000;
+    connman.Init(options);
+
+    int fds[2];
+    int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert(ret == 0);
+    CNode* pnode = new CNode(0, NODE_NETWORK, 0, fds[0], CAddress(), 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+    connman.AddNode(*pnode);
+
+    std::vector<unsigned char> payload(250, 0x42);
+    uint256 hash = Hash(payload.begin(), payload.end());
+    CMessageHeader hdr(Params().MessageStart(), NetMsgType::TX, payload.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    std::vector<unsigned char> burst;
+    for (int i = 0; i < MESSAGES; i++) {
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, burst, burst.size(), hdr);
+        burst.insert(burst.end(), payload.begin(), payload.end());
+    }
+
+    while (state.KeepRunning()) {
+        ssize_t nBytes = write(fds[1], burst.data(), burst.size());
+        assert(nBytes == (ssize_t)burst.size());
+        int received = 0;
+        while (received < MESSAGES) {
+            connman.SocketHandler();
+            while (true) {
+                std::list<CNetMessage> msgs;
+                {
+                    LOCK(pnode->cs_vProcessMsg);
+                    if (pnode->vProcessMsg.empty()) break;
+                    msgs.splice(msgs.begin(), pnode->vProcessMsg, pnode->vProcessMsg.begin());
+                    pnode->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+                    pnode->fPauseRecv = false;
+                }
+                msgs.front().GetMessageHash();
+                pnode->RecycleMessages(msgs);
+                received++;
+            }
+        }
+    }
+
+    connman.Stop();
+    close(fds[1]);
+}
+
+static void SocketHandler1000PeersPoll(benchmark::State& state) { SocketHandler(state, 1000, false); }
+static void SocketHandler1000PeersEpoll(benchmark::State& state) { SocketHandler(state, 1000, true); }
+
+BENCHMARK(SocketHandler1000PeersPoll, 100);
+BENCHMARK(SocketHandler1000PeersEpoll, 100);
+BENCHMARK(ReceiveMessages, 1000);
@@ -4,12 +4,33 @@
 
 #include <bench/bench.h>
 #include <interfaces/chain.h>
+#include <key_io.h>
 #include <optional.h>
+#include <random.h>
+#include <script/standard.h>
 #include <test/util.h>
+#include <validation.h>
 #include <validationinterface.h>
 #include <wallet/wallet.h>
 
-static void WalletBalance(benchmark::State& state, const bool set_dirty, const bool add_watchonly, const bool add_mine)
+/** Add a history of confirmed payments to the wallet, each spent by the next one */
+static void AddHistory(CWallet& wallet, const std::string& address, const int history)
+{
+    const CScript script_mine = GetScriptForDestination(DecodeDestination(address));
+    const uint256 block_hash = WITH_LOCK(cs_main, return ::ChainActive().Tip()->GetBlockHash());
+    COutPoint prevout(GetRandHash(), 0);
+    for (int i = 0; i < history; ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(prevout);
+        mtx.vout.emplace_back(COIN, script_mine);
+        CWalletTx wtx(&wallet, MakeTransactionRef(std::move(mtx)));
+        wtx.SetConf(CWalletTx::Status::CONFIRMED, block_hash, i);
+        if (!wallet.AddToWallet(wtx)) assert(false);
+        prevout = COutPoint(wtx.GetHash(), 0);
+    }
+}
+
+static void WalletBalance(benchmark::State& state, const bool set_dirty, const bool add_watchonly, const bool add_mine, const int history = 0)
 {
     const auto& ADDRESS_WATCHONLY = ADDRESS_BCRT1_UNSPENDABLE;
 
@@ -30,6 +51,7 @@ static void WalletBalance(benchmark::State& state, const bool set_dirty, const b
         generatetoaddress(ADDRESS_WATCHONLY);
     }
     SyncWithValidationInterfaceQueue();
+    if (history > 0) AddHistory(wallet, *address_mine, history);
 
     auto bal = wallet.GetBalance(); // Cache
 
@@ -45,8 +67,40 @@ static void WalletBalanceDirty(benchmark::State& state) { WalletBalance(state, /
 static void WalletBalanceClean(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ true, /* add_mine */ true); }
 static void WalletBalanceMine(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ false, /* add_mine */ true); }
 static void WalletBalanceWatch(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ true, /* add_mine */ false); }
+static void WalletBalanceLargeHistory(benchmark::State& state) { WalletBalance(state, /* set_dirty */ false, /* add_watchonly */ false, /* add_mine */ true, /* history */ 20000); }
+
+// Coins available for spending in a wallet with a long history, most of it
+// spent, like a pool payout wallet.
+static void WalletAvailableCoinsLargeHistory(benchmark::State& state)
+{
+    std::unique_ptr<interfaces::Chain> chain = interfaces::MakeChain();
+    CWallet wallet{chain.get(), WalletLocation(), WalletDatabase::CreateMock()};
+    {
+        bool first_run;
+        if (wallet.LoadWallet(first_run) != DBErrors::LOAD_OK) assert(false);
+        wallet.handleNotifications();
+    }
+
+    const std::string address_mine{getnewaddress(wallet)};
+    for (int i = 0; i < 100; ++i) {
+        generatetoaddress(address_mine);
+        generatetoaddress(ADDRESS_BCRT1_UNSPENDABLE);
+    }
+    SyncWithValidationInterfaceQueue();
+    AddHistory(wallet, address_mine, 20000);
+
+    auto locked_chain = chain->lock();
+    LOCK(wallet.cs_wallet);
+    while (state.KeepRunning()) {
+        std::vector<COutput> coins;
+        wallet.AvailableCoins(*locked_chain, coins);
+        assert(!coins.empty());
+    }
+}
 
 BENCHMARK(WalletBalanceDirty, 2500);
 BENCHMARK(WalletBalanceClean, 8000);
 BENCHMARK(WalletBalanceMine, 16000);
 BENCHMARK(WalletBalanceWatch, 8000);
+BENCHMARK(WalletBalanceLargeHistory, 8000);
+BENCHMARK(WalletAvailableCoinsLargeHistory, 1000);
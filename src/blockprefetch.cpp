@@ -0,0 +1,242 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockprefetch.h>
+
+#include <checkqueue.h>
+#include <consensus/validation.h>
+#include <primitives/block.h>
+#include <tinyformat.h>
+#include <txdb.h>
+#include <util/threadnames.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <set>
+
+#include <boost/thread/thread.hpp>
+
+/**
+ * Closure representing the lookup of one coin in the coins database. Used to
+ * spread the lookups for a block over the coin prefetching threads.
+ */
+class CCoinsFetch
+{
+private:
+    const CCoinsViewDB* pcoinsdb;
+    const COutPoint* poutpoint;
+    Coin* pcoin;
+
+public:
+    CCoinsFetch() : pcoinsdb(nullptr), poutpoint(nullptr), pcoin(nullptr) {}
+    CCoinsFetch(const CCoinsViewDB& coinsdbIn, const COutPoint& outpointIn, Coin& coinIn) :
+        pcoinsdb(&coinsdbIn), poutpoint(&outpointIn), pcoin(&coinIn) {}
+
+    bool operator()()
+    {
+        // A coin that isn't found stays spent
+        pcoinsdb->GetCoin(*poutpoint, *pcoin);
+        return true;
+    }
+
+    void swap(CCoinsFetch& check)
+    {
+        std::swap(pcoinsdb, check.pcoinsdb);
+        std::swap(poutpoint, check.poutpoint);
+        std::swap(pcoin, check.pcoin);
+    }
+};
+
+static CCheckQueue<CCoinsFetch> coinsfetchqueue(64);
+
+void ThreadCoinsFetch(int worker_num) {
+    util::ThreadRename(strprintf("coinsfetch.%i", worker_num));
+    coinsfetchqueue.Thread();
+}
+
+void CBlockPrefetcher::StageCoins(const CBlock& block, const CCoinsViewDB& coinsdb, Prefetched& prefetched)
+{
+    prefetched.coins.clear();
+    prefetched.nWriteSeq = coinsdb.GetWriteSequence();
+    if (prefetched.nWriteSeq & 1) return; // being written, the coins would be stale
+
+    // Outputs created by the block itself are not in the database
+    std::set<uint256> txids;
+    for (const auto& tx : block.vtx) txids.insert(tx->GetHash());
+    std::vector<COutPoint> outpoints;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        for (const CTxIn& txin : block.vtx[i]->vin) {
+            if (!txids.count(txin.prevout.hash)) outpoints.push_back(txin.prevout);
+        }
+    }
+
+    std::vector<Coin> coins(outpoints.size());
+    std::vector<CCoinsFetch> vChecks;
+    vChecks.reserve(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        vChecks.emplace_back(coinsdb, outpoints[i], coins[i]);
+    }
+    if (!nScriptCheckThreads) {
+        for (CCoinsFetch& check : vChecks) check();
+    } else {
+        CCheckQueueControl<CCoinsFetch> control(&coinsfetchqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        if (!coins[i].IsSpent()) prefetched.coins.emplace_back(outpoints[i], std::move(coins[i]));
+    }
+}
+
+
+void CBlockPrefetcher::Thread(size_t max_blocks)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nMaxBlocks = max_blocks;
+    }
+    cond.notify_all();
+    try {
+        while (true) {
+            std::pair<uint256, FlatFilePos> entry;
+            CCoinsViewDB* coinsdb;
+            const Consensus::Params* consensusParams;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (queue.empty() || mapReady.size() >= nMaxBlocks) {
+                    cond.wait(lock); // interruption point
+                }
+                entry = queue.front();
+                queue.pop_front();
+                hashReading = entry.first;
+                coinsdb = pcoinsdb;
+                consensusParams = pconsensusParams;
+            }
+
+            // The block index already checked this block's proof of work, a
+            // matching hash is enough to tie the data on disk to it.
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            Prefetched prefetched;
+            bool fRead = ReadBlockFromDisk(*pblock, entry.second, *consensusParams, false) && pblock->GetHash() == entry.first;
+            if (fRead) {
+                CValidationState state;
+                CheckBlock(*pblock, state, *consensusParams);
+                StageCoins(*pblock, *coinsdb, prefetched);
+                prefetched.block = std::move(pblock);
+            }
+
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                hashReading.SetNull();
+                if (fRead) mapReady[entry.first] = std::move(prefetched);
+            }
+            cond.notify_all();
+        }
+    } catch (const boost::thread_interrupted&) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nMaxBlocks = 0;
+        queue.clear();
+        mapReady.clear();
+        hashReading.SetNull();
+        hashReceived.SetNull();
+        received = Prefetched();
+        cond.notify_all();
+        throw;
+    }
+}
+
+void CBlockPrefetcher::Prefetch(const std::vector<std::pair<uint256, FlatFilePos>>& blocks, CCoinsViewDB* coinsdb, const Consensus::Params& consensusParams)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nMaxBlocks == 0) return;
+
+        pcoinsdb = coinsdb;
+        pconsensusParams = &consensusParams;
+
+        // Drop blocks read ahead for a chain we are no longer connecting
+        const size_t count = std::min(blocks.size(), nMaxBlocks);
+        std::set<uint256> wanted;
+        for (size_t i = 0; i < count; i++) wanted.insert(blocks[i].first);
+        for (auto it = mapReady.begin(); it != mapReady.end();) {
+            if (wanted.count(it->first)) {
+                ++it;
+            } else {
+                it = mapReady.erase(it);
+            }
+        }
+
+        queue.clear();
+        for (size_t i = 1; i < count; i++) {
+            if (!mapReady.count(blocks[i].first) && blocks[i].first != hashReading) {
+                queue.push_back(blocks[i]);
+            }
+        }
+    }
+    cond.notify_all();
+}
+
+void CBlockPrefetcher::FetchCoins(const std::shared_ptr<const CBlock>& pblock, CCoinsViewDB* coinsdb)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nMaxBlocks == 0) return;
+    }
+
+    Prefetched prefetched;
+    StageCoins(*pblock, *coinsdb, prefetched);
+    prefetched.block = pblock;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    pcoinsdb = coinsdb;
+    hashReceived = pblock->GetHash();
+    received = std::move(prefetched);
+}
+
+std::shared_ptr<const CBlock> CBlockPrefetcher::Take(const uint256& hash, CCoinsViewCache& view)
+{
+    Prefetched prefetched;
+    uint64_t nWriteSeq;
+    {
+        // Called while connecting blocks, which must not be interrupted halfway
+        boost::this_thread::disable_interruption no_interruption;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (hashReading == hash) {
+            cond.wait(lock);
+        }
+        auto it = mapReady.find(hash);
+        if (it != mapReady.end()) {
+            prefetched = std::move(it->second);
+            mapReady.erase(it);
+        } else if (hashReceived == hash) {
+            prefetched = std::move(received);
+            hashReceived.SetNull();
+        } else {
+            // The caller reads the block itself, don't read it again
+            queue.erase(std::remove_if(queue.begin(), queue.end(),
+                [&hash](const std::pair<uint256, FlatFilePos>& entry) { return entry.first == hash; }), queue.end());
+            return nullptr;
+        }
+        // The database is only written to with cs_main held, like here
+        nWriteSeq = pcoinsdb->GetWriteSequence();
+    }
+    // There is room to read another block ahead
+    cond.notify_all();
+
+    if (prefetched.nWriteSeq == nWriteSeq) {
+        for (auto& coin : prefetched.coins) {
+            view.AddPrefetchedCoin(coin.first, std::move(coin.second));
+        }
+    }
+    return prefetched.block;
+}
+
+void CBlockPrefetcher::SyncWithWorker()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (nMaxBlocks == 0 || !hashReading.IsNull() || (!queue.empty() && mapReady.size() < nMaxBlocks)) {
+        cond.wait(lock);
+    }
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKPREFETCH_H
+#define BITCOIN_BLOCKPREFETCH_H
+
+#include <coins.h>
+#include <flatfile.h>
+#include <uint256.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CCoinsViewDB;
+
+namespace Consensus {
+struct Params;
+}
+
+/** Default for -blockprefetch, the number of blocks read ahead while connecting */
+static const unsigned int DEFAULT_BLOCK_PREFETCH = 16;
+
+/** Run an instance of the coin prefetching thread */
+void ThreadCoinsFetch(int worker_num);
+
+/**
+ * Reads the blocks that are about to be connected ahead of time, so that
+ * connecting a block does not wait for the disk and deserialization while
+ * the script check threads sit idle.
+ *
+ * A single worker thread reads the requested blocks in connect order and runs
+ * the context-free CheckBlock() on them. It then looks up the coins their
+ * inputs spend in the coins database, spread over the coin prefetching
+ * threads. The coins found are staged with the block and added to the coins
+ * cache right before the block is connected, unless the database was written
+ * to in the meantime.
+ */
+class CBlockPrefetcher
+{
+private:
+    //! A block read ahead, with the coins staged for it
+    struct Prefetched
+    {
+        std::shared_ptr<const CBlock> block;
+        //! Write sequence of the coins database the coins were read at
+        uint64_t nWriteSeq = 0;
+        std::vector<std::pair<COutPoint, Coin>> coins;
+    };
+
+    //! Mutex to protect the inner state
+    boost::mutex mutex;
+
+    //! Worker thread waits for work, Take waits for a block being read
+    boost::condition_variable cond;
+
+    //! Maximum number of blocks queued or read ahead, 0 while no worker runs
+    size_t nMaxBlocks;
+
+    //! Blocks still to be read, in connect order
+    std::deque<std::pair<uint256, FlatFilePos>> queue;
+
+    //! The block the worker is reading right now, if any
+    uint256 hashReading;
+
+    //! Blocks read ahead, waiting to be connected
+    std::map<uint256, Prefetched> mapReady;
+
+    //! Coins staged for the last block received through FetchCoins
+    uint256 hashReceived;
+    Prefetched received;
+
+    //! Coins database to read from, and the consensus rules to check blocks against
+    CCoinsViewDB* pcoinsdb;
+    const Consensus::Params* pconsensusParams;
+
+    //! Look up the coins spent by a block, see Prefetched
+    static void StageCoins(const CBlock& block, const CCoinsViewDB& coinsdb, Prefetched& prefetched);
+
+public:
+    CBlockPrefetcher() : nMaxBlocks(0), pcoinsdb(nullptr), pconsensusParams(nullptr) {}
+
+    //! Worker thread, reads up to max_blocks blocks ahead
+    void Thread(size_t max_blocks);
+
+    /**
+     * Replace the blocks to read ahead by the given ones, in connect order.
+     * The first block is about to be connected by the caller and is not read
+     * again unless it already is. Does nothing if no worker thread runs.
+     */
+    void Prefetch(const std::vector<std::pair<uint256, FlatFilePos>>& blocks, CCoinsViewDB* coinsdb, const Consensus::Params& consensusParams);
+
+    /**
+     * Stage the coins spent by a block that was received rather than read
+     * from disk, when it is about to be connected. Blocks the caller while
+     * the coins are looked up, so it must not hold cs_main.
+     */
+    void FetchCoins(const std::shared_ptr<const CBlock>& pblock, CCoinsViewDB* coinsdb);
+
+    /**
+     * Called with cs_main held right before a block is connected to view, the
+     * cache on top of the coins database. Adds the coins staged for the block
+     * to view if they are still current, and returns the block if it was
+     * read ahead, nullptr otherwise.
+     */
+    std::shared_ptr<const CBlock> Take(const uint256& hash, CCoinsViewCache& view);
+
+    /**
+     * Wait until the worker thread runs and has read every block queued so
+     * far, or as many as fit. Used by tests.
+     */
+    void SyncWithWorker();
+};
+
+#endif // BITCOIN_BLOCKPREFETCH_H
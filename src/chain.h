@@ -13,6 +13,7 @@
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <memory>
 #include <vector>
 
 /**
@@ -409,6 +410,52 @@ public:
     }
 };
 
+/**
+ * Storage for the entries of the block index. Entries are constructed in
+ * chunks rather than allocated one by one, which saves the allocator's
+ * overhead per entry and keeps entries that are created together, like the
+ * headers of a chain being synced or loaded in height order, next to each
+ * other in memory. Entries are never freed individually, they all live until
+ * Clear() is called.
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t CHUNK_ENTRIES = 4096;
+
+    std::vector<std::unique_ptr<CBlockIndex[]>> vChunks;
+    size_t nSize = 0;
+
+public:
+    CBlockIndex* New()
+    {
+        if (nSize == vChunks.size() * CHUNK_ENTRIES) {
+            vChunks.emplace_back(new CBlockIndex[CHUNK_ENTRIES]);
+        }
+        CBlockIndex* pindex = &vChunks.back()[nSize % CHUNK_ENTRIES];
+        nSize++;
+        return pindex;
+    }
+
+    CBlockIndex* New(const CBlockHeader& block)
+    {
+        CBlockIndex* pindex = New();
+        *pindex = CBlockIndex(block);
+        return pindex;
+    }
+
+    size_t size() const { return nSize; }
+
+    //! Bytes allocated for entries, including the unused part of the last chunk
+    size_t AllocatedBytes() const { return vChunks.size() * CHUNK_ENTRIES * sizeof(CBlockIndex); }
+
+    void Clear()
+    {
+        vChunks.clear();
+        nSize = 0;
+    }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
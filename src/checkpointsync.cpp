@@ -55,6 +55,8 @@
 #include <txdb.h>
 #include <validation.h>
 
+#include <algorithm>
+
 // Synchronized checkpoint (centrally broadcasted)
 std::string CSyncCheckpoint::strMasterPrivKey;
 uint256 hashSyncCheckpoint;
@@ -64,55 +66,53 @@ static CSyncCheckpoint checkpointMessagePending;
 CCriticalSection cs_hashSyncCheckpoint;
 
 
+//! Block index entry of hashSyncCheckpoint, looked up on first use
+static const CBlockIndex* pindexSyncCheckpoint GUARDED_BY(cs_hashSyncCheckpoint) = nullptr;
+static uint256 hashSyncCheckpointIndexed GUARDED_BY(cs_hashSyncCheckpoint);
+
+// Return the block index entry of the current sync-checkpoint, or nullptr if
+// it is not in the block index
+static const CBlockIndex* GetSyncCheckpointIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_hashSyncCheckpoint)
+{
+    if (!pindexSyncCheckpoint || hashSyncCheckpointIndexed != hashSyncCheckpoint) {
+        pindexSyncCheckpoint = LookupBlockIndex(hashSyncCheckpoint);
+        hashSyncCheckpointIndexed = hashSyncCheckpoint;
+    }
+    return pindexSyncCheckpoint;
+}
+
+void UnloadSyncCheckpoint()
+{
+    LOCK(cs_hashSyncCheckpoint);
+    pindexSyncCheckpoint = nullptr;
+    hashSyncCheckpointIndexed.SetNull();
+}
+
 // Only descendant of current sync-checkpoint is allowed
 bool ValidateSyncCheckpoint(uint256 hashCheckpoint)
 {
-    CBlockIndex* pindexSyncCheckpoint = nullptr;
-    CBlockIndex* pindexCheckpointRecv = nullptr;
-
-    {
-        LOCK2(cs_main, cs_hashSyncCheckpoint);
-        if (!::BlockIndex().count(hashSyncCheckpoint))
-            return error("%s: block index missing for current sync-checkpoint %s", __func__, hashSyncCheckpoint.ToString());
-        if (!::BlockIndex().count(hashCheckpoint))
-            return error("%s: block index missing for received sync-checkpoint %s", __func__, hashCheckpoint.ToString());
+    LOCK2(cs_main, cs_hashSyncCheckpoint);
 
-        pindexSyncCheckpoint = ::BlockIndex()[hashSyncCheckpoint];
-        pindexCheckpointRecv = ::BlockIndex()[hashCheckpoint];
-    }
+    const CBlockIndex* pindexSync = GetSyncCheckpointIndex();
+    if (!pindexSync)
+        return error("%s: block index missing for current sync-checkpoint %s", __func__, hashSyncCheckpoint.ToString());
+    const CBlockIndex* pindexCheckpointRecv = LookupBlockIndex(hashCheckpoint);
+    if (!pindexCheckpointRecv)
+        return error("%s: block index missing for received sync-checkpoint %s", __func__, hashCheckpoint.ToString());
 
-    if (pindexCheckpointRecv->nHeight <= pindexSyncCheckpoint->nHeight)
+    if (pindexCheckpointRecv->nHeight <= pindexSync->nHeight)
     {
-        // Received an older checkpoint, trace back from current checkpoint
-        // to the same height of the received checkpoint to verify
-        // that current checkpoint should be a descendant block
-        CBlockIndex* pindex = pindexSyncCheckpoint;
-        while (pindex->nHeight > pindexCheckpointRecv->nHeight)
-            if (!(pindex = pindex->pprev))
-                return error("%s: pprev1 null - block index structure failure", __func__);
-        if (pindex->GetBlockHash() != hashCheckpoint)
-        {
-            LOCK(cs_hashSyncCheckpoint);
+        // Received an older checkpoint, the current checkpoint should be a
+        // descendant block of it
+        if (pindexSync->GetAncestor(pindexCheckpointRecv->nHeight) != pindexCheckpointRecv)
             return error("%s: new sync-checkpoint %s is conflicting with current sync-checkpoint %s", __func__, hashCheckpoint.ToString(), hashSyncCheckpoint.ToString());
-        }
         return false; // ignore older checkpoint
     }
 
     // Received checkpoint should be a descendant block of the current
-    // checkpoint. Trace back to the same height of current checkpoint
-    // to verify.
-    CBlockIndex* pindex = pindexCheckpointRecv;
-    while (pindex->nHeight > pindexSyncCheckpoint->nHeight)
-        if (!(pindex = pindex->pprev))
-            return error("%s: pprev2 null - block index structure failure", __func__);
-
-    {
-        LOCK(cs_hashSyncCheckpoint);
-        if (pindex->GetBlockHash() != hashSyncCheckpoint)
-        {
-            return error("%s: new sync-checkpoint %s is not a descendant of current sync-checkpoint %s", __func__, hashCheckpoint.ToString(), hashSyncCheckpoint.ToString());
-        }
-    }
+    // checkpoint
+    if (pindexCheckpointRecv->GetAncestor(pindexSync->nHeight) != pindexSync)
+        return error("%s: new sync-checkpoint %s is not a descendant of current sync-checkpoint %s", __func__, hashCheckpoint.ToString(), hashSyncCheckpoint.ToString());
 
     return true;
 }
@@ -130,7 +130,7 @@ bool AcceptPendingSyncCheckpoint()
 {
     {
         LOCK2(cs_main, cs_hashSyncCheckpoint);
-        bool havePendingCheckpoint = hashPendingCheckpoint != uint256() && ::BlockIndex().count(hashPendingCheckpoint);
+        bool havePendingCheckpoint = hashPendingCheckpoint != uint256() && LookupBlockIndex(hashPendingCheckpoint);
         if (!havePendingCheckpoint)
             return false;
     }
@@ -151,7 +151,7 @@ bool AcceptPendingSyncCheckpoint()
 
     {
         LOCK2(cs_main, cs_hashSyncCheckpoint);
-        if (!::ChainActive().Contains(::BlockIndex()[hashPendingCheckpoint]))
+        if (!::ChainActive().Contains(LookupBlockIndex(hashPendingCheckpoint)))
             return false;
     }
 
@@ -169,8 +169,7 @@ bool AcceptPendingSyncCheckpoint()
         if (g_connman && !checkpointMessage.IsNull())
         {
             g_connman->ForEachNode([](CNode* pnode) {
-                if (pnode->supportACPMessages)
-                    checkpointMessage.RelayTo(pnode);
+                checkpointMessage.RelayTo(pnode);
             });
         }
     }
@@ -181,12 +180,13 @@ bool AcceptPendingSyncCheckpoint()
 // Automatically select a suitable sync-checkpoint
 uint256 AutoSelectSyncCheckpoint()
 {
+    const int64_t nDepth = gArgs.GetArg("-checkpointdepth", DEFAULT_AUTOCHECKPOINT);
+
     LOCK(cs_main);
-    // Search backward for a block with specified depth policy
-    const CBlockIndex *pindex = ::ChainActive().Tip();
-    while (pindex->pprev && pindex->nHeight + gArgs.GetArg("-checkpointdepth", DEFAULT_AUTOCHECKPOINT) > ::ChainActive().Tip()->nHeight)
-        pindex = pindex->pprev;
-    return pindex->GetBlockHash();
+    // Select the active chain block with specified depth policy
+    const int nTipHeight = ::ChainActive().Height();
+    const int nHeight = std::max<int64_t>(0, std::min<int64_t>(nTipHeight, nTipHeight - nDepth));
+    return ::ChainActive()[nHeight]->GetBlockHash();
 }
 
 // Check against synchronized checkpoint
@@ -197,52 +197,27 @@ bool CheckSyncCheckpoint(const uint256 hashBlock, const int nHeight)
         return true;
     }
 
-    CBlockIndex* tip = nullptr;
-    {
-        LOCK(cs_main);
-        tip = ::ChainActive().Tip();
-    }
-
-    {
-        LOCK(cs_hashSyncCheckpoint);
+    LOCK2(cs_main, cs_hashSyncCheckpoint);
 
-        // Checkpoint on default
-        if (hashSyncCheckpoint == uint256()) {
-            return true;
-        }
-    }
-
-    CBlockIndex* pindexSyncTemp = nullptr;
-    {
-        LOCK2(cs_main, cs_hashSyncCheckpoint);
-        // sync-checkpoint should always be accepted block
-        assert(::BlockIndex().count(hashSyncCheckpoint));
-        pindexSyncTemp = ::BlockIndex()[hashSyncCheckpoint];
+    // Checkpoint on default
+    if (hashSyncCheckpoint == uint256()) {
+        return true;
     }
 
-    const CBlockIndex* pindexSync = pindexSyncTemp;
-
-    {
-        LOCK(cs_hashSyncCheckpoint);
-        if (nHeight > pindexSync->nHeight)
-        {
-            // Trace back to same height as sync-checkpoint
-            const CBlockIndex* pindex = tip;
-            while (pindex->nHeight > pindexSync->nHeight)
-                if (!(pindex = pindex->pprev))
-                    return error("%s: pprev null - block index structure failure", __func__);
-            if (pindex->nHeight < pindexSync->nHeight || pindex->GetBlockHash() != hashSyncCheckpoint)
-                return false; // only descendant of sync-checkpoint can pass check
-        }
-        if (nHeight == pindexSync->nHeight && hashBlock != hashSyncCheckpoint)
-            return error("%s: Same height with sync-checkpoint", __func__);
-    }
+    // sync-checkpoint should always be accepted block
+    const CBlockIndex* pindexSync = GetSyncCheckpointIndex();
+    assert(pindexSync);
 
+    if (nHeight > pindexSync->nHeight)
     {
-        LOCK2(cs_main, cs_hashSyncCheckpoint);
-        if (nHeight < pindexSync->nHeight && !::BlockIndex().count(hashBlock))
-            return error("%s: Lower height than sync-checkpoint", __func__);
+        // Only descendant of sync-checkpoint can pass check
+        if (::ChainActive().Tip()->GetAncestor(pindexSync->nHeight) != pindexSync)
+            return false;
     }
+    if (nHeight == pindexSync->nHeight && hashBlock != hashSyncCheckpoint)
+        return error("%s: Same height with sync-checkpoint", __func__);
+    if (nHeight < pindexSync->nHeight && !LookupBlockIndex(hashBlock))
+        return error("%s: Lower height than sync-checkpoint", __func__);
     return true;
 }
 
@@ -383,11 +358,15 @@ uint256 CSyncCheckpoint::GetHash() const
 
 void CSyncCheckpoint::RelayTo(CNode* pfrom) const
 {
-    if (g_connman && pfrom->hashCheckpointKnown != hashCheckpoint && pfrom->supportACPMessages)
+    if (!g_connman)
+        return;
     {
+        LOCK(pfrom->cs_checkpointKnown);
+        if (pfrom->hashCheckpointKnown == hashCheckpoint || !pfrom->supportACPMessages)
+            return;
         pfrom->hashCheckpointKnown = hashCheckpoint;
-        g_connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::CHECKPOINT, *this));
     }
+    g_connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::CHECKPOINT, *this));
 }
 
 // Verify signature of sync-checkpoint message
@@ -413,7 +392,7 @@ bool CSyncCheckpoint::ProcessSyncCheckpoint()
     {
         LOCK2(cs_main, cs_hashSyncCheckpoint);
 
-        if (!::BlockIndex().count(hashCheckpoint)) {
+        if (!LookupBlockIndex(hashCheckpoint)) {
             // We haven't received the checkpoint chain, keep the checkpoint as pending
             hashPendingCheckpoint = hashCheckpoint;
             checkpointMessagePending = *this;
@@ -433,7 +412,7 @@ bool CSyncCheckpoint::ProcessSyncCheckpoint()
         LOCK2(cs_main, cs_hashSyncCheckpoint);
 
         // Check if we're on a fork
-        index = ::BlockIndex()[hashCheckpoint];
+        index = LookupBlockIndex(hashCheckpoint);
         if (!::ChainActive().Contains(index)) {
             auto ancestor = LastCommonAncestor(index, ::ChainActive().Tip());
             bad_fork = ::ChainActive().Next(ancestor);
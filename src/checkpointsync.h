@@ -23,6 +23,7 @@ extern uint256 hashSyncCheckpoint;
 extern CSyncCheckpoint checkpointMessage;
 extern CCriticalSection cs_hashSyncCheckpoint;
 
+bool ValidateSyncCheckpoint(uint256 hashCheckpoint);
 bool WriteSyncCheckpoint(const uint256& hashCheckpoint);
 bool AcceptPendingSyncCheckpoint();
 uint256 AutoSelectSyncCheckpoint();
@@ -30,6 +31,8 @@ bool CheckSyncCheckpoint(const uint256 hashBlock, const int nHeight);
 bool CheckCheckpointPubKey();
 bool SetCheckpointPrivKey(std::string strPrivKey);
 bool SendSyncCheckpoint(uint256 hashCheckpoint);
+/** Forget the cached sync-checkpoint block index entry, see UnloadBlockIndex(). */
+void UnloadSyncCheckpoint();
 
 // Synchronized checkpoint (introduced first in ppcoin)
 class CUnsignedSyncCheckpoint
@@ -1957,7 +1957,8 @@ void neoscrypt_blake2s(const void *input, const unsigned int input_size,
     neoscrypt_copy(output, S, output_size);
 }
 
-#ifndef OPT
+/* Both FastKDF implementations below are always built;
+ * OPT selects the one used by the NeoScrypt core engine */
 
 #define FASTKDF_BUFFER_SIZE 256U
 
@@ -2053,8 +2054,6 @@ void neoscrypt_fastkdf(const unsigned char *password, unsigned int password_len,
 
 }
 
-#else
-
 /* Initialisation vector with a parameter block XOR'ed in */
 static const unsigned int blake2s_IV_P_XOR[8] = {
     0x6B08C647, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
@@ -2145,8 +2144,6 @@ void neoscrypt_fastkdf_opt(const unsigned char *password, const unsigned char *s
     }
 }
 
-#endif /* !(OPT) */
-
 
 /* Configurable optimised block mixer */
 static void neoscrypt_blkmix(unsigned int *X, unsigned int *Y, unsigned int r, unsigned int mixmode) {
@@ -2220,6 +2217,57 @@ static void neoscrypt_blkmix(unsigned int *X, unsigned int *Y, unsigned int r, u
 }
 
 
+/* X = KDF(password, salt = password) as used by the NeoScrypt core engine;
+ * the KDF is selected by profile bits 4 to 1, X is r * 2 * BLOCK_SIZE bytes */
+void neoscrypt_kdf_in(const unsigned char *password, unsigned char *X,
+  unsigned int r, unsigned int profile) {
+
+    switch((profile >> 1) & 0xF) {
+
+        default:
+        case(0x0):
+#ifdef OPT
+            neoscrypt_fastkdf_opt(password, password, X, 0);
+#else
+            neoscrypt_fastkdf(password, 80, password, 80, 32,
+              X, r * 2 * BLOCK_SIZE);
+#endif
+            break;
+
+        case(0x1):
+            neoscrypt_pbkdf2_sha256(password, 80, password, 80, 1,
+              X, r * 2 * BLOCK_SIZE);
+            break;
+
+    }
+}
+
+/* output = KDF(password, salt = X) as used by the NeoScrypt core engine;
+ * the KDF is selected by profile bits 4 to 1, output is 32 bytes */
+void neoscrypt_kdf_out(const unsigned char *password, const unsigned char *X,
+  unsigned char *output, unsigned int r, unsigned int profile) {
+
+    switch((profile >> 1) & 0xF) {
+
+        default:
+        case(0x0):
+#ifdef OPT
+            neoscrypt_fastkdf_opt(password, X, output, 1);
+#else
+            neoscrypt_fastkdf(password, 80, X,
+              r * 2 * BLOCK_SIZE, 32, output, 32);
+#endif
+            break;
+
+        case(0x1):
+            neoscrypt_pbkdf2_sha256(password, 80, X,
+              r * 2 * BLOCK_SIZE, 1, output, 32);
+            break;
+
+    }
+}
+
+
 /* NeoScrypt core engine:
  * p = 1, salt = password;
  * Basic customisation (required):
@@ -2254,7 +2302,7 @@ static void neoscrypt_blkmix(unsigned int *X, unsigned int *Y, unsigned int r, u
 void neoscrypt(const unsigned char *password, unsigned char *output, unsigned int profile) {
     const size_t stack_align = 0x40;
     unsigned int N = 128, r = 2, dblmix = 1, mixmode = 0x14;
-    unsigned int kdf, i, j;
+    unsigned int i, j;
     unsigned int *X, *Y, *Z, *V;
 
     if(profile & 0x1) {
@@ -2280,26 +2328,7 @@ void neoscrypt(const unsigned char *password, unsigned char *output, unsigned in
     V = &X[96 * r];
 
     /* X = KDF(password, salt) */
-    kdf = (profile >> 1) & 0xF;
-
-    switch(kdf) {
-
-        default:
-        case(0x0):
-#ifdef OPT
-            neoscrypt_fastkdf_opt(password, password, (unsigned char *) X, 0);
-#else
-            neoscrypt_fastkdf(password, 80, password, 80, 32,
-              (unsigned char *) X, r * 2 * BLOCK_SIZE);
-#endif
-            break;
-
-        case(0x1):
-            neoscrypt_pbkdf2_sha256(password, 80, password, 80, 1,
-              (unsigned char *) X, r * 2 * BLOCK_SIZE);
-            break;
-
-    }
+    neoscrypt_kdf_in(password, (unsigned char *) X, r, profile);
 
     /* Process ChaCha 1st, Salsa 2nd and XOR them into FastKDF; otherwise Salsa only */
 
@@ -2346,23 +2375,6 @@ void neoscrypt(const unsigned char *password, unsigned char *output, unsigned in
       neoscrypt_blkxor(&X[0], &Z[0], r * 2 * BLOCK_SIZE);
 
     /* output = KDF(password, X) */
-    switch(kdf) {
-
-        default:
-        case(0x0):
-#ifdef OPT
-            neoscrypt_fastkdf_opt(password, (unsigned char *) X, output, 1);
-#else
-            neoscrypt_fastkdf(password, 80, (unsigned char *) X,
-              r * 2 * BLOCK_SIZE, 32, output, 32);
-#endif
-            break;
-
-        case(0x1):
-            neoscrypt_pbkdf2_sha256(password, 80, (unsigned char *) X,
-              r * 2 * BLOCK_SIZE, 1, output, 32);
-            break;
-
-    }
+    neoscrypt_kdf_out(password, (unsigned char *) X, output, r, profile);
 
 }
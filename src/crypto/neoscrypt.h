@@ -12,12 +12,40 @@ void neoscrypt_blake2s(const void *input, const unsigned int input_size,
   const void *key, const unsigned char key_size,
   void *output, const unsigned char output_size);
 
+void neoscrypt_fastkdf(const unsigned char *password, unsigned int password_len,
+  const unsigned char *salt, unsigned int salt_len, unsigned int N,
+  unsigned char *output, unsigned int output_len);
+void neoscrypt_fastkdf_opt(const unsigned char *password, const unsigned char *salt,
+  unsigned char *output, unsigned int mode);
+
+void neoscrypt_kdf_in(const unsigned char *password, unsigned char *X,
+  unsigned int r, unsigned int profile);
+void neoscrypt_kdf_out(const unsigned char *password, const unsigned char *X,
+  unsigned char *output, unsigned int r, unsigned int profile);
+
 void neoscrypt_copy(void *dstp, const void *srcp, unsigned int len);
 void neoscrypt_erase(void *dstp, unsigned int len);
 void neoscrypt_xor(void *dstp, const void *srcp, unsigned int len);
 
 #if (__cplusplus)
 }
+
+#include <stddef.h>
+#include <string>
+
+/** Autodetect the best available multi-lane NeoScrypt implementation.
+ *  Returns the name of the implementation.
+ */
+std::string NeoScryptAutoDetect();
+
+/** Compute the NeoScrypt hashes of multiple 80-byte block headers.
+ *  output:  pointer to a count*32 byte output buffer
+ *  input:   pointer to a count*80 byte input buffer
+ *  count:   the number of headers to hash
+ *  profile: the neoscrypt() profile shared by all headers
+ */
+void NeoScryptBatch(unsigned char* output, const unsigned char* input, size_t count, unsigned int profile);
+
 #else
 
 #ifndef MIN
@@ -0,0 +1,48 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/neoscrypt_lanes.h>
+
+namespace neoscrypt_avx2 {
+namespace {
+
+struct Ops
+{
+    typedef __m256i vec;
+    static const unsigned int LANES = 8;
+
+    static inline vec Load(const uint32_t* p) { return _mm256_load_si256((const __m256i*)p); }
+    static inline void Store(uint32_t* p, vec x) { _mm256_store_si256((__m256i*)p, x); }
+    static inline vec Add(vec x, vec y) { return _mm256_add_epi32(x, y); }
+    static inline vec Xor(vec x, vec y) { return _mm256_xor_si256(x, y); }
+    template <int n> static inline vec RotL(vec x) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+};
+
+// Rotations by whole bytes are a single byte shuffle
+template <> inline __m256i Ops::RotL<8>(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+                                                  14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+}
+template <> inline __m256i Ops::RotL<16>(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                                                  13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+}
+
+void Hash_8way(unsigned char* out, const unsigned char* in, unsigned int profile, uint32_t* scratch)
+{
+    neoscrypt_lanes::Engine<Ops>::Hash(out, in, profile, scratch);
+}
+
+}
+
+#endif
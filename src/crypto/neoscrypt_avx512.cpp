@@ -0,0 +1,38 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX512
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/neoscrypt_lanes.h>
+
+namespace neoscrypt_avx512 {
+namespace {
+
+struct Ops
+{
+    typedef __m512i vec;
+    static const unsigned int LANES = 16;
+
+    static inline vec Load(const uint32_t* p) { return _mm512_load_si512((const void*)p); }
+    static inline void Store(uint32_t* p, vec x) { _mm512_store_si512((void*)p, x); }
+    static inline vec Add(vec x, vec y) { return _mm512_add_epi32(x, y); }
+    static inline vec Xor(vec x, vec y) { return _mm512_xor_si512(x, y); }
+    // The zero-masked form, as the unmasked intrinsics pass GCC an undefined
+    // source vector and trip -Wmaybe-uninitialized
+    template <int n> static inline vec RotL(vec x) { return _mm512_maskz_rol_epi32((__mmask16)0xFFFF, x, n); }
+};
+
+}
+
+void Hash_16way(unsigned char* out, const unsigned char* in, unsigned int profile, uint32_t* scratch)
+{
+    neoscrypt_lanes::Engine<Ops>::Hash(out, in, profile, scratch);
+}
+
+}
+
+#endif
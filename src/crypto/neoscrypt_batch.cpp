@@ -0,0 +1,200 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/neoscrypt.h>
+#include <crypto/neoscrypt_lanes.h>
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <string.h>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace neoscrypt_sse2
+{
+void Hash_4way(unsigned char* out, const unsigned char* in, unsigned int profile, uint32_t* scratch);
+}
+
+namespace neoscrypt_avx2
+{
+void Hash_8way(unsigned char* out, const unsigned char* in, unsigned int profile, uint32_t* scratch);
+}
+
+namespace neoscrypt_avx512
+{
+void Hash_16way(unsigned char* out, const unsigned char* in, unsigned int profile, uint32_t* scratch);
+}
+
+namespace
+{
+typedef void (*HashLanesFn)(unsigned char*, const unsigned char*, unsigned int, uint32_t*);
+
+HashLanesFn Hash_4way = nullptr;
+HashLanesFn Hash_8way = nullptr;
+HashLanesFn Hash_16way = nullptr;
+} // namespace
+
+void NeoScryptBatch(unsigned char* output, const unsigned char* input, size_t count, unsigned int profile)
+{
+    const size_t max_lanes = Hash_16way ? 16 : Hash_8way ? 8 : Hash_4way ? 4 : 1;
+    if (max_lanes == 1 || count < 2) {
+        for (size_t i = 0; i < count; i++) neoscrypt(input + 80 * i, output + 32 * i, profile);
+        return;
+    }
+
+    // One 64-byte aligned scratch area is reused for all lane groups
+    const neoscrypt_lanes::Params params(profile);
+    const size_t scratch_words = (params.N + 3) * params.Words() * max_lanes;
+    std::unique_ptr<uint32_t[]> scratch_buf(new uint32_t[scratch_words + 16]);
+    uint32_t* scratch = (uint32_t*)(((uintptr_t)scratch_buf.get() + 63) & ~(uintptr_t)63);
+
+    while (count) {
+        size_t lanes = 1;
+        HashLanesFn fn = nullptr;
+        if (Hash_16way && count >= 12) {
+            lanes = 16; fn = Hash_16way;
+        } else if (Hash_8way && count >= 6) {
+            lanes = 8; fn = Hash_8way;
+        } else if (Hash_4way && count >= 2) {
+            lanes = 4; fn = Hash_4way;
+        } else if (Hash_8way && count >= 2) {
+            lanes = 8; fn = Hash_8way;
+        } else if (Hash_16way && count >= 2) {
+            lanes = 16; fn = Hash_16way;
+        }
+
+        if (!fn) {
+            neoscrypt(input, output, profile);
+            input += 80;
+            output += 32;
+            count--;
+            continue;
+        }
+
+        if (count >= lanes) {
+            fn(output, input, profile, scratch);
+            input += 80 * lanes;
+            output += 32 * lanes;
+            count -= lanes;
+            continue;
+        }
+
+        // Fill the unused lanes of the last group with copies of the last header
+        unsigned char in_buf[16 * 80];
+        unsigned char out_buf[16 * 32];
+        memcpy(in_buf, input, 80 * count);
+        for (size_t i = count; i < lanes; i++) memcpy(in_buf + 80 * i, input + 80 * (count - 1), 80);
+        fn(out_buf, in_buf, profile, scratch);
+        memcpy(output, out_buf, 32 * count);
+        count = 0;
+    }
+}
+
+namespace
+{
+bool SelfTest()
+{
+    // Compare the batch result against neoscrypt() for both profiles in use
+    // and a count that exercises full as well as padded lane groups.
+    static const size_t COUNT = 19;
+    static const unsigned int PROFILES[] = {0x0, 0x3};
+
+    unsigned char input[COUNT * 80];
+    for (size_t i = 0; i < sizeof(input); i++) input[i] = (unsigned char)(i * 7 + (i >> 8));
+
+    for (unsigned int profile : PROFILES) {
+        unsigned char expected[COUNT * 32];
+        unsigned char out[COUNT * 32];
+        for (size_t i = 0; i < COUNT; i++) neoscrypt(input + 80 * i, expected + 32 * i, profile);
+        NeoScryptBatch(out, input, COUNT, profile);
+        if (memcmp(out, expected, sizeof(out))) return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Return the OS-enabled state components of XCR0. */
+uint32_t GetXCR0()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return a;
+}
+#endif
+} // namespace
+
+
+std::string NeoScryptAutoDetect()
+{
+    std::string ret = "standard";
+    Hash_4way = nullptr;
+    Hash_8way = nullptr;
+    Hash_16way = nullptr;
+
+#if defined(__SSE2__)
+    // SSE2 is part of the baseline of every target that defines __SSE2__
+    Hash_4way = neoscrypt_sse2::Hash_4way;
+    ret = "sse2(4way)";
+#endif
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_avx2 = false;
+    bool have_avx512 = false;
+    bool enabled_avx = false;
+    bool enabled_avx512 = false;
+
+    (void)have_avx2;
+    (void)have_avx512;
+    (void)enabled_avx;
+    (void)enabled_avx512;
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    const bool have_xsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        const uint32_t xcr0 = GetXCR0();
+        enabled_avx = (xcr0 & 0x06) == 0x06;
+        enabled_avx512 = (xcr0 & 0xE6) == 0xE6;
+    }
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    if (eax >= 7) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+        have_avx512 = (ebx >> 16) & 1;
+    }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        Hash_8way = neoscrypt_avx2::Hash_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX512) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx512 && enabled_avx512) {
+        Hash_16way = neoscrypt_avx512::Hash_16way;
+        ret += ",avx512(16way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
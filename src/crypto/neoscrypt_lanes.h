@@ -0,0 +1,221 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_NEOSCRYPT_LANES_H
+#define BITCOIN_CRYPTO_NEOSCRYPT_LANES_H
+
+// Multi-lane NeoScrypt core engine, shared by the SSE2, AVX2 and AVX-512
+// implementations. Only include this from the translation units that
+// instantiate it for a particular instruction set.
+
+#include <crypto/neoscrypt.h>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace neoscrypt_lanes {
+
+/** NeoScrypt parameters selected by a profile, see neoscrypt(). */
+struct Params
+{
+    unsigned int N;
+    unsigned int r;
+    bool dblmix;
+    unsigned int rounds;
+
+    explicit Params(unsigned int profile) : N(128), r(2), dblmix(true), rounds(20)
+    {
+        if (profile & 0x1) {
+            N = 1024;
+            r = 1;
+            dblmix = false;
+            rounds = 8;
+        }
+        if (profile >> 31) {
+            N = 1U << (((profile >> 8) & 0x1F) + 1);
+            r = 1U << ((profile >> 5) & 0x7);
+        }
+    }
+
+    /** Number of 32-bit words in one lane of X. */
+    size_t Words() const { return 32 * r; }
+};
+
+/**
+ * The state of all lanes is stored interleaved: word w of lane l lives at
+ * index w * LANES + l, so that every vector holds the same word of all lanes.
+ *
+ * Ops provides the vector type and the following static members:
+ *   LANES, Load, Store, Add, Xor and RotL<n>.
+ */
+template <typename Ops>
+class Engine
+{
+    typedef typename Ops::vec vec;
+    static const unsigned int L = Ops::LANES;
+
+    static inline void Salsa(uint32_t* X, unsigned int rounds)
+    {
+        vec x[16], t;
+        for (int i = 0; i < 16; i++) x[i] = Ops::Load(X + i * L);
+
+#define QUARTER(a, b, c, d) \
+    t = Ops::Add(x[a], x[d]); x[b] = Ops::Xor(x[b], Ops::template RotL<7>(t)); \
+    t = Ops::Add(x[b], x[a]); x[c] = Ops::Xor(x[c], Ops::template RotL<9>(t)); \
+    t = Ops::Add(x[c], x[b]); x[d] = Ops::Xor(x[d], Ops::template RotL<13>(t)); \
+    t = Ops::Add(x[d], x[c]); x[a] = Ops::Xor(x[a], Ops::template RotL<18>(t));
+
+        for (; rounds; rounds -= 2) {
+            QUARTER( 0,  4,  8, 12);
+            QUARTER( 5,  9, 13,  1);
+            QUARTER(10, 14,  2,  6);
+            QUARTER(15,  3,  7, 11);
+            QUARTER( 0,  1,  2,  3);
+            QUARTER( 5,  6,  7,  4);
+            QUARTER(10, 11,  8,  9);
+            QUARTER(15, 12, 13, 14);
+        }
+#undef QUARTER
+
+        for (int i = 0; i < 16; i++) Ops::Store(X + i * L, Ops::Add(Ops::Load(X + i * L), x[i]));
+    }
+
+    static inline void ChaCha(uint32_t* X, unsigned int rounds)
+    {
+        vec x[16];
+        for (int i = 0; i < 16; i++) x[i] = Ops::Load(X + i * L);
+
+#define QUARTER(a, b, c, d) \
+    x[a] = Ops::Add(x[a], x[b]); x[d] = Ops::template RotL<16>(Ops::Xor(x[d], x[a])); \
+    x[c] = Ops::Add(x[c], x[d]); x[b] = Ops::template RotL<12>(Ops::Xor(x[b], x[c])); \
+    x[a] = Ops::Add(x[a], x[b]); x[d] = Ops::template RotL<8>(Ops::Xor(x[d], x[a])); \
+    x[c] = Ops::Add(x[c], x[d]); x[b] = Ops::template RotL<7>(Ops::Xor(x[b], x[c]));
+
+        for (; rounds; rounds -= 2) {
+            QUARTER(0, 4,  8, 12);
+            QUARTER(1, 5,  9, 13);
+            QUARTER(2, 6, 10, 14);
+            QUARTER(3, 7, 11, 15);
+            QUARTER(0, 5, 10, 15);
+            QUARTER(1, 6, 11, 12);
+            QUARTER(2, 7,  8, 13);
+            QUARTER(3, 4,  9, 14);
+        }
+#undef QUARTER
+
+        for (int i = 0; i < 16; i++) Ops::Store(X + i * L, Ops::Add(Ops::Load(X + i * L), x[i]));
+    }
+
+    /** dst ^= src, words is the number of words per lane. */
+    static inline void BlkXor(uint32_t* dst, const uint32_t* src, size_t words)
+    {
+        for (size_t i = 0; i < words * L; i += L) Ops::Store(dst + i, Ops::Xor(Ops::Load(dst + i), Ops::Load(src + i)));
+    }
+
+    static inline void BlkCpy(uint32_t* dst, const uint32_t* src, size_t words)
+    {
+        for (size_t i = 0; i < words * L; i += L) Ops::Store(dst + i, Ops::Load(src + i));
+    }
+
+    static inline void BlkSwp(uint32_t* a, uint32_t* b, size_t words)
+    {
+        for (size_t i = 0; i < words * L; i += L) {
+            vec t = Ops::Load(a + i);
+            Ops::Store(a + i, Ops::Load(b + i));
+            Ops::Store(b + i, t);
+        }
+    }
+
+    /** The NeoScrypt block mixer (neoscrypt_blkmix) applied to all lanes. */
+    static void BlkMix(uint32_t* X, uint32_t* Y, unsigned int r, unsigned int rounds, bool chacha)
+    {
+        const size_t blk = 16 * L;
+        for (unsigned int i = 0; i < 2 * r; i++) {
+            BlkXor(&X[blk * i], &X[blk * (i ? i - 1 : 2 * r - 1)], 16);
+            if (chacha) {
+                ChaCha(&X[blk * i], rounds);
+            } else {
+                Salsa(&X[blk * i], rounds);
+            }
+        }
+        if (r == 1) return;
+        if (r == 2) {
+            BlkSwp(&X[blk], &X[2 * blk], 16);
+            return;
+        }
+        BlkCpy(Y, X, 32 * r);
+        for (unsigned int i = 0; i < r; i++) {
+            BlkCpy(&X[blk * i], &Y[blk * 2 * i], 16);
+            BlkCpy(&X[blk * (i + r)], &Y[blk * (2 * i + 1)], 16);
+        }
+    }
+
+    /** SMix of all lanes of X, using V as N * X sized scratch space. */
+    static void SMix(uint32_t* X, uint32_t* Y, uint32_t* V, const Params& p, bool chacha)
+    {
+        const size_t words = p.Words();
+        const size_t stride = words * L;
+
+        for (unsigned int i = 0; i < p.N; i++) {
+            BlkCpy(&V[i * stride], X, words);
+            BlkMix(X, Y, p.r, p.rounds, chacha);
+        }
+        for (unsigned int i = 0; i < p.N; i++) {
+            // integerify(X) mod N differs per lane, so the XOR with V is done lane by lane
+            const uint32_t* last = &X[16 * (2 * p.r - 1) * L];
+            for (unsigned int l = 0; l < L; l++) {
+                const uint32_t* v = &V[(last[l] & (p.N - 1)) * stride + l];
+                uint32_t* x = X + l;
+                for (size_t w = 0; w < stride; w += L) x[w] ^= v[w];
+            }
+            BlkMix(X, Y, p.r, p.rounds, chacha);
+        }
+    }
+
+public:
+    /** Number of 32-bit words of scratch space Hash() needs for a profile. */
+    static size_t ScratchWords(unsigned int profile)
+    {
+        Params p(profile);
+        return (p.N + 3) * p.Words() * L;
+    }
+
+    /**
+     * Hash LANES 80-byte inputs at once. scratch must be aligned to 64 bytes
+     * and hold ScratchWords(profile) words.
+     */
+    static void Hash(unsigned char* output, const unsigned char* input, unsigned int profile, uint32_t* scratch)
+    {
+        const Params p(profile);
+        const size_t words = p.Words();
+        uint32_t* X = scratch;
+        uint32_t* Z = X + words * L;
+        uint32_t* Y = Z + words * L;
+        uint32_t* V = Y + words * L;
+
+        // X = KDF(password, salt), computed lane by lane in Y and interleaved into X
+        unsigned char* lane = (unsigned char*)Y;
+        for (unsigned int l = 0; l < L; l++) {
+            neoscrypt_kdf_in(input + 80 * l, lane, p.r, profile);
+            for (size_t w = 0; w < words; w++) memcpy(&X[w * L + l], lane + 4 * w, 4);
+        }
+
+        if (p.dblmix) {
+            BlkCpy(Z, X, words);
+            SMix(Z, Y, V, p, true);
+        }
+        SMix(X, Y, V, p, false);
+        if (p.dblmix) BlkXor(X, Z, words);
+
+        // output = KDF(password, X), lane by lane
+        for (unsigned int l = 0; l < L; l++) {
+            for (size_t w = 0; w < words; w++) memcpy(lane + 4 * w, &X[w * L + l], 4);
+            neoscrypt_kdf_out(input + 80 * l, lane, output + 32 * l, p.r, profile);
+        }
+    }
+};
+
+} // namespace neoscrypt_lanes
+
+#endif // BITCOIN_CRYPTO_NEOSCRYPT_LANES_H
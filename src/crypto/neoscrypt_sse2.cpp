@@ -0,0 +1,36 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(__SSE2__)
+
+#include <stdint.h>
+#include <emmintrin.h>
+
+#include <crypto/neoscrypt_lanes.h>
+
+namespace neoscrypt_sse2 {
+namespace {
+
+struct Ops
+{
+    typedef __m128i vec;
+    static const unsigned int LANES = 4;
+
+    static inline vec Load(const uint32_t* p) { return _mm_load_si128((const __m128i*)p); }
+    static inline void Store(uint32_t* p, vec x) { _mm_store_si128((__m128i*)p, x); }
+    static inline vec Add(vec x, vec y) { return _mm_add_epi32(x, y); }
+    static inline vec Xor(vec x, vec y) { return _mm_xor_si128(x, y); }
+    template <int n> static inline vec RotL(vec x) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+};
+
+}
+
+void Hash_4way(unsigned char* out, const unsigned char* in, unsigned int profile, uint32_t* scratch)
+{
+    neoscrypt_lanes::Engine<Ops>::Hash(out, in, profile, scratch);
+}
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_CUCKOOCACHE_H
 #define BITCOIN_CUCKOOCACHE_H
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cmath>
@@ -475,6 +476,21 @@ public:
             }
         return false;
     }
+
+    /** for_each calls fn on every element in the cache which has not been
+     * erased, in no particular order.
+     *
+     * Requires no concurrent Write, like contains.
+     *
+     * @param fn callable taking a const Element&
+     */
+    template <typename Fn>
+    void for_each(Fn fn) const
+    {
+        for (uint32_t i = 0; i < size; ++i)
+            if (!collection_flags.bit_is_set(i))
+                fn(table[i]);
+    }
 };
 } // namespace CuckooCache
 
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_FLATFILE_H
 #define BITCOIN_FLATFILE_H
 
+#include <memory>
 #include <string>
 
 #include <fs.h>
@@ -45,6 +46,31 @@ struct FlatFilePos
     std::string ToString() const;
 };
 
+/**
+ * A read-only memory mapping of a flat file, as large as the file was when it
+ * was mapped. The mapping stays readable while references to it are held, also
+ * after the file is deleted.
+ */
+class MappedFlatFile
+{
+private:
+    const unsigned char* const m_data;
+    const size_t m_size;
+
+    MappedFlatFile(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+public:
+    /** Map the file at the given path. Returns nullptr if it is empty or cannot be mapped. */
+    static std::shared_ptr<const MappedFlatFile> Map(const fs::path& path);
+
+    ~MappedFlatFile();
+    MappedFlatFile(const MappedFlatFile&) = delete;
+    MappedFlatFile& operator=(const MappedFlatFile&) = delete;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
 /**
  * FlatFileSeq represents a sequence of numbered files storing raw data. This class facilitates
  * access to and efficient management of these files.
@@ -72,6 +98,9 @@ public:
     /** Open a handle to the file at the given position. */
     FILE* Open(const FlatFilePos& pos, bool read_only = false);
 
+    /** Map the file at the given position for reading, see MappedFlatFile. */
+    std::shared_ptr<const MappedFlatFile> Map(const FlatFilePos& pos) const;
+
     /**
      * Allocate additional space in a file after the given starting position. The amount allocated
      * will be the minimum multiple of the sequence chunk size greater than add_size.
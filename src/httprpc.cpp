@@ -8,6 +8,7 @@
 #include <crypto/hmac_sha256.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <sync.h>
@@ -188,9 +189,25 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
+            jreq.stream_result = std::make_shared<RPCStreamWriteFn>();
 
             UniValue result = tableRPC.execute(jreq);
 
+            if (*jreq.stream_result) {
+                WriteJSONStreamReply(req, [&jreq](JSONStreamWriter& writer) {
+                    // Same layout as JSONRPCReplyObj
+                    writer.BeginObject();
+                    writer.Key("result");
+                    (*jreq.stream_result)(writer);
+                    writer.Key("error");
+                    writer.Value(NullUniValue);
+                    writer.Key("id");
+                    writer.Value(jreq.id);
+                    writer.EndObject();
+                });
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
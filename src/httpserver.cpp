@@ -15,6 +15,8 @@
 #include <sync.h>
 #include <ui_interface.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <memory>
 #include <stdio.h>
@@ -517,6 +519,10 @@ HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
 }
 HTTPRequest::~HTTPRequest()
 {
+    if (m_chunked_reply) {
+        // The body was cut short, complete the reply with what was sent
+        EndChunkedReply();
+    }
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
@@ -563,6 +569,19 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/** Re-enable reading from the socket of a connection once its reply is sent.
+ * This is the second part of the libevent workaround in http_request_cb.
+ */
+static void EnableConnectionRead(evhttp_connection* conn)
+{
+    if (conn && event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+        if (bev) {
+            bufferevent_enable(bev, EV_READ | EV_WRITE);
+        }
+    }
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -581,20 +600,122 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+        EnableConnectionRead(evhttp_request_get_connection(req_copy));
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+/** A reply sent in chunks. The worker thread writing the body waits on it
+ * while the main http thread sends the chunks, so that at most
+ * MAX_HTTP_PENDING_CHUNK_BYTES of the body are held in buffers at a time.
+ */
+class HTTPRequest::ChunkedReply
+{
+public:
+    ChunkedReply(struct evhttp_request* req_in, bool has_body_in) : req(req_in), has_body(has_body_in) {}
+
+    //! Only to be used from the main http thread
+    struct evhttp_request* const req;
+    //! Whether a body is sent at all. libevent sends none in reply to HEAD,
+    //! and never calls OnSent for the chunks.
+    const bool has_body;
+
+    Mutex cs;
+    std::condition_variable cond;
+    //! Whether the connection was closed before the reply was complete
+    bool closed GUARDED_BY(cs){false};
+    //! Bytes of the body passed to WriteReplyChunk
+    size_t bytes_written GUARDED_BY(cs){0};
+    //! Bytes of the body sent on the connection
+    size_t bytes_sent GUARDED_BY(cs){0};
+    //! Bytes of the body handed to libevent, only used from the main http thread
+    size_t bytes_queued{0};
+
+    //! Called by libevent when the connection closes
+    static void OnClose(struct evhttp_connection*, void* arg)
+    {
+        ChunkedReply* reply = static_cast<ChunkedReply*>(arg);
+        LOCK(reply->cs);
+        reply->closed = true;
+        reply->cond.notify_all();
+    }
+
+    //! Called by libevent once all chunks handed to it are sent
+    static void OnSent(struct evhttp_connection*, void* arg)
+    {
+        ChunkedReply* reply = static_cast<ChunkedReply*>(arg);
+        LOCK(reply->cs);
+        reply->bytes_sent = reply->bytes_queued;
+        reply->cond.notify_all();
+    }
+};
+
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && req && !m_chunked_reply);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    m_chunked_reply = std::make_shared<ChunkedReply>(req, GetRequestMethod() != HEAD);
+    auto reply = m_chunked_reply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [reply, nStatus]{
+        evhttp_connection* conn = evhttp_request_get_connection(reply->req);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, ChunkedReply::OnClose, reply.get());
         }
+        evhttp_send_reply_start(reply->req, nStatus, nullptr);
     });
     ev->trigger(nullptr);
     replySent = true;
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& chunk)
+{
+    assert(m_chunked_reply);
+    ChunkedReply& reply = *m_chunked_reply;
+    if (!reply.has_body) return false;
+    {
+        WAIT_LOCK(reply.cs, lock);
+        while (!reply.closed && reply.bytes_written - reply.bytes_sent > MAX_HTTP_PENDING_CHUNK_BYTES) {
+            // Do not hold up shutdown for a client that stopped reading
+            if (ShutdownRequested()) return false;
+            reply.cond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (reply.closed) return false;
+        reply.bytes_written += chunk.size();
+    }
+
+    struct evbuffer* evb = evbuffer_new();
+    evbuffer_add(evb, chunk.data(), chunk.size());
+    auto reply_copy = m_chunked_reply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [reply_copy, evb]{
+        if (!WITH_LOCK(reply_copy->cs, return reply_copy->closed)) {
+            reply_copy->bytes_queued += evbuffer_get_length(evb);
+            evhttp_send_reply_chunk_with_cb(reply_copy->req, evb, ChunkedReply::OnSent, reply_copy.get());
+        }
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+    return true;
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(m_chunked_reply);
+    auto reply = std::move(m_chunked_reply);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [reply]{
+        // The callbacks must not outlive the reply. A request whose
+        // connection closed is detached from it, and freed here.
+        evhttp_connection* conn = evhttp_request_get_connection(reply->req);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        }
+        evhttp_send_reply_end(reply->req);
+        EnableConnectionRead(conn);
+    });
+    ev->trigger(nullptr);
     req = nullptr; // transferred back to main thread
 }
 
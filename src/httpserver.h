@@ -8,10 +8,13 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Bytes of a chunked reply that may be waiting to be sent before WriteReplyChunk blocks */
+static const size_t MAX_HTTP_PENDING_CHUNK_BYTES = 4 * 1024 * 1024;
 
 struct evhttp_request;
 struct event_base;
@@ -60,6 +63,10 @@ private:
     struct evhttp_request* req;
     bool replySent;
 
+    /** State of a reply started with StartChunkedReply, shared with the main http thread */
+    class ChunkedReply;
+    std::shared_ptr<ChunkedReply> m_chunked_reply;
+
 public:
     explicit HTTPRequest(struct evhttp_request* req);
     ~HTTPRequest();
@@ -114,6 +121,32 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a HTTP reply whose body is sent in parts with WriteReplyChunk,
+     * using chunked transfer encoding, so that a large body need not be held
+     * in memory at once.
+     *
+     * @note Call this instead of WriteReply, then EndChunkedReply once the
+     * body is written.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Send a part of the body of a reply started with StartChunkedReply.
+     * Blocks while more than MAX_HTTP_PENDING_CHUNK_BYTES of the body are
+     * waiting to be sent. Returns false if the connection was closed, or if
+     * the reply has no body (a HEAD request), in which case the rest of the
+     * body may be skipped.
+     */
+    bool WriteReplyChunk(const std::string& chunk);
+
+    /**
+     * Complete a reply started with StartChunkedReply. As this will give the
+     * request back to the main thread, do not call any other HTTPRequest
+     * methods after calling this.
+     */
+    void EndChunkedReply();
 };
 
 /** Event handler closure.
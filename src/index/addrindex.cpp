@@ -0,0 +1,334 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <crypto/sha256.h>
+#include <index/addrindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores two kinds of entries for each script, both keyed by the SHA256 hash of
+ * the scriptPubKey so that the entries of a script are adjacent:
+ *
+ * Events have keys of the type [DB_ADDR_EVENT, uint256, uint32 (BE) height, uint32 (BE) tx position,
+ * uint8 spend, uint32 (BE) index]. An event is an output paying to the script, or an input spending
+ * such an output. Heights and positions are big-endian so that a script's history is read in chain
+ * order by a single range scan.
+ *
+ * Unspent outputs have keys of the type [DB_ADDR_UNSPENT, uint256, uint32 (BE) height, uint256 txid,
+ * uint32 (BE) n], and the output value as value. They are erased when spent in the indexed chain
+ * and restored on a rewind.
+ *
+ * The genesis block and unspendable outputs are not indexed.
+ */
+constexpr char DB_ADDR_EVENT = 'a';
+constexpr char DB_ADDR_UNSPENT = 'u';
+
+std::unique_ptr<AddrIndex> g_addrindex;
+
+namespace {
+
+struct DBEventKey {
+    uint256 script_hash;
+    int height;
+    uint32_t tx_pos;
+    bool spend;
+    uint32_t index;
+
+    DBEventKey() : height(0), tx_pos(0), spend(false), index(0) {}
+    DBEventKey(const uint256& script_hash_in, int height_in, uint32_t tx_pos_in, bool spend_in, uint32_t index_in) :
+        script_hash(script_hash_in), height(height_in), tx_pos(tx_pos_in), spend(spend_in), index(index_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDR_EVENT);
+        s << script_hash;
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, tx_pos);
+        ser_writedata8(s, spend);
+        ser_writedata32be(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDR_EVENT) {
+            throw std::ios_base::failure("Invalid format for address index DB event key");
+        }
+        s >> script_hash;
+        height = ser_readdata32be(s);
+        tx_pos = ser_readdata32be(s);
+        spend = ser_readdata8(s);
+        index = ser_readdata32be(s);
+    }
+
+    friend bool operator==(const DBEventKey& a, const DBEventKey& b)
+    {
+        return a.script_hash == b.script_hash && a.height == b.height && a.tx_pos == b.tx_pos &&
+               a.spend == b.spend && a.index == b.index;
+    }
+};
+
+struct DBEventValue {
+    uint256 txid;
+    CAmount value;
+    COutPoint prevout;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(value);
+        READWRITE(prevout);
+    }
+};
+
+struct DBUnspentKey {
+    uint256 script_hash;
+    int height;
+    COutPoint outpoint;
+
+    DBUnspentKey() : height(0), outpoint(uint256(), 0) {}
+    DBUnspentKey(const uint256& script_hash_in, int height_in, const COutPoint& outpoint_in) :
+        script_hash(script_hash_in), height(height_in), outpoint(outpoint_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDR_UNSPENT);
+        s << script_hash;
+        ser_writedata32be(s, height);
+        s << outpoint.hash;
+        ser_writedata32be(s, outpoint.n);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDR_UNSPENT) {
+            throw std::ios_base::failure("Invalid format for address index DB unspent key");
+        }
+        s >> script_hash;
+        height = ser_readdata32be(s);
+        s >> outpoint.hash;
+        outpoint.n = ser_readdata32be(s);
+    }
+
+    friend bool operator==(const DBUnspentKey& a, const DBUnspentKey& b)
+    {
+        return a.script_hash == b.script_hash && a.height == b.height && a.outpoint == b.outpoint;
+    }
+};
+
+}; // namespace
+
+/**
+ * Access to the addrindex database (indexes/addrindex/)
+ */
+class AddrIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Read up to count entries of a script, starting after the key after, or at the first entry
+    /// if it is null.
+    template<typename Key, typename Value, typename Fn>
+    bool ReadRange(const uint256& script_hash, const Key* after, size_t count, Fn fn);
+};
+
+AddrIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addrindex", n_cache_size, f_memory, f_wipe)
+{}
+
+template<typename Key, typename Value, typename Fn>
+bool AddrIndex::DB::ReadRange(const uint256& script_hash, const Key* after, size_t count, Fn fn)
+{
+    std::unique_ptr<CDBIterator> db_it(NewIterator());
+    Key key;
+    key.script_hash = script_hash;
+    if (after) {
+        // Step past the entry to resume after, unless it was erased since.
+        db_it->Seek(*after);
+        if (db_it->Valid() && db_it->GetKey(key) && key == *after) db_it->Next();
+    } else {
+        db_it->Seek(key);
+    }
+
+    for (; count > 0 && db_it->Valid(); db_it->Next()) {
+        // A key of the other kind, or of another script, ends the range.
+        if (!db_it->GetKey(key) || key.script_hash != script_hash) break;
+        Value value;
+        if (!db_it->GetValue(value)) {
+            return error("%s: unable to read value in address index for script %s",
+                         __func__, script_hash.ToString());
+        }
+        fn(key, value);
+        count--;
+    }
+    return true;
+}
+
+class AddrIndex::PreparedUndo : public PreparedBlock
+{
+public:
+    CBlockUndo block_undo;
+};
+
+AddrIndex::AddrIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddrIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddrIndex::~AddrIndex() {}
+
+uint256 AddrIndex::HashScript(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+bool AddrIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<PreparedBlock>& prepared)
+{
+    // The undo data tells the scripts and values of the coins spent, read it ahead on the sync threads.
+    if (pindex->nHeight == 0) return true;
+
+    auto prepared_undo = MakeUnique<PreparedUndo>();
+    if (!UndoReadFromDisk(prepared_undo->block_undo, pindex)) {
+        return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    prepared = std::move(prepared_undo);
+    return true;
+}
+
+bool AddrIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return WritePreparedBlock(block, pindex, nullptr);
+}
+
+bool AddrIndex::WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, const PreparedBlock* prepared)
+{
+    // Exclude genesis block transaction because outputs are not spendable.
+    if (pindex->nHeight == 0) return true;
+
+    if (prepared) {
+        return WriteBlockWithUndo(block, pindex, static_cast<const PreparedUndo*>(prepared)->block_undo);
+    }
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    return WriteBlockWithUndo(block, pindex, block_undo);
+}
+
+bool AddrIndex::WriteBlockWithUndo(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& block_undo)
+{
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: undo data of block %s does not match it", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    // Entries are added in transaction order, so that an output spent later
+    // in the same block has its unspent entry written before it is erased.
+    CDBBatch batch(*m_db);
+    for (uint32_t tx_pos = 0; tx_pos < block.vtx.size(); ++tx_pos) {
+        const CTransaction& tx = *block.vtx[tx_pos];
+        const uint256& txid = tx.GetHash();
+
+        if (tx_pos > 0) {
+            const CTxUndo& tx_undo = block_undo.vtxundo[tx_pos - 1];
+            for (uint32_t i = 0; i < tx.vin.size(); ++i) {
+                const Coin& coin = tx_undo.vprevout[i];
+                const uint256 script_hash = HashScript(coin.out.scriptPubKey);
+                batch.Write(DBEventKey(script_hash, pindex->nHeight, tx_pos, true, i),
+                            DBEventValue{txid, coin.out.nValue, tx.vin[i].prevout});
+                batch.Erase(DBUnspentKey(script_hash, coin.nHeight, tx.vin[i].prevout));
+            }
+        }
+
+        for (uint32_t i = 0; i < tx.vout.size(); ++i) {
+            const CTxOut& out = tx.vout[i];
+            if (out.scriptPubKey.IsUnspendable()) continue;
+            const uint256 script_hash = HashScript(out.scriptPubKey);
+            batch.Write(DBEventKey(script_hash, pindex->nHeight, tx_pos, false, i),
+                        DBEventValue{txid, out.nValue, COutPoint()});
+            batch.Write(DBUnspentKey(script_hash, pindex->nHeight, COutPoint(txid, i)), out.nValue);
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool AddrIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Undo the blocks from the tip down, and their transactions in reverse
+    // order, so that an output created and spent within the blocks being
+    // rewound ends up without an unspent entry.
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        CBlockUndo block_undo;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!UndoReadFromDisk(block_undo, pindex) || block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        for (uint32_t tx_pos = block.vtx.size(); tx_pos-- > 0;) {
+            const CTransaction& tx = *block.vtx[tx_pos];
+
+            for (uint32_t i = 0; i < tx.vout.size(); ++i) {
+                const CScript& script = tx.vout[i].scriptPubKey;
+                if (script.IsUnspendable()) continue;
+                const uint256 script_hash = HashScript(script);
+                batch.Erase(DBEventKey(script_hash, pindex->nHeight, tx_pos, false, i));
+                batch.Erase(DBUnspentKey(script_hash, pindex->nHeight, COutPoint(tx.GetHash(), i)));
+            }
+
+            if (tx_pos == 0) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo[tx_pos - 1];
+            for (uint32_t i = 0; i < tx.vin.size(); ++i) {
+                const Coin& coin = tx_undo.vprevout[i];
+                const uint256 script_hash = HashScript(coin.out.scriptPubKey);
+                batch.Erase(DBEventKey(script_hash, pindex->nHeight, tx_pos, true, i));
+                batch.Write(DBUnspentKey(script_hash, coin.nHeight, tx.vin[i].prevout), coin.out.nValue);
+            }
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& AddrIndex::GetDB() const { return *m_db; }
+
+bool AddrIndex::FindEvents(const CScript& script, const Event* after, size_t count, std::vector<Event>& events) const
+{
+    events.clear();
+    const uint256 script_hash = HashScript(script);
+    DBEventKey after_key;
+    if (after) after_key = DBEventKey(script_hash, after->height, after->tx_pos, after->spend, after->index);
+    return m_db->ReadRange<DBEventKey, DBEventValue>(script_hash, after ? &after_key : nullptr, count,
+        [&events](const DBEventKey& key, const DBEventValue& value) {
+            events.push_back(Event{key.height, value.txid, key.tx_pos, key.spend, key.index, value.value, value.prevout});
+        });
+}
+
+bool AddrIndex::FindUnspent(const CScript& script, const Unspent* after, size_t count, std::vector<Unspent>& unspent) const
+{
+    unspent.clear();
+    const uint256 script_hash = HashScript(script);
+    DBUnspentKey after_key;
+    if (after) after_key = DBUnspentKey(script_hash, after->height, after->outpoint);
+    return m_db->ReadRange<DBUnspentKey, CAmount>(script_hash, after ? &after_key : nullptr, count,
+        [&unspent](const DBUnspentKey& key, const CAmount& value) {
+            unspent.push_back(Unspent{key.outpoint, key.height, value});
+        });
+}
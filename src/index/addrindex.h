@@ -0,0 +1,107 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRINDEX_H
+#define BITCOIN_INDEX_ADDRINDEX_H
+
+#include <amount.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <uint256.h>
+
+#include <memory>
+#include <vector>
+
+class CBlockUndo;
+
+static const bool DEFAULT_ADDRINDEX = false;
+
+/** Maximum number of entries returned by one address index query */
+static const size_t MAX_ADDRINDEX_QUERY_COUNT = 1000;
+
+/**
+ * AddrIndex is used to look up the history and unspent outputs of a
+ * scriptPubKey. Entries are keyed by the SHA256 hash of the script, then by
+ * block height, so that the entries of a script are read in chain order.
+ */
+class AddrIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// The undo data read by PrepareBlock
+    class PreparedUndo;
+
+    /// Write the entries of a block with the coins it spends
+    bool WriteBlockWithUndo(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& block_undo);
+
+protected:
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<PreparedBlock>& prepared) override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, const PreparedBlock* prepared) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addrindex"; }
+
+public:
+    /// An output paying to the script, or an input spending one.
+    struct Event {
+        int height;
+        uint256 txid;
+        /// Position of the transaction in its block
+        uint32_t tx_pos;
+        bool spend;
+        /// Index of the output, or of the input if spend is set
+        uint32_t index;
+        /// Value of the output, or of the spent output
+        CAmount value;
+        /// The output spent, null unless spend is set
+        COutPoint prevout;
+    };
+
+    /// An output paying to the script that is not spent in the indexed chain.
+    struct Unspent {
+        COutPoint outpoint;
+        int height;
+        CAmount value;
+    };
+
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddrIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~AddrIndex() override;
+
+    /// The key entries of a script are stored under.
+    static uint256 HashScript(const CScript& script);
+
+    /// Look up the history of a script, in chain order.
+    ///
+    /// @param[in]   script  The scriptPubKey.
+    /// @param[in]   after   The last entry of the previous page, or null to start at the first entry.
+    ///                      Only its height, tx_pos, spend and index are used.
+    /// @param[in]   count   Maximum number of entries to return.
+    /// @param[out]  events  The entries found.
+    /// @return  false if the database could not be read
+    bool FindEvents(const CScript& script, const Event* after, size_t count, std::vector<Event>& events) const;
+
+    /// Look up the unspent outputs of a script, in chain order. Parameters are as for FindEvents,
+    /// of after only the outpoint and height are used. Outputs spent before after do not move the
+    /// next page, as an offset would.
+    bool FindUnspent(const CScript& script, const Unspent* after, size_t count, std::vector<Unspent>& unspent) const;
+};
+
+/// The global address index, used by the address RPCs. May be null.
+extern std::unique_ptr<AddrIndex> g_addrindex;
+
+#endif // BITCOIN_INDEX_ADDRINDEX_H
@@ -11,10 +11,16 @@
 #include <validation.h>
 #include <warnings.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+
 constexpr char DB_BEST_BLOCK = 'B';
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+constexpr size_t SYNC_BATCH_SIZE = 128; // blocks
 
 template<typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -85,14 +91,124 @@ static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev) EXCLUSIV
     return ::ChainActive().Next(::ChainActive().FindFork(pindex_prev));
 }
 
+namespace {
+/** A block of the batch being synced, see BaseIndex::ThreadSync. */
+struct SyncBlock {
+    explicit SyncBlock(const CBlockIndex* pindex_in) : pindex(pindex_in) {}
+    const CBlockIndex* pindex;
+    enum { PENDING, READ_FAILED, PREPARE_FAILED, THREW, READY } state = PENDING;
+    //! What reading or preparing the block threw, if state is THREW
+    std::string error;
+    CBlock block;
+};
+
+/**
+ * Threads helping the sync thread read and prepare the blocks of each batch.
+ * They are started once for the whole sync and wait for the next batch in
+ * between. The work function must not throw.
+ */
+class SyncWorkers
+{
+public:
+    SyncWorkers(int n_threads, std::function<void(size_t)> work) : m_work(std::move(work))
+    {
+        for (int i = 1; i < n_threads; i++) {
+            m_threads.emplace_back(&TraceThread<std::function<void()>>, "indexsync",
+                                   std::function<void()>(std::bind(&SyncWorkers::ThreadWork, this)));
+        }
+    }
+
+    ~SyncWorkers()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    //! Run the work function for 0 to size - 1, on this thread and the workers, and wait until done
+    void Run(size_t size)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_size = size;
+        m_next = 0;
+        m_done = 0;
+        m_cond.notify_all();
+        Work(lock);
+        m_cond_done.wait(lock, [this] { return m_done == m_size; });
+    }
+
+private:
+    const std::function<void(size_t)> m_work;
+    std::vector<std::thread> m_threads;
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::condition_variable m_cond_done;
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    size_t m_size GUARDED_BY(m_mutex) = 0;
+    size_t m_next GUARDED_BY(m_mutex) = 0;
+    size_t m_done GUARDED_BY(m_mutex) = 0;
+
+    //! Take work until none is left to start, the lock is released while working
+    void Work(DebugLock<Mutex>& lock)
+    {
+        while (m_next < m_size) {
+            const size_t i = m_next++;
+            lock.unlock();
+            m_work(i);
+            lock.lock();
+            if (++m_done == m_size) m_cond_done.notify_all();
+        }
+    }
+
+    void ThreadWork()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            m_cond.wait(lock, [this] { return m_stop || m_next < m_size; });
+            if (m_stop) return;
+            Work(lock);
+        }
+    }
+};
+} // namespace
+
 void BaseIndex::ThreadSync()
 {
     const CBlockIndex* pindex = m_best_block_index.load();
     if (!m_synced) {
         auto& consensus_params = Params().GetConsensus();
+        const int n_threads = std::max(1, std::min(GetNumCores(), MAX_INDEX_SYNC_THREADS));
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
+        const int64_t sync_start_time = GetTimeMillis();
+        int64_t blocks_synced = 0;
+        std::vector<SyncBlock> batch;
+        std::vector<std::unique_ptr<PreparedBlock>> prepared;
+        SyncWorkers workers(n_threads, [&](size_t i) {
+            SyncBlock& entry = batch[i];
+            if (m_interrupt) return;
+            try {
+                if (!ReadBlockFromDisk(entry.block, entry.pindex, consensus_params)) {
+                    entry.state = SyncBlock::READ_FAILED;
+                } else if (!PrepareBlock(entry.block, entry.pindex, prepared[i])) {
+                    entry.state = SyncBlock::PREPARE_FAILED;
+                } else {
+                    entry.state = SyncBlock::READY;
+                }
+            } catch (const std::exception& e) {
+                entry.state = SyncBlock::THREW;
+                entry.error = e.what();
+            } catch (...) {
+                entry.state = SyncBlock::THREW;
+                entry.error = "unknown exception";
+            }
+        });
         while (true) {
             if (m_interrupt) {
                 m_best_block_index = pindex;
@@ -103,6 +219,7 @@ void BaseIndex::ThreadSync()
                 return;
             }
 
+            batch.clear();
             {
                 LOCK(cs_main);
                 const CBlockIndex* pindex_next = NextSyncBlock(pindex);
@@ -118,34 +235,56 @@ void BaseIndex::ThreadSync()
                                __func__, GetName());
                     return;
                 }
-                pindex = pindex_next;
-            }
-
-            int64_t current_time = GetTime();
-            if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
-                LogPrintf("Syncing %s with block chain from height %d\n",
-                          GetName(), pindex->nHeight);
-                last_log_time = current_time;
+                // The rest of the batch follows the active chain. Should it
+                // change meanwhile, the next batch rewinds the stale blocks.
+                for (; pindex_next && batch.size() < SYNC_BATCH_SIZE; pindex_next = ::ChainActive().Next(pindex_next)) {
+                    batch.emplace_back(pindex_next);
+                }
             }
 
-            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
-                m_best_block_index = pindex;
-                last_locator_write_time = current_time;
-                // No need to handle errors in Commit. See rationale above.
-                Commit();
-            }
+            // Read and prepare the blocks of the batch on all threads
+            prepared.clear();
+            prepared.resize(batch.size());
+            workers.Run(batch.size());
+
+            // Write them in order
+            for (size_t i = 0; i < batch.size() && !m_interrupt; i++) {
+                const SyncBlock& entry = batch[i];
+                if (entry.state == SyncBlock::READ_FAILED) {
+                    FatalError("%s: Failed to read block %s from disk",
+                               __func__, entry.pindex->GetBlockHash().ToString());
+                    return;
+                }
+                if (entry.state == SyncBlock::THREW) {
+                    FatalError("%s: Failed to prepare block %s for %s: %s",
+                               __func__, entry.pindex->GetBlockHash().ToString(), GetName(), entry.error);
+                    return;
+                }
+                if (entry.state != SyncBlock::READY || !WritePreparedBlock(entry.block, entry.pindex, prepared[i].get())) {
+                    FatalError("%s: Failed to write block %s to index database",
+                               __func__, entry.pindex->GetBlockHash().ToString());
+                    return;
+                }
+                pindex = entry.pindex;
+                blocks_synced++;
+                prepared[i].reset();
+
+                int64_t current_time = GetTime();
+                if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
+                    LogPrintf("Syncing %s with block chain from height %d (%.1f blocks/s)\n",
+                              GetName(), pindex->nHeight, m_sync_rate.load());
+                    last_log_time = current_time;
+                }
 
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-                FatalError("%s: Failed to read block %s from disk",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
-            }
-            if (!WriteBlock(block, pindex)) {
-                FatalError("%s: Failed to write block %s to index database",
-                           __func__, pindex->GetBlockHash().ToString());
-                return;
+                if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+                    m_best_block_index = pindex;
+                    last_locator_write_time = current_time;
+                    // No need to handle errors in Commit. See rationale above.
+                    Commit();
+                }
             }
+            m_best_block_index = pindex;
+            m_sync_rate = blocks_synced * 1000.0 / std::max<int64_t>(1, GetTimeMillis() - sync_start_time);
         }
     }
 
@@ -321,3 +460,14 @@ void BaseIndex::Stop()
         m_thread_sync.join();
     }
 }
+
+IndexSummary BaseIndex::GetSummary() const
+{
+    IndexSummary summary{};
+    summary.name = GetName();
+    summary.synced = m_synced;
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    summary.best_block_height = best_block_index ? best_block_index->nHeight : 0;
+    summary.blocks_per_second = m_sync_rate;
+    return summary;
+}
@@ -12,8 +12,22 @@
 #include <uint256.h>
 #include <validationinterface.h>
 
+#include <memory>
+#include <string>
+
 class CBlockIndex;
 
+/// Maximum number of threads reading and preparing blocks during an initial index sync
+static const int MAX_INDEX_SYNC_THREADS = 8;
+
+struct IndexSummary {
+    std::string name;
+    bool synced{false};
+    int best_block_height{0};
+    /// Blocks indexed per second since the initial sync started, zero until it has
+    double blocks_per_second{0};
+};
+
 /**
  * Base class for indices of blockchain data. This implements
  * CValidationInterface and ensures blocks are indexed sequentially according
@@ -44,6 +58,9 @@ private:
     /// The last block in the chain that the index is in sync with.
     std::atomic<const CBlockIndex*> m_best_block_index{nullptr};
 
+    /// Indexing rate of the initial sync, for GetSummary.
+    std::atomic<double> m_sync_rate{0};
+
     std::thread m_thread_sync;
     CThreadInterrupt m_interrupt;
 
@@ -52,6 +69,9 @@ private:
     /// interrupted with m_interrupt. Once the index gets in sync, the m_synced
     /// flag is set and the BlockConnected ValidationInterface callback takes
     /// over and the sync thread exits.
+    ///
+    /// Blocks are synced in batches: the blocks of a batch are read and
+    /// prepared on several threads at once, then written in chain order.
     void ThreadSync();
 
     /// Write the current index state (eg. chain block locator and subclass-specific items) to disk.
@@ -73,9 +93,26 @@ protected:
     /// Initialize internal state from the database and block index.
     virtual bool Init();
 
+    /// Result of PrepareBlock, kept until the block is written.
+    class PreparedBlock
+    {
+    public:
+        virtual ~PreparedBlock() {}
+    };
+
+    /// Do the part of indexing a block that does not depend on the blocks
+    /// before it, eg. reading its undo data. During the initial sync this is
+    /// called on several threads at once, for the blocks ahead of the one
+    /// being written, and the result passed to WritePreparedBlock.
+    virtual bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<PreparedBlock>& prepared) { return true; }
+
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    /// Write update index entries for a block prepared by PrepareBlock.
+    /// prepared may be null if PrepareBlock left it so.
+    virtual bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, const PreparedBlock* prepared) { return WriteBlock(block, pindex); }
+
     /// Virtual method called internally by Commit that can be overridden to atomically
     /// commit more index state.
     virtual bool CommitInternal(CDBBatch& batch);
@@ -108,6 +145,9 @@ public:
 
     /// Stops the instance from staying in sync with blockchain updates.
     void Stop();
+
+    /// Get a summary of the index and its state.
+    IndexSummary GetSummary() const;
 };
 
 #endif // BITCOIN_INDEX_BASE_H
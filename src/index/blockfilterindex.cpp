@@ -212,16 +212,49 @@ size_t BlockFilterIndex::WriteFilterToDisk(FlatFilePos& pos, const BlockFilter&
     return data_size;
 }
 
-bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+class BlockFilterIndex::PreparedFilter : public PreparedBlock
+{
+public:
+    BlockFilter filter;
+};
+
+bool BlockFilterIndex::BuildFilter(const CBlock& block, const CBlockIndex* pindex, BlockFilter& filter) const
 {
     CBlockUndo block_undo;
-    uint256 prev_header;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    filter = BlockFilter(m_filter_type, block, block_undo);
+    return true;
+}
 
-    if (pindex->nHeight > 0) {
-        if (!UndoReadFromDisk(block_undo, pindex)) {
-            return false;
-        }
+bool BlockFilterIndex::PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<PreparedBlock>& prepared)
+{
+    // Building the filter does not depend on the filters before it, only
+    // chaining its header does, so it is done ahead on the sync threads.
+    auto prepared_filter = MakeUnique<PreparedFilter>();
+    if (!BuildFilter(block, pindex, prepared_filter->filter)) {
+        return false;
+    }
+    prepared = std::move(prepared_filter);
+    return true;
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return WritePreparedBlock(block, pindex, nullptr);
+}
 
+bool BlockFilterIndex::WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, const PreparedBlock* prepared)
+{
+    BlockFilter built_filter;
+    if (!prepared && !BuildFilter(block, pindex, built_filter)) {
+        return false;
+    }
+    const BlockFilter& filter = prepared ? static_cast<const PreparedFilter*>(prepared)->filter : built_filter;
+
+    uint256 prev_header;
+    if (pindex->nHeight > 0) {
         std::pair<uint256, DBVal> read_out;
         if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
             return false;
@@ -236,8 +269,6 @@ bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex
         prev_header = read_out.second.header;
     }
 
-    BlockFilter filter(m_filter_type, block, block_undo);
-
     size_t bytes_written = WriteFilterToDisk(m_next_filter_pos, filter);
     if (bytes_written == 0) return false;
 
@@ -304,22 +335,22 @@ bool BlockFilterIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex*
     return BaseIndex::Rewind(current_tip, new_tip);
 }
 
-static bool LookupOne(const CDBWrapper& db, const CBlockIndex* block_index, DBVal& result)
+static bool LookupOne(const CDBWrapper& db, int height, const uint256& block_hash, DBVal& result)
 {
     // First check if the result is stored under the height index and the value there matches the
     // block hash. This should be the case if the block is on the active chain.
     std::pair<uint256, DBVal> read_out;
-    if (!db.Read(DBHeightKey(block_index->nHeight), read_out)) {
+    if (!db.Read(DBHeightKey(height), read_out)) {
         return false;
     }
-    if (read_out.first == block_index->GetBlockHash()) {
+    if (read_out.first == block_hash) {
         result = std::move(read_out.second);
         return true;
     }
 
     // If value at the height index corresponds to an different block, the result will be stored in
     // the hash index.
-    return db.Read(DBHashKey(block_index->GetBlockHash()), result);
+    return db.Read(DBHashKey(block_hash), result);
 }
 
 static bool LookupRange(CDBWrapper& db, const std::string& index_name, int start_height,
@@ -380,7 +411,17 @@ static bool LookupRange(CDBWrapper& db, const std::string& index_name, int start
 bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
 {
     DBVal entry;
-    if (!LookupOne(*m_db, block_index, entry)) {
+    if (!LookupOne(*m_db, block_index->nHeight, block_index->GetBlockHash(), entry)) {
+        return false;
+    }
+
+    return ReadFilterFromDisk(entry.pos, filter_out);
+}
+
+bool BlockFilterIndex::LookupFilter(int height, const uint256& block_hash, BlockFilter& filter_out) const
+{
+    DBVal entry;
+    if (!LookupOne(*m_db, height, block_hash, entry)) {
         return false;
     }
 
@@ -390,7 +431,7 @@ bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter&
 bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
 {
     DBVal entry;
-    if (!LookupOne(*m_db, block_index, entry)) {
+    if (!LookupOne(*m_db, block_index->nHeight, block_index->GetBlockHash(), entry)) {
         return false;
     }
 
@@ -30,13 +30,23 @@ private:
     bool ReadFilterFromDisk(const FlatFilePos& pos, BlockFilter& filter) const;
     size_t WriteFilterToDisk(FlatFilePos& pos, const BlockFilter& filter);
 
+    /// A filter built by PrepareBlock
+    class PreparedFilter;
+
+    /// Build the filter of a block, which needs its undo data
+    bool BuildFilter(const CBlock& block, const CBlockIndex* pindex, BlockFilter& filter) const;
+
 protected:
     bool Init() override;
 
     bool CommitInternal(CDBBatch& batch) override;
 
+    bool PrepareBlock(const CBlock& block, const CBlockIndex* pindex, std::unique_ptr<PreparedBlock>& prepared) override;
+
     bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
 
+    bool WritePreparedBlock(const CBlock& block, const CBlockIndex* pindex, const PreparedBlock* prepared) override;
+
     bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
 
     BaseIndex::DB& GetDB() const override { return *m_db; }
@@ -53,6 +63,9 @@ public:
     /** Get a single filter by block. */
     bool LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const;
 
+    /** Get a single filter by block height and hash, for callers not holding cs_main. */
+    bool LookupFilter(int height, const uint256& block_hash, BlockFilter& filter_out) const;
+
     /** Get a single filter header by block. */
     bool LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const;
 
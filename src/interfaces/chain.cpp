@@ -6,6 +6,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <index/blockfilterindex.h>
 #include <interfaces/handler.h>
 #include <interfaces/wallet.h>
 #include <net.h>
@@ -92,6 +93,13 @@ class LockImpl : public Chain::Lock, public UniqueLock<CCriticalSection>
         CBlockIndex* block = ::ChainActive()[height];
         return block && ((block->nStatus & BLOCK_HAVE_DATA) != 0) && block->nTx > 0;
     }
+    Optional<FlatFilePos> getBlockPos(int height) override
+    {
+        LockAssertion lock(::cs_main);
+        CBlockIndex* block = ::ChainActive()[height];
+        if (!block || !(block->nStatus & BLOCK_HAVE_DATA)) return nullopt;
+        return block->GetBlockPos();
+    }
     Optional<int> findFirstBlockWithTimeAndHeight(int64_t time, int height, uint256* hash) override
     {
         LockAssertion lock(::cs_main);
@@ -269,6 +277,26 @@ public:
         }
         return true;
     }
+    bool readBlockFromDisk(const FlatFilePos& pos, const uint256& hash, CBlock& block) override
+    {
+        // The proof of work was checked when the header was accepted
+        if (!ReadBlockFromDisk(block, pos, Params().GetConsensus(), false) || block.GetHash() != hash) {
+            block.SetNull();
+            return false;
+        }
+        return true;
+    }
+    bool hasBlockFilterIndex(BlockFilterType filter_type) override
+    {
+        return GetBlockFilterIndex(filter_type) != nullptr;
+    }
+    Optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, int height, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) override
+    {
+        const BlockFilterIndex* block_filter_index = GetBlockFilterIndex(filter_type);
+        BlockFilter filter;
+        if (!block_filter_index || !block_filter_index->LookupFilter(height, block_hash, filter)) return nullopt;
+        return filter.GetFilter().MatchAny(filter_set);
+    }
     void findCoins(std::map<COutPoint, Coin>& coins) override { return FindCoins(coins); }
     double guessVerificationProgress(const uint256& block_hash) override
     {
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_INTERFACES_CHAIN_H
 #define BITCOIN_INTERFACES_CHAIN_H
 
+#include <blockfilter.h>           // For BlockFilterType and GCSFilter::ElementSet
+#include <flatfile.h>               // For FlatFilePos
 #include <optional.h>               // For Optional and nullopt
 #include <primitives/transaction.h> // For CTransactionRef
 
@@ -94,6 +96,11 @@ public:
         //! pruned), and contains transactions.
         virtual bool haveBlockOnDisk(int height) = 0;
 
+        //! Get the position of the block data on disk, to read it with
+        //! Chain::readBlockFromDisk() without holding the lock. Returns
+        //! nullopt if the block data is not available.
+        virtual Optional<FlatFilePos> getBlockPos(int height) = 0;
+
         //! Return height of the first block in the chain with timestamp equal
         //! or greater than the given time and height equal or greater than the
         //! given height, or nullopt if there is no block with a high enough
@@ -140,6 +147,19 @@ public:
         int64_t* time = nullptr,
         int64_t* max_time = nullptr) = 0;
 
+    //! Read block contents from the position given by Lock::getBlockPos(),
+    //! checking they match the block hash. Takes no lock, so it can be called
+    //! from other threads while the caller holds the chain lock.
+    virtual bool readBlockFromDisk(const FlatFilePos& pos, const uint256& hash, CBlock& block) = 0;
+
+    //! Return whether the node keeps a block filter index of the given type.
+    virtual bool hasBlockFilterIndex(BlockFilterType filter_type) = 0;
+
+    //! Return whether any of the elements match the filter of the block at
+    //! the given height and hash, or nullopt if the filter for the block
+    //! couldn't be found. Takes no lock, like readBlockFromDisk().
+    virtual Optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, int height, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) = 0;
+
     //! Look up unspent output information. Returns coins in the mempool and in
     //! the current chain UTXO set. Iterates through all the keys in the map and
     //! populates the values.
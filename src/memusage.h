@@ -6,6 +6,8 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <nodepoolmap.h>
+#include <prevector.h>
 
 #include <stdlib.h>
 
@@ -165,6 +167,14 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+// nodepoolmap allocates its entries in chunks, next to a table of slots
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const nodepoolmap<X, Y, Z>& m)
+{
+    return (MallocUsage(m.chunk_size()) + sizeof(void*)) * m.chunk_count() + MallocUsage(m.bucket_size() * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
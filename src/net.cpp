@@ -21,6 +21,7 @@
 #include <scheduler.h>
 #include <ui_interface.h>
 #include <util/strencodings.h>
+#include <util/threadnames.h>
 #include <util/translation.h>
 
 #ifdef WIN32
@@ -33,6 +34,10 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -77,6 +82,11 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+/** Maximum number of events taken from epoll at a time */
+static const int MAX_EPOLL_EVENTS = 256;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -458,6 +468,14 @@ void CNode::CloseSocketDisconnect()
     if (hSocket != INVALID_SOCKET)
     {
         LogPrint(BCLog::NET, "disconnecting peer=%d\n", id);
+#ifdef USE_EPOLL
+        // Closing does not remove the socket from epoll while a child
+        // process still holds a copy of it
+        if (m_epoll_fd >= 0) {
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, hSocket, nullptr);
+            m_epoll_fd = -1;
+        }
+#endif
         CloseSocket(hSocket);
     }
 }
@@ -562,6 +580,14 @@ void CNode::copyStats(CNodeStats &stats)
 }
 #undef X
 
+//! The memory a processed message holds on to while waiting for reuse. Its
+//! buffers keep their capacity through Reset, so a buffer that once held a
+//! large message is charged for that, whatever it was last used for.
+static size_t RecycledMessageUsage(const CNetMessage& msg)
+{
+    return sizeof(CNetMessage) + msg.hdrbuf.capacity() + msg.vRecv.capacity();
+}
+
 bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete)
 {
     complete = false;
@@ -571,10 +597,18 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
     nRecvBytes += nBytes;
     while (nBytes > 0) {
 
-        // get current incomplete message, or create a new one
+        // get current incomplete message, or reuse a processed one, or create a new one
         if (vRecvMsg.empty() ||
-            vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.back().complete()) {
+            LOCK(cs_vRecvMsgPool);
+            if (vRecvMsgPool.empty()) {
+                vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+            } else {
+                nRecvMsgPoolSize -= RecycledMessageUsage(vRecvMsgPool.front());
+                vRecvMsg.splice(vRecvMsg.end(), vRecvMsgPool, vRecvMsgPool.begin());
+                vRecvMsg.back().Reset(Params().MessageStart());
+            }
+        }
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -640,6 +674,35 @@ int CNode::GetSendVersion() const
 }
 
 
+void CNode::RecycleMessages(std::list<CNetMessage>& msgs)
+{
+    LOCK(cs_vRecvMsgPool);
+    for (auto it = msgs.begin(); it != msgs.end();) {
+        const size_t usage = RecycledMessageUsage(*it);
+        if (nRecvMsgPoolSize + usage > MAX_RECYCLED_MESSAGE_BYTES) {
+            ++it;
+            continue;
+        }
+        nRecvMsgPoolSize += usage;
+        vRecvMsgPool.splice(vRecvMsgPool.end(), msgs, it++);
+    }
+}
+
+void CNetMessage::Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn)
+{
+    hasher.Reset();
+    data_hash.SetNull();
+    in_data = false;
+    hdrbuf.clear();
+    hdrbuf.resize(24);
+    hdr = CMessageHeader(pchMessageStartIn);
+    nHdrPos = 0;
+    vRecv.clear();
+    nDataPos = 0;
+    nTime = 0;
+    SetVersion(INIT_PROTO_VERSION);
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -729,7 +792,10 @@ size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pno
             if (nBytes < 0) {
                 // error
                 int nErr = WSAGetLastError();
-                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+                // Interrupted before anything was sent: try again, as with
+                // edge-triggered epoll no further event may come to retry it
+                if (nErr == WSAEINTR) continue;
+                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINPROGRESS)
                 {
                     LogPrintf("socket send error %s\n", NetworkErrorString(nErr));
                     pnode->CloseSocketDisconnect();
@@ -1000,6 +1066,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
+    RegisterSocketEvents(pnode);
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -1279,8 +1346,229 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 }
 #endif
 
+bool CConnman::SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = 0;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET)
+            return false;
+        nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    }
+    if (nBytes > 0)
+    {
+        bool notify = false;
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+            pnode->CloseSocketDisconnect();
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(pnode->vRecvMsg.begin());
+            for (; it != pnode->vRecvMsg.end(); ++it) {
+                if (!it->complete())
+                    break;
+                nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+            }
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                pnode->nProcessQueueSize += nSizeAdded;
+                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+            }
+            WakeMessageHandler();
+        }
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!pnode->fDisconnect) {
+            LogPrint(BCLog::NET, "socket closed\n");
+        }
+        pnode->CloseSocketDisconnect();
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        // Interrupted before anything was read: there is still data to read
+        if (nErr == WSAEINTR) return true;
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINPROGRESS)
+        {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+        }
+    }
+    // A full buffer means there may be more to read
+    return nBytes == (int)sizeof(pchBuf);
+}
+
+bool CConnman::InitSocketEvents()
+{
+#ifdef USE_EPOLL
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        LogPrintf("epoll_create1 failed, polling sockets instead: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    for (ListenSocket& hListenSocket : vhListenSocket) {
+        // Level-triggered: one connection is accepted per wake-up
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &hListenSocket;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+            LogPrintf("epoll_ctl failed for listening socket, polling sockets instead: %s\n", NetworkErrorString(WSAGetLastError()));
+            close(m_epoll_fd);
+            m_epoll_fd = -1;
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CConnman::RegisterSocketEvents(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    if (m_epoll_fd < 0) return;
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET) return;
+    // Edge-triggered: the socket thread hears once that the socket became
+    // readable or writable, and keeps track of it until it would block
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = pnode;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(WSAGetLastError()));
+        pnode->fDisconnect = true;
+        return;
+    }
+    pnode->m_epoll_fd = m_epoll_fd;
+#endif
+}
+
+#ifdef USE_EPOLL
+/** Whether to read from a peer now, see GenerateSelectSet */
+static bool CanReceive(CNode* pnode)
+{
+    if (pnode->fDisconnect || pnode->fPauseRecv) return false;
+    LOCK(pnode->cs_vSend);
+    return pnode->vSendMsg.empty();
+}
+
+void CConnman::SocketHandlerEpoll()
+{
+    // Don't wait for new events while a peer still has data to read
+    int timeout = SELECT_TIMEOUT_MILLISECONDS;
+    for (CNode* pnode : m_recv_ready_nodes) {
+        if (pnode->fDisconnect || CanReceive(pnode)) {
+            timeout = 0;
+            break;
+        }
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(m_epoll_fd, events, MAX_EPOLL_EVENTS, timeout);
+    if (interruptNet) return;
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    //
+    // Accept new connections on the listening sockets that have them, send,
+    // and note the peers that have something to read. Peers are only deleted
+    // by this thread, so the ones reported are still around.
+    //
+    for (int i = 0; i < nEvents; i++) {
+        // The listening sockets are registered with their entry in vhListenSocket
+        auto listen_it = std::find_if(vhListenSocket.begin(), vhListenSocket.end(),
+            [&](const ListenSocket& hListenSocket) { return &hListenSocket == events[i].data.ptr; });
+        if (listen_it != vhListenSocket.end()) {
+            AcceptConnection(*listen_it);
+            continue;
+        }
+        CNode* pnode = static_cast<CNode*>(events[i].data.ptr);
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            LOCK(pnode->cs_vSend);
+            size_t nBytes = SocketSendData(pnode);
+            if (nBytes) {
+                RecordBytesSent(nBytes);
+            }
+        }
+        if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) && !pnode->m_recv_ready) {
+            pnode->m_recv_ready = true;
+            pnode->AddRef();
+            m_recv_ready_nodes.push_back(pnode);
+        }
+    }
+
+    //
+    // Receive. A peer stays on the list until reading would block, or while
+    // it is paused.
+    //
+    for (size_t i = 0; i < m_recv_ready_nodes.size();) {
+        if (interruptNet) return;
+        CNode* pnode = m_recv_ready_nodes[i];
+        bool fKeep;
+        if (pnode->fDisconnect) {
+            fKeep = false;
+        } else if (!CanReceive(pnode)) {
+            fKeep = true;
+        } else {
+            fKeep = SocketRecvData(pnode);
+        }
+        if (fKeep) {
+            i++;
+            continue;
+        }
+        pnode->m_recv_ready = false;
+        pnode->Release();
+        m_recv_ready_nodes[i] = m_recv_ready_nodes.back();
+        m_recv_ready_nodes.pop_back();
+    }
+
+    //
+    // Timeouts are in seconds, so going over all peers once a second is enough
+    //
+    const int64_t nNow = GetSystemTimeInSeconds();
+    if (nNow != m_last_inactivity_check) {
+        m_last_inactivity_check = nNow;
+        std::vector<CNode*> vNodesCopy;
+        {
+            LOCK(cs_vNodes);
+            vNodesCopy = vNodes;
+            for (CNode* pnode : vNodesCopy)
+                pnode->AddRef();
+        }
+        for (CNode* pnode : vNodesCopy)
+            InactivityCheck(pnode);
+        {
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodesCopy)
+                pnode->Release();
+        }
+    }
+}
+#endif
+
 void CConnman::SocketHandler()
 {
+#ifdef USE_EPOLL
+    if (m_epoll_fd >= 0) {
+        SocketHandlerEpoll();
+        return;
+    }
+#endif
+
     std::set<SOCKET> recv_set, send_set, error_set;
     SocketEvents(recv_set, send_set, error_set);
 
@@ -1328,57 +1616,7 @@ void CConnman::SocketHandler()
         }
         if (recvSet || errorSet)
         {
-            // typical socket buffer is 8K-64K
-            char pchBuf[0x10000];
-            int nBytes = 0;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-            }
-            if (nBytes > 0)
-            {
-                bool notify = false;
-                if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                    pnode->CloseSocketDisconnect();
-                RecordBytesRecv(nBytes);
-                if (notify) {
-                    size_t nSizeAdded = 0;
-                    auto it(pnode->vRecvMsg.begin());
-                    for (; it != pnode->vRecvMsg.end(); ++it) {
-                        if (!it->complete())
-                            break;
-                        nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                    }
-                    {
-                        LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                        pnode->nProcessQueueSize += nSizeAdded;
-                        pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                    }
-                    WakeMessageHandler();
-                }
-            }
-            else if (nBytes == 0)
-            {
-                // socket closed gracefully
-                if (!pnode->fDisconnect) {
-                    LogPrint(BCLog::NET, "socket closed\n");
-                }
-                pnode->CloseSocketDisconnect();
-            }
-            else if (nBytes < 0)
-            {
-                // error
-                int nErr = WSAGetLastError();
-                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                {
-                    if (!pnode->fDisconnect)
-                        LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                    pnode->CloseSocketDisconnect();
-                }
-            }
+            SocketRecvData(pnode);
         }
 
         //
@@ -1969,14 +2207,17 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->m_manual_connection = true;
 
     m_msgproc->InitializeNode(pnode);
+    RegisterSocketEvents(pnode);
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int worker_num)
 {
+    if (worker_num > 0) util::ThreadRename(strprintf("msghand.%i", worker_num));
+
     while (!flagInterruptMsgProc)
     {
         std::vector<CNode*> vNodesCopy;
@@ -1990,24 +2231,41 @@ void CConnman::ThreadMessageHandler()
 
         bool fMoreWork = false;
 
-        for (CNode* pnode : vNodesCopy)
+        // Each thread starts at a different peer, so that a slow peer holds
+        // up at most the thread handling it while the others go around it.
+        const size_t nNodes = vNodesCopy.size();
+        const size_t nStart = nNodes * worker_num / nMsgHandlerThreads;
+        for (size_t i = 0; i < nNodes; i++)
         {
+            CNode* pnode = vNodesCopy[(nStart + i) % nNodes];
             if (pnode->fDisconnect)
                 continue;
 
-            // Receive messages
-            bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
-            fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
-            if (flagInterruptMsgProc)
-                return;
-            // Send messages
+            // Leave the peer to the thread holding it, which comes back to it
+            // while it has more work or if it was turned away here
+            pnode->fMsgProcRetry = true;
             {
-                LOCK(pnode->cs_sendProcessing);
-                m_msgproc->SendMessages(pnode);
-            }
+                TRY_LOCK(pnode->cs_msgProcessing, lockProcessing);
+                if (!lockProcessing)
+                    continue;
+                pnode->fMsgProcRetry = false;
 
-            if (flagInterruptMsgProc)
-                return;
+                // Receive messages
+                bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
+                fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
+                if (flagInterruptMsgProc)
+                    return;
+                // Send messages
+                {
+                    LOCK(pnode->cs_sendProcessing);
+                    m_msgproc->SendMessages(pnode);
+                }
+
+                if (flagInterruptMsgProc)
+                    return;
+            }
+            if (pnode->fMsgProcRetry)
+                fMoreWork = true;
         }
 
         {
@@ -2019,8 +2277,12 @@ void CConnman::ThreadMessageHandler()
         WAIT_LOCK(mutexMsgProc, lock);
         if (!fMoreWork) {
             condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
+            fMsgProcWake = false;
+        } else if (nMsgHandlerThreads > 1) {
+            // Get an idle thread to help with the peers this one is not handling
+            fMsgProcWake = true;
+            condMsgProc.notify_one();
         }
-        fMsgProcWake = false;
     }
 }
 
@@ -2279,6 +2541,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     }
 
     // Send and receive from sockets, accept connections
+    InitSocketEvents();
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
     if (!gArgs.GetBoolArg("-dnsseed", true))
@@ -2301,7 +2564,9 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMsgHandlerThreads; i++) {
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, i)));
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000);
@@ -2350,8 +2615,11 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& thread : threadMessageHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageHandlers.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2374,6 +2642,17 @@ void CConnman::Stop()
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+    for (CNode* pnode : m_recv_ready_nodes) {
+        pnode->m_recv_ready = false;
+        pnode->Release();
+    }
+    m_recv_ready_nodes.clear();
+#ifdef USE_EPOLL
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+#endif
 
     // clean up some globals (to help leak detection)
     for (CNode *pnode : vNodes) {
@@ -2692,13 +2971,14 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
-    size_t nMessageSize = msg.data.size();
+    const Span<const unsigned char> payload = msg.external_owner ? msg.external_data : Span<const unsigned char>(msg.data.data(), msg.data.size());
+    size_t nMessageSize = payload.size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = Hash(payload.begin(), payload.end());
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
@@ -2715,9 +2995,14 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(serializedHeader));
+        if (nMessageSize) {
+            if (msg.external_owner) {
+                pnode->vSendMsg.emplace_back(std::move(msg.external_owner), payload);
+            } else {
+                pnode->vSendMsg.emplace_back(std::move(msg.data));
+            }
+        }
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
@@ -19,6 +19,7 @@
 #include <policy/feerate.h>
 #include <protocol.h>
 #include <random.h>
+#include <span.h>
 #include <streams.h>
 #include <sync.h>
 #include <uint256.h>
@@ -88,8 +89,15 @@ static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
+/** Total size of the processed messages each peer keeps for receiving the next ones into */
+static const size_t MAX_RECYCLED_MESSAGE_BYTES = 256 * 1024;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
+/** -msghandlerthreads default, the number of threads processing peer messages */
+static const int DEFAULT_MSGHANDLER_THREADS = 4;
+/** Maximum number of message handler threads */
+static const int MAX_MSGHANDLER_THREADS = 16;
+
 typedef int64_t NodeId;
 
 struct AddedNodeInfo
@@ -114,6 +122,26 @@ struct CSerializedNetMsg
 
     std::vector<unsigned char> data;
     std::string command;
+    //! Sent as the payload instead of data, without copying it. external_owner
+    //! keeps the memory alive until the message is sent.
+    std::shared_ptr<const void> external_owner;
+    Span<const unsigned char> external_data;
+};
+
+/** Bytes queued for sending to a peer, either owned or in memory kept alive by m_owner */
+class CSendBuffer
+{
+private:
+    std::vector<unsigned char> m_data;
+    std::shared_ptr<const void> m_owner;
+    Span<const unsigned char> m_external;
+
+public:
+    explicit CSendBuffer(std::vector<unsigned char>&& data) : m_data(std::move(data)) {}
+    CSendBuffer(std::shared_ptr<const void> owner, Span<const unsigned char> external) : m_owner(std::move(owner)), m_external(external) {}
+
+    const unsigned char* data() const { return m_owner ? m_external.data() : m_data.data(); }
+    size_t size() const { return m_owner ? m_external.size() : m_data.size(); }
 };
 
 
@@ -146,6 +174,7 @@ public:
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        int nMsgHandlerThreads = 1;
         std::vector<std::string> vSeedNodes;
         std::vector<NetWhitelistPermissions> vWhitelistedRange;
         std::vector<NetWhitebindPermissions> vWhiteBinds;
@@ -171,6 +200,7 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = connOptions.m_peer_connect_timeout;
+        nMsgHandlerThreads = std::max(1, std::min(connOptions.nMsgHandlerThreads, MAX_MSGHANDLER_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -347,14 +377,20 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(int worker_num);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
     bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+    bool InitSocketEvents();
+    void RegisterSocketEvents(CNode* pnode);
+    bool SocketRecvData(CNode* pnode);
     void SocketHandler();
+#ifdef USE_EPOLL
+    void SocketHandlerEpoll();
+#endif
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -407,6 +443,13 @@ private:
 
     std::vector<ListenSocket> vhListenSocket;
     std::atomic<bool> fNetworkActive{true};
+
+    /** epoll instance the sockets are registered with, -1 when polling all sockets instead */
+    int m_epoll_fd{-1};
+    /** Peers that may have more to read, each holding a reference. Only used by the socket thread. */
+    std::vector<CNode*> m_recv_ready_nodes;
+    /** When InactivityCheck last went over all peers, in seconds */
+    int64_t m_last_inactivity_check{0};
     bool fAddressesInitialized{false};
     CAddrMan addrman;
     std::deque<std::string> vOneShots GUARDED_BY(cs_vOneShots);
@@ -453,6 +496,9 @@ private:
     NetEventsInterface* m_msgproc;
     BanMan* m_banman;
 
+    /** Number of threads processing messages, each peer is handled by one of them at a time */
+    int nMsgHandlerThreads;
+
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
@@ -469,7 +515,7 @@ private:
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of m_max_outbound_full_relay
@@ -649,6 +695,9 @@ public:
         vRecv.SetVersion(nVersionIn);
     }
 
+    //! Prepare for receiving another message, keeping the allocated buffers
+    void Reset(const CMessageHeader::MessageStartChars& pchMessageStartIn);
+
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
 };
@@ -665,17 +714,33 @@ public:
     size_t nSendSize{0}; // total size of all vSendMsg entries
     size_t nSendOffset{0}; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<CSendBuffer> vSendMsg GUARDED_BY(cs_vSend);
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
+    //! epoll instance hSocket is registered with, -1 if none
+    int m_epoll_fd GUARDED_BY(cs_hSocket){-1};
+    //! Whether the peer is in CConnman::m_recv_ready_nodes, only used by the socket thread
+    bool m_recv_ready{false};
     CCriticalSection cs_vRecv;
 
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
     size_t nProcessQueueSize{0};
 
+    //! Processed messages the next ones are received into, see RecycleMessages
+    CCriticalSection cs_vRecvMsgPool;
+    std::list<CNetMessage> vRecvMsgPool GUARDED_BY(cs_vRecvMsgPool);
+    size_t nRecvMsgPoolSize GUARDED_BY(cs_vRecvMsgPool){0};
+
     CCriticalSection cs_sendProcessing;
 
+    //! Held by the message handler thread processing this peer, see CConnman::ThreadMessageHandler
+    CCriticalSection cs_msgProcessing;
+    //! Set by a message handler thread before it tries cs_msgProcessing and
+    //! cleared once it holds it. Still set after release means that another
+    //! thread was turned away, so the holder looks at the peer again.
+    std::atomic_bool fMsgProcRetry{false};
+
     std::deque<CInv> vRecvGetData;
     uint64_t nRecvBytes GUARDED_BY(cs_vRecv){0};
     std::atomic<int> nRecvVersion{INIT_PROTO_VERSION};
@@ -727,14 +792,17 @@ public:
     uint256 hashContinue;
     std::atomic<int> nStartingHeight{-1};
 
-    // flood relay
-    std::vector<CAddress> vAddrToSend;
-    CRollingBloomFilter addrKnown;
+    // flood relay, addresses may be pushed by the handlers of other peers
+    CCriticalSection cs_addrSend;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(cs_addrSend);
+    CRollingBloomFilter addrKnown GUARDED_BY(cs_addrSend);
     bool fGetAddr{false};
     int64_t nNextAddrSend GUARDED_BY(cs_sendProcessing){0};
     int64_t nNextLocalAddrSend GUARDED_BY(cs_sendProcessing){0};
-    uint256 hashCheckpointKnown;
-    bool supportACPMessages{false};
+    // sync-checkpoint relay, also done by the handlers of other peers
+    CCriticalSection cs_checkpointKnown;
+    uint256 hashCheckpointKnown GUARDED_BY(cs_checkpointKnown);
+    bool supportACPMessages GUARDED_BY(cs_checkpointKnown){false};
 
     const bool m_addr_relay_peer;
     bool IsAddrRelayPeer() const { return m_addr_relay_peer; }
@@ -855,6 +923,10 @@ public:
     }
 
     bool ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete);
+    /** Hand processed messages back, so that their list entries and buffers
+     *  are used for receiving the next messages instead of allocating anew.
+     *  Messages beyond MAX_RECYCLED_MESSAGE_BYTES are left in msgs. */
+    void RecycleMessages(std::list<CNetMessage>& msgs);
 
     void SetRecvVersion(int nVersionIn)
     {
@@ -886,6 +958,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -894,6 +967,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
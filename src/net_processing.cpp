@@ -17,6 +17,7 @@
 #include <merkleblock.h>
 #include <netmessagemaker.h>
 #include <netbase.h>
+#include <optional.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
@@ -81,6 +82,8 @@ static_assert(INBOUND_PEER_TX_DELAY >= MAX_GETDATA_RANDOM_DELAY,
 "To preserve security, MAX_GETDATA_RANDOM_DELAY should not exceed INBOUND_PEER_DELAY");
 /** Limit to avoid sending big packets. Not used in processing incoming GETDATA for compatibility */
 static const unsigned int MAX_GETDATA_SZ = 1000;
+/** Maximum number of queued BLOCK messages from one peer whose blocks are checked together */
+static constexpr unsigned int MAX_BLOCK_MESSAGES_CHECKED_TOGETHER = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
 
 
 struct COrphanTx {
@@ -262,6 +265,8 @@ struct CNodeState {
      * otherwise: whether this peer sends non-witnesses in cmpctblocks/blocktxns.
      */
     bool fSupportsDesiredCmpctVersion;
+    //! A getblocktxn request for a block we passed on before having it, answered once it arrives
+    Optional<BlockTransactionsRequest> m_pending_blocktxn;
 
     /** State used to enforce CHAIN_SYNC_TIMEOUT
       * Only in effect for outbound, non-manual, full-relay connections, with
@@ -1150,54 +1155,91 @@ void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pb
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent_block);
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block GUARDED_BY(cs_most_recent_block);
+/** most_recent_compact_block serialized with witnesses, queued as is for every peer it goes to */
+static std::shared_ptr<const std::vector<unsigned char>> most_recent_compact_block_data GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
 static bool fWitnessesPresentInMostRecentCompactBlock GUARDED_BY(cs_most_recent_block);
 
+static void SendBlockTransactions(const CBlock& block, const BlockTransactionsRequest& req, CNode* pfrom, CConnman* connman);
+
+/** Serialize a compact block once, so that the same bytes can be sent to many peers */
+static std::shared_ptr<const std::vector<unsigned char>> SerializeCompactBlock(const CBlockHeaderAndShortTxIDs& cmpctblock)
+{
+    auto data = std::make_shared<std::vector<unsigned char>>();
+    CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, *data, 0, cmpctblock};
+    return data;
+}
+
+static CSerializedNetMsg MakeCompactBlockMsg(const std::shared_ptr<const std::vector<unsigned char>>& cmpct_data)
+{
+    return CNetMsgMaker::MakeExternal(NetMsgType::CMPCTBLOCK, cmpct_data, MakeSpan(*cmpct_data));
+}
+
+/**
+ * Announce a block as a compact block to the peers that asked for new blocks
+ * that way and don't have it yet.
+ */
+static void AnnounceCompactBlock(const CBlockIndex* pindex, const std::shared_ptr<const std::vector<unsigned char>>& cmpct_data, bool fWitnessEnabled, CConnman* connman, const char* caller) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    connman->ForEachNode([pindex, &cmpct_data, fWitnessEnabled, connman, caller](CNode* pnode) {
+        AssertLockHeld(cs_main);
+
+        if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
+            return;
+        ProcessBlockAvailability(pnode->GetId());
+        CNodeState &state = *State(pnode->GetId());
+        // If the peer has, or we announced to them the previous block already,
+        // but we don't think they have this one, go ahead and announce it
+        if (state.fPreferHeaderAndIDs && (!fWitnessEnabled || state.fWantsCmpctWitness) &&
+                !PeerHasHeader(&state, pindex) && PeerHasHeader(&state, pindex->pprev)) {
+
+            LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", caller,
+                    pindex->GetBlockHash().ToString(), pnode->GetId());
+            connman->PushMessage(pnode, MakeCompactBlockMsg(cmpct_data));
+            state.pindexBestHeaderSent = pindex;
+        }
+    });
+}
+
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
  * to compatible peers.
  */
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    std::shared_ptr<const std::vector<unsigned char>> cmpct_data = SerializeCompactBlock(*pcmpctblock);
 
     LOCK(cs_main);
 
+    // Answer the peers that asked for transactions of this block while we
+    // were waiting for it, see the GETBLOCKTXN handling
+    const uint256& hashBlock = pblock->GetHash();
+    connman->ForEachNode([&pblock, &hashBlock, this](CNode* pnode) {
+        AssertLockHeld(cs_main);
+        CNodeState* nodestate = State(pnode->GetId());
+        if (nodestate && nodestate->m_pending_blocktxn && nodestate->m_pending_blocktxn->blockhash == hashBlock) {
+            SendBlockTransactions(*pblock, *nodestate->m_pending_blocktxn, pnode, connman);
+            nodestate->m_pending_blocktxn = nullopt;
+        }
+    });
+
     static int nHighestFastAnnounce = 0;
     if (pindex->nHeight <= nHighestFastAnnounce)
         return;
     nHighestFastAnnounce = pindex->nHeight;
 
     bool fWitnessEnabled = IsWitnessEnabled(pindex->pprev, Params().GetConsensus());
-    uint256 hashBlock(pblock->GetHash());
 
     {
         LOCK(cs_most_recent_block);
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_compact_block_data = cmpct_data;
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
-        AssertLockHeld(cs_main);
-
-        // TODO: Avoid the repeated-serialization here
-        if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect)
-            return;
-        ProcessBlockAvailability(pnode->GetId());
-        CNodeState &state = *State(pnode->GetId());
-        // If the peer has, or we announced to them the previous block already,
-        // but we don't think they have this one, go ahead and announce it
-        if (state.fPreferHeaderAndIDs && (!fWitnessEnabled || state.fWantsCmpctWitness) &&
-                !PeerHasHeader(&state, pindex) && PeerHasHeader(&state, pindex->pprev)) {
-
-            LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
-                    hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
-            state.pindexBestHeaderSent = pindex;
-        }
-    });
+    AnnounceCompactBlock(pindex, cmpct_data, fWitnessEnabled, connman, "PeerLogicValidation::NewPoWValidBlock");
 }
 
 /**
@@ -1362,12 +1404,14 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     bool send = false;
     std::shared_ptr<const CBlock> a_recent_block;
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
+    std::shared_ptr<const std::vector<unsigned char>> a_recent_compact_block_data;
     bool fWitnessesPresentInARecentCompactBlock;
     const Consensus::Params& consensusParams = chainparams.GetConsensus();
     {
         LOCK(cs_most_recent_block);
         a_recent_block = most_recent_block;
         a_recent_compact_block = most_recent_compact_block;
+        a_recent_compact_block_data = most_recent_compact_block_data;
         fWitnessesPresentInARecentCompactBlock = fWitnessesPresentInMostRecentCompactBlock;
     }
 
@@ -1432,12 +1476,19 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             pblock = a_recent_block;
         } else if (inv.type == MSG_WITNESS_BLOCK) {
             // Fast-path: in this case it is possible to serve the block directly from disk,
-            // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
-            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart(), chainparams.MessageStartOld())) {
-                assert(!"cannot load block from disk");
+            // as the network format matches the format on disk. Send it from a mapping of
+            // the block file where possible, rather than copying it.
+            std::shared_ptr<const MappedFlatFile> block_file;
+            Span<const uint8_t> block_span;
+            if (MapRawBlockFromDisk(block_file, block_span, pindex, chainparams.MessageStart(), chainparams.MessageStartOld())) {
+                connman->PushMessage(pfrom, CNetMsgMaker::MakeExternal(NetMsgType::BLOCK, std::move(block_file), block_span));
+            } else {
+                std::vector<uint8_t> block_data;
+                if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart(), chainparams.MessageStartOld())) {
+                    assert(!"cannot load block from disk");
+                }
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
             }
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
             // Don't set pblock as we've sent the block
         } else {
             // Send block from disk
@@ -1487,7 +1538,8 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                 int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
                 if (CanDirectFetch(consensusParams) && pindex->nHeight >= ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH) {
                     if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
+                        // Without witnesses in the block, the serialization with them is the same
+                        connman->PushMessage(pfrom, MakeCompactBlockMsg(a_recent_compact_block_data));
                     } else {
                         CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
                         connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
@@ -1601,7 +1653,7 @@ static uint32_t GetFetchFlags(CNode* pfrom) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     return nFetchFlags;
 }
 
-inline void static SendBlockTransactions(const CBlock& block, const BlockTransactionsRequest& req, CNode* pfrom, CConnman* connman) {
+static void SendBlockTransactions(const CBlock& block, const BlockTransactionsRequest& req, CNode* pfrom, CConnman* connman) {
     BlockTransactions resp(req);
     for (size_t i = 0; i < req.indexes.size(); i++) {
         if (req.indexes[i] >= block.vtx.size()) {
@@ -1800,34 +1852,44 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
-void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set, std::list<CTransactionRef>& removed_txn) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+void ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set, std::list<CTransactionRef>& removed_txn) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(g_cs_orphans);
-    std::set<NodeId> setMisbehaving;
-    bool done = false;
-    while (!done && !orphan_work_set.empty()) {
-        const uint256 orphanHash = *orphan_work_set.begin();
-        orphan_work_set.erase(orphan_work_set.begin());
 
-        auto orphan_it = mapOrphanTransactions.find(orphanHash);
+    // Try up to MAX_TX_MESSAGES_ACCEPTED_TOGETHER orphans of the work set
+    // together, so that their scripts are checked in parallel. The rest, and
+    // the orphans of those accepted, are left for next time, which bounds the
+    // work done in one turn of the message handler.
+    std::vector<MempoolAcceptEntry> entries;
+    std::vector<NodeId> from_peers;
+    auto work_end = orphan_work_set.begin();
+    for (unsigned int n = 0; n < MAX_TX_MESSAGES_ACCEPTED_TOGETHER && work_end != orphan_work_set.end(); ++n, ++work_end) {
+        auto orphan_it = mapOrphanTransactions.find(*work_end);
         if (orphan_it == mapOrphanTransactions.end()) continue;
+        entries.emplace_back(orphan_it->second.tx, GetTime());
+        from_peers.push_back(orphan_it->second.fromPeer);
+    }
+    orphan_work_set.erase(orphan_work_set.begin(), work_end);
+    if (entries.empty()) return;
+    AcceptToMemoryPoolMany(mempool, entries, &removed_txn, false /* bypass_limits */, 0 /* nAbsurdFee */);
 
-        const CTransactionRef porphanTx = orphan_it->second.tx;
-        const CTransaction& orphanTx = *porphanTx;
-        NodeId fromPeer = orphan_it->second.fromPeer;
-        bool fMissingInputs2 = false;
-        // Use a new CValidationState because orphans come from different peers (and we call
-        // MaybePunishNode based on the source peer from the orphan map, not based on the peer
-        // that relayed the previous transaction).
-        CValidationState orphan_state;
-
-        if (setMisbehaving.count(fromPeer)) continue;
-        if (AcceptToMemoryPool(mempool, orphan_state, porphanTx, &fMissingInputs2, &removed_txn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+    std::set<NodeId> setMisbehaving;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const CTransaction& orphanTx = *entries[i].tx;
+        const uint256& orphanHash = orphanTx.GetHash();
+        NodeId fromPeer = from_peers[i];
+        // Each orphan has its own CValidationState because orphans come from
+        // different peers (and we call MaybePunishNode based on the source peer
+        // from the orphan map, not based on the peer that relayed the previous
+        // transaction).
+        const CValidationState& orphan_state = entries[i].state;
+
+        if (entries[i].accepted) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
             RelayTransaction(orphanHash, *connman);
-            for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
+            for (unsigned int j = 0; j < orphanTx.vout.size(); j++) {
+                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, j));
                 if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
                     for (const auto& elem : it_by_prev->second) {
                         orphan_work_set.insert(elem->first);
@@ -1835,8 +1897,8 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
                 }
             }
             EraseOrphanTx(orphanHash);
-            done = true;
-        } else if (!fMissingInputs2) {
+        } else if (!entries[i].missing_inputs) {
+            if (setMisbehaving.count(fromPeer)) continue;
             if (orphan_state.IsInvalid()) {
                 // Punish peer that gave us an invalid orphan tx
                 if (MaybePunishNode(fromPeer, orphan_state, /*via_compact_block*/ false)) {
@@ -1856,9 +1918,194 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
                 recentRejects->insert(orphanHash);
             }
             EraseOrphanTx(orphanHash);
-            done = true;
         }
+    }
+    mempool.check(&::ChainstateActive().CoinsTip());
+}
+
+/** Process a block received in a BLOCK message */
+static void ProcessBlockFromPeer(CNode* pfrom, const std::shared_ptr<const CBlock>& pblock, const CChainParams& chainparams)
+{
+    LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
+
+    bool forceProcessing = false;
+    const uint256 hash(pblock->GetHash());
+    {
+        LOCK(cs_main);
+        // Also always process if we requested the block explicitly, as we may
+        // need it even though it is not a candidate for a new best tip.
+        forceProcessing |= MarkBlockAsReceived(hash);
+        // mapBlockSource is only used for sending reject messages and DoS scores,
+        // so the race between here and cs_main in ProcessNewBlock is fine.
+        mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
+    }
+    bool fNewBlock = false;
+    ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock);
+    if (fNewBlock) {
+        pfrom->nLastBlockTime = GetTime();
+    } else {
+        LOCK(cs_main);
+        mapBlockSource.erase(pblock->GetHash());
+    }
+}
+
+/** Whether the peer may send us transactions. A peer that may not is disconnected. */
+static bool CheckTxRelayAllowed(CNode* pfrom)
+{
+    // Stop processing the transaction early if
+    // We are in blocks only mode and peer is either not whitelisted or whitelistrelay is off
+    // or if this peer is supposed to be a block-relay-only peer
+    if ((!g_relay_txes && !pfrom->HasPermission(PF_RELAY)) || (pfrom->m_tx_relay == nullptr))
+    {
+        LogPrint(BCLog::NET, "transaction sent in violation of protocol peer=%d\n", pfrom->GetId());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Note that a peer sent a transaction: it no longer needs to be requested.
+ * Returns whether we have the transaction already, in which case it is not
+ * to be accepted to the memory pool again.
+ */
+static bool AlreadyHaveTxFromPeer(CNode* pfrom, const CTransaction& tx) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    CInv inv(MSG_TX, tx.GetHash());
+    pfrom->AddInventoryKnown(inv);
+
+    CNodeState* nodestate = State(pfrom->GetId());
+    nodestate->m_tx_download.m_tx_announced.erase(inv.hash);
+    nodestate->m_tx_download.m_tx_in_flight.erase(inv.hash);
+    EraseTxRequest(inv.hash);
+
+    return AlreadyHave(inv);
+}
+
+/**
+ * Act on the outcome of accepting a transaction from a peer to the memory
+ * pool: relay it and retry the orphans spending it, keep it as an orphan, or
+ * remember that it was rejected and punish the peer for an invalid one.
+ */
+static void ProcessTxResult(CNode* pfrom, const CTransactionRef& ptx, bool accepted, bool fMissingInputs, const CValidationState& state,
+                            std::list<CTransactionRef>& lRemovedTxn, CConnman* connman, bool enable_bip61) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+{
+    const CTransaction& tx = *ptx;
+    const CInv inv(MSG_TX, tx.GetHash());
+
+    if (accepted) {
         mempool.check(&::ChainstateActive().CoinsTip());
+        RelayTransaction(tx.GetHash(), *connman);
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
+            if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+                for (const auto& elem : it_by_prev->second) {
+                    pfrom->orphan_work_set.insert(elem->first);
+                }
+            }
+        }
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+            pfrom->GetId(),
+            tx.GetHash().ToString(),
+            mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+
+        // Recursively process any orphan transactions that depended on this one
+        ProcessOrphanTx(connman, pfrom->orphan_work_set, lRemovedTxn);
+    }
+    else if (fMissingInputs)
+    {
+        bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+        for (const CTxIn& txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.hash)) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            uint32_t nFetchFlags = GetFetchFlags(pfrom);
+            const auto current_time = GetTime<std::chrono::microseconds>();
+
+            for (const CTxIn& txin : tx.vin) {
+                CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) RequestTx(State(pfrom->GetId()), _inv.hash, current_time);
+            }
+            AddOrphanTx(ptx, pfrom->GetId());
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded (see CVE-2012-3789)
+            unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetHash());
+        }
+    } else {
+        assert(IsTransactionReason(state.GetReason()));
+        if (!tx.HasWitness() && state.GetReason() != ValidationInvalidReason::TX_WITNESS_MUTATED) {
+            // Do not use rejection cache for witness transactions or
+            // witness-stripped transactions, as they can have been malleated.
+            // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+            assert(recentRejects);
+            recentRejects->insert(tx.GetHash());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
+            AddToCompactExtraTransactions(ptx);
+        }
+
+        if (pfrom->HasPermission(PF_FORCERELAY)) {
+            // Always relay transactions received from whitelisted peers, even
+            // if they were already in the mempool or rejected from it due
+            // to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that might result in being
+            // disconnected (or banned).
+            if (state.IsInvalid() && TxRelayMayResultInDisconnect(state)) {
+                LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
+            } else {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
+                RelayTransaction(tx.GetHash(), *connman);
+            }
+        }
+    }
+
+    // If a tx has been detected by recentRejects, we will have reached
+    // this point and the tx will have been ignored. Because we haven't run
+    // the tx through AcceptToMemoryPool, we won't have computed a DoS
+    // score for it or determined exactly why we consider it invalid.
+    //
+    // This means we won't penalize any peer subsequently relaying a DoSy
+    // tx (even if we penalized the first peer who gave it to us) because
+    // we have to account for recentRejects showing false positives. In
+    // other words, we shouldn't penalize a peer if we aren't *sure* they
+    // submitted a DoSy tx.
+    //
+    // Note that recentRejects doesn't just record DoSy or invalid
+    // transactions, but any tx not accepted by the mempool, which may be
+    // due to node policy (vs. consensus). So we can't blanket penalize a
+    // peer simply for relaying a tx that our recentRejects has caught,
+    // regardless of false positives.
+
+    if (state.IsInvalid())
+    {
+        LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+            pfrom->GetId(),
+            FormatStateMessage(state));
+        if (enable_bip61 && state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) { // Never send AcceptToMemoryPool's internal codes over P2P
+            connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::REJECT, std::string(NetMsgType::TX), (unsigned char)state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
+        }
+        MaybePunishNode(pfrom->GetId(), state, /*via_compact_block*/ false);
     }
 }
 
@@ -2053,7 +2300,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
 
         if((nServices & NODE_ACP)) {
-            pfrom->supportACPMessages = true;
+            WITH_LOCK(pfrom->cs_checkpointKnown, pfrom->supportACPMessages = true);
 
             // Relay sync-checkpoint
             {
@@ -2399,6 +2646,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         const CBlockIndex* pindex = LookupBlockIndex(req.blockhash);
         if (!pindex || !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (pindex && nodestate->pindexBestHeaderSent == pindex) {
+                // We passed the compact block on before having the block,
+                // answer once it arrives (in NewPoWValidBlock)
+                nodestate->m_pending_blocktxn = req;
+                return true;
+            }
             LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->GetId());
             return true;
         }
@@ -2496,153 +2750,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
     if (strCommand == NetMsgType::TX) {
-        // Stop processing the transaction early if
-        // We are in blocks only mode and peer is either not whitelisted or whitelistrelay is off
-        // or if this peer is supposed to be a block-relay-only peer
-        if ((!g_relay_txes && !pfrom->HasPermission(PF_RELAY)) || (pfrom->m_tx_relay == nullptr))
-        {
-            LogPrint(BCLog::NET, "transaction sent in violation of protocol peer=%d\n", pfrom->GetId());
-            pfrom->fDisconnect = true;
+        if (!CheckTxRelayAllowed(pfrom))
             return true;
-        }
 
         CTransactionRef ptx;
         vRecv >> ptx;
-        const CTransaction& tx = *ptx;
-
-        CInv inv(MSG_TX, tx.GetHash());
-        pfrom->AddInventoryKnown(inv);
 
         LOCK2(cs_main, g_cs_orphans);
 
         bool fMissingInputs = false;
         CValidationState state;
-
-        CNodeState* nodestate = State(pfrom->GetId());
-        nodestate->m_tx_download.m_tx_announced.erase(inv.hash);
-        nodestate->m_tx_download.m_tx_in_flight.erase(inv.hash);
-        EraseTxRequest(inv.hash);
-
         std::list<CTransactionRef> lRemovedTxn;
 
-        if (!AlreadyHave(inv) &&
-            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            mempool.check(&::ChainstateActive().CoinsTip());
-            RelayTransaction(tx.GetHash(), *connman);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
-
-            pfrom->nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
-                pfrom->GetId(),
-                tx.GetHash().ToString(),
-                mempool.size(), mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this one
-            ProcessOrphanTx(connman, pfrom->orphan_work_set, lRemovedTxn);
-        }
-        else if (fMissingInputs)
-        {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-            for (const CTxIn& txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                uint32_t nFetchFlags = GetFetchFlags(pfrom);
-                const auto current_time = GetTime<std::chrono::microseconds>();
-
-                for (const CTxIn& txin : tx.vin) {
-                    CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) RequestTx(State(pfrom->GetId()), _inv.hash, current_time);
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded (see CVE-2012-3789)
-                unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetHash());
-            }
-        } else {
-            assert(IsTransactionReason(state.GetReason()));
-            if (!tx.HasWitness() && state.GetReason() != ValidationInvalidReason::TX_WITNESS_MUTATED) {
-                // Do not use rejection cache for witness transactions or
-                // witness-stripped transactions, as they can have been malleated.
-                // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                assert(recentRejects);
-                recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
-                AddToCompactExtraTransactions(ptx);
-            }
-
-            if (pfrom->HasPermission(PF_FORCERELAY)) {
-                // Always relay transactions received from whitelisted peers, even
-                // if they were already in the mempool or rejected from it due
-                // to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that might result in being
-                // disconnected (or banned).
-                if (state.IsInvalid() && TxRelayMayResultInDisconnect(state)) {
-                    LogPrintf("Not relaying invalid transaction %s from whitelisted peer=%d (%s)\n", tx.GetHash().ToString(), pfrom->GetId(), FormatStateMessage(state));
-                } else {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
-                    RelayTransaction(tx.GetHash(), *connman);
-                }
-            }
-        }
+        const bool accepted = !AlreadyHaveTxFromPeer(pfrom, *ptx) &&
+            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */);
+        ProcessTxResult(pfrom, ptx, accepted, fMissingInputs, state, lRemovedTxn, connman, enable_bip61);
 
         for (const CTransactionRef& removedTx : lRemovedTxn)
             AddToCompactExtraTransactions(removedTx);
-
-        // If a tx has been detected by recentRejects, we will have reached
-        // this point and the tx will have been ignored. Because we haven't run
-        // the tx through AcceptToMemoryPool, we won't have computed a DoS
-        // score for it or determined exactly why we consider it invalid.
-        //
-        // This means we won't penalize any peer subsequently relaying a DoSy
-        // tx (even if we penalized the first peer who gave it to us) because
-        // we have to account for recentRejects showing false positives. In
-        // other words, we shouldn't penalize a peer if we aren't *sure* they
-        // submitted a DoSy tx.
-        //
-        // Note that recentRejects doesn't just record DoSy or invalid
-        // transactions, but any tx not accepted by the mempool, which may be
-        // due to node policy (vs. consensus). So we can't blanket penalize a
-        // peer simply for relaying a tx that our recentRejects has caught,
-        // regardless of false positives.
-
-        if (state.IsInvalid())
-        {
-            LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
-                pfrom->GetId(),
-                FormatStateMessage(state));
-            if (enable_bip61 && state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) { // Never send AcceptToMemoryPool's internal codes over P2P
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
-                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash));
-            }
-            MaybePunishNode(pfrom->GetId(), state, /*via_compact_block*/ false);
-        }
         return true;
     }
 
@@ -2741,6 +2866,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        // The header and its proof of work are valid and the block extends
+        // our tip: pass it on to high-bandwidth peers now, rather than after
+        // it is reconstructed and connected. BIP 152 allows this, and such
+        // peers don't punish us should the block turn out invalid.
+        if (received_new_header && pindex->pprev == ::ChainActive().Tip() && gArgs.GetBoolArg("-earlycmpctrelay", DEFAULT_EARLY_CMPCT_RELAY)) {
+            AnnounceCompactBlock(pindex, SerializeCompactBlock(cmpctblock), IsWitnessEnabled(pindex->pprev, chainparams.GetConsensus()), connman, "ProcessMessage");
+        }
+
         // We want to be a bit conservative just to be extra careful about DoS
         // possibilities in compact block processing...
         if (pindex->nHeight <= ::ChainActive().Height() + 2) {
@@ -2985,27 +3118,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
 
-        LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
-
-        bool forceProcessing = false;
-        const uint256 hash(pblock->GetHash());
-        {
-            LOCK(cs_main);
-            // Also always process if we requested the block explicitly, as we may
-            // need it even though it is not a candidate for a new best tip.
-            forceProcessing |= MarkBlockAsReceived(hash);
-            // mapBlockSource is only used for sending reject messages and DoS scores,
-            // so the race between here and cs_main in ProcessNewBlock is fine.
-            mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
-        }
-        bool fNewBlock = false;
-        ProcessNewBlock(chainparams, pblock, forceProcessing, &fNewBlock);
-        if (fNewBlock) {
-            pfrom->nLastBlockTime = GetTime();
-        } else {
-            LOCK(cs_main);
-            mapBlockSource.erase(pblock->GetHash());
-        }
+        ProcessBlockFromPeer(pfrom, pblock, chainparams);
         return true;
     }
 
@@ -3032,7 +3145,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        WITH_LOCK(pfrom->cs_addrSend, pfrom->vAddrToSend.clear());
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr) {
@@ -3156,7 +3269,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (checkpoint.ProcessSyncCheckpoint())
         {
             // Relay checkpoint
-            pfrom->hashCheckpointKnown = checkpoint.hashCheckpoint;
+            WITH_LOCK(pfrom->cs_checkpointKnown, pfrom->hashCheckpointKnown = checkpoint.hashCheckpoint);
             g_connman->ForEachNode([&checkpoint](CNode* pnode) {
                 checkpoint.RelayTo(pnode);
             });
@@ -3297,6 +3410,152 @@ bool PeerLogicValidation::SendRejectsAndCheckIfBanned(CNode* pnode, bool enable_
     return false;
 }
 
+/**
+ * Check the message start, header and checksum of a received message. A
+ * message with an unknown message start gets the peer disconnected.
+ */
+static bool CheckMessageFraming(CNode* pfrom, const CNetMessage& msg, const CChainParams& chainparams)
+{
+    bool fMagic = false;
+
+    // Scan for message start
+    if (memcmp(msg.hdr.pchMessageStart, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE) == 0) {
+        fMagic = false;
+    } else if (memcmp(msg.hdr.pchMessageStart, chainparams.MessageStartOld(), CMessageHeader::MESSAGE_START_SIZE) == 0) {
+        fMagic = true;
+    } else {
+        LogPrint(BCLog::NET, "PROCESSMESSAGE: INVALID MESSAGESTART %s peer=%d\n", SanitizeString(msg.hdr.GetCommand()), pfrom->GetId());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    // Read header
+    const CMessageHeader& hdr = msg.hdr;
+    bool validHeader = fMagic ? hdr.IsValid(chainparams.MessageStartOld()) : hdr.IsValid(chainparams.MessageStart());
+    if (!validHeader)
+    {
+        LogPrint(BCLog::NET, "PROCESSMESSAGE: ERRORS IN HEADER %s peer=%d\n", SanitizeString(hdr.GetCommand()), pfrom->GetId());
+        return false;
+    }
+
+    // Checksum
+    const uint256& hash = msg.GetMessageHash();
+    if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+    {
+        LogPrint(BCLog::NET, "%s(%s, %u bytes): CHECKSUM ERROR expected %s was %s\n", __func__,
+           SanitizeString(hdr.GetCommand()), hdr.nMessageSize,
+           HexStr(hash.begin(), hash.begin()+CMessageHeader::CHECKSUM_SIZE),
+           HexStr(hdr.pchChecksum, hdr.pchChecksum+CMessageHeader::CHECKSUM_SIZE));
+        return false;
+    }
+    return true;
+}
+
+static bool IsBlockMessage(const CNetMessage& msg)
+{
+    return msg.hdr.GetCommand() == NetMsgType::BLOCK;
+}
+
+static bool IsTxMessage(const CNetMessage& msg)
+{
+    return msg.hdr.GetCommand() == NetMsgType::TX;
+}
+
+/**
+ * Process a run of BLOCK messages from one peer. All blocks are read first
+ * and their context-free checks run together on the block check queue, then
+ * each block is processed as a single BLOCK message would be.
+ */
+static void ProcessBlockMessages(CNode* pfrom, std::list<CNetMessage>& msgs, const CChainParams& chainparams, const std::atomic<bool>& interruptMsgProc)
+{
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    for (CNetMessage& msg : msgs) {
+        msg.SetVersion(pfrom->GetRecvVersion());
+        if (!CheckMessageFraming(pfrom, msg, chainparams)) {
+            if (pfrom->fDisconnect) return;
+            continue;
+        }
+        // Ignore block received while importing
+        if (fImporting || fReindex) {
+            LogPrint(BCLog::NET, "Unexpected block message received from peer %d\n", pfrom->GetId());
+            continue;
+        }
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        try {
+            msg.vRecv >> *pblock;
+        } catch (const std::exception& e) {
+            LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' (%s) caught\n", __func__, NetMsgType::BLOCK, msg.hdr.nMessageSize, e.what(), typeid(e).name());
+            continue;
+        }
+        blocks.push_back(std::move(pblock));
+    }
+
+    CheckBlocks(blocks, chainparams.GetConsensus());
+
+    for (const std::shared_ptr<const CBlock>& pblock : blocks) {
+        if (interruptMsgProc || pfrom->fDisconnect) return;
+        ProcessBlockFromPeer(pfrom, pblock, chainparams);
+    }
+}
+
+/**
+ * Process a run of TX messages from one peer. The transactions are accepted
+ * to the memory pool together, so that their scripts are checked together on
+ * the script check threads, then each outcome is handled as for a single TX
+ * message.
+ */
+static void ProcessTxMessages(CNode* pfrom, std::list<CNetMessage>& msgs, const CChainParams& chainparams, CConnman* connman, bool enable_bip61)
+{
+    std::vector<CTransactionRef> txs;
+    for (CNetMessage& msg : msgs) {
+        msg.SetVersion(pfrom->GetRecvVersion());
+        if (!CheckMessageFraming(pfrom, msg, chainparams)) {
+            if (pfrom->fDisconnect) return;
+            continue;
+        }
+        if (!CheckTxRelayAllowed(pfrom)) return;
+        CTransactionRef ptx;
+        try {
+            msg.vRecv >> ptx;
+        } catch (const std::exception& e) {
+            LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' (%s) caught\n", __func__, NetMsgType::TX, msg.hdr.nMessageSize, e.what(), typeid(e).name());
+            continue;
+        }
+        txs.push_back(std::move(ptx));
+    }
+
+    LOCK2(cs_main, g_cs_orphans);
+
+    // The transactions we don't have yet, each once, in the order received
+    static constexpr size_t NO_ENTRY = std::numeric_limits<size_t>::max();
+    std::vector<MempoolAcceptEntry> entries;
+    std::vector<size_t> entry_of_tx;
+    std::set<uint256> queued;
+    for (const CTransactionRef& ptx : txs) {
+        if (AlreadyHaveTxFromPeer(pfrom, *ptx) || !queued.insert(ptx->GetHash()).second) {
+            entry_of_tx.push_back(NO_ENTRY);
+            continue;
+        }
+        entry_of_tx.push_back(entries.size());
+        entries.emplace_back(ptx, GetTime());
+    }
+
+    std::list<CTransactionRef> lRemovedTxn;
+    AcceptToMemoryPoolMany(mempool, entries, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */);
+
+    for (size_t i = 0; i < txs.size(); ++i) {
+        if (entry_of_tx[i] != NO_ENTRY) {
+            const MempoolAcceptEntry& entry = entries[entry_of_tx[i]];
+            ProcessTxResult(pfrom, entry.tx, entry.accepted, entry.missing_inputs, entry.state, lRemovedTxn, connman, enable_bip61);
+        } else {
+            ProcessTxResult(pfrom, txs[i], false, false, CValidationState(), lRemovedTxn, connman, enable_bip61);
+        }
+    }
+
+    for (const CTransactionRef& removedTx : lRemovedTxn)
+        AddToCompactExtraTransactions(removedTx);
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -3309,7 +3568,6 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     //  (x) data
     //
     bool fMoreWork = false;
-    bool fMagic = false;
 
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
@@ -3336,54 +3594,63 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return false;
 
     std::list<CNetMessage> msgs;
+    // Hand the message back to the peer when done, to receive another into
+    struct Recycler {
+        CNode* pnode;
+        std::list<CNetMessage>& msgs;
+        ~Recycler() { pnode->RecycleMessages(msgs); }
+    } recycler{pfrom, msgs};
     {
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
-        // Just take one message
-        msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
-        pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+        // Just take one message, or a run of block or transaction messages
+        // from a peer that is past the handshake, so their blocks can be
+        // checked together, and their transactions accepted together.
+        auto msgs_end = std::next(pfrom->vProcessMsg.begin());
+        if (pfrom->fSuccessfullyConnected && IsBlockMessage(pfrom->vProcessMsg.front())) {
+            for (unsigned int n = 1; n < MAX_BLOCK_MESSAGES_CHECKED_TOGETHER && msgs_end != pfrom->vProcessMsg.end() && IsBlockMessage(*msgs_end); ++n) {
+                ++msgs_end;
+            }
+        } else if (pfrom->fSuccessfullyConnected && IsTxMessage(pfrom->vProcessMsg.front())) {
+            for (unsigned int n = 1; n < MAX_TX_MESSAGES_ACCEPTED_TOGETHER && msgs_end != pfrom->vProcessMsg.end() && IsTxMessage(*msgs_end); ++n) {
+                ++msgs_end;
+            }
+        }
+        msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin(), msgs_end);
+        for (const CNetMessage& taken : msgs) {
+            pfrom->nProcessQueueSize -= taken.vRecv.size() + CMessageHeader::HEADER_SIZE;
+        }
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
+
+    if (msgs.size() > 1) {
+        if (IsBlockMessage(msgs.front())) {
+            ProcessBlockMessages(pfrom, msgs, chainparams, interruptMsgProc);
+        } else {
+            ProcessTxMessages(pfrom, msgs, chainparams, connman, m_enable_bip61);
+        }
+        if (interruptMsgProc || pfrom->fDisconnect)
+            return false;
+        LOCK(cs_main);
+        SendRejectsAndCheckIfBanned(pfrom, m_enable_bip61);
+        return fMoreWork;
+    }
+
     CNetMessage& msg(msgs.front());
 
     msg.SetVersion(pfrom->GetRecvVersion());
-    // Scan for message start
-    if (memcmp(msg.hdr.pchMessageStart, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE) == 0) {
-        fMagic = false;
-    } else if (memcmp(msg.hdr.pchMessageStart, chainparams.MessageStartOld(), CMessageHeader::MESSAGE_START_SIZE) == 0) {
-        fMagic = true;
-    } else {
-        LogPrint(BCLog::NET, "PROCESSMESSAGE: INVALID MESSAGESTART %s peer=%d\n", SanitizeString(msg.hdr.GetCommand()), pfrom->GetId());
-        pfrom->fDisconnect = true;
-        return false;
-    }
+    if (!CheckMessageFraming(pfrom, msg, chainparams))
+        return pfrom->fDisconnect ? false : fMoreWork;
 
-    // Read header
     CMessageHeader& hdr = msg.hdr;
-    bool validHeader = fMagic ? hdr.IsValid(chainparams.MessageStartOld()) : hdr.IsValid(chainparams.MessageStart());
-    if (!validHeader)
-    {
-        LogPrint(BCLog::NET, "PROCESSMESSAGE: ERRORS IN HEADER %s peer=%d\n", SanitizeString(hdr.GetCommand()), pfrom->GetId());
-        return fMoreWork;
-    }
     std::string strCommand = hdr.GetCommand();
 
     // Message size
     unsigned int nMessageSize = hdr.nMessageSize;
 
-    // Checksum
     CDataStream& vRecv = msg.vRecv;
-    const uint256& hash = msg.GetMessageHash();
-    if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
-    {
-        LogPrint(BCLog::NET, "%s(%s, %u bytes): CHECKSUM ERROR expected %s was %s\n", __func__,
-           SanitizeString(strCommand), nMessageSize,
-           HexStr(hash.begin(), hash.begin()+CMessageHeader::CHECKSUM_SIZE),
-           HexStr(hdr.pchChecksum, hdr.pchChecksum+CMessageHeader::CHECKSUM_SIZE));
-        return fMoreWork;
-    }
 
     // Process message
     bool fRet = false;
@@ -3604,9 +3871,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             }
         }
 
-        TRY_LOCK(cs_main, lockMain); // Acquire cs_main for IsInitialBlockDownload() and CNodeState()
-        if (!lockMain)
-            return true;
+        // Acquire cs_main for IsInitialBlockDownload() and CNodeState(). Wait
+        // for it, as other message handler threads may hold it, and skipping
+        // would leave this peer's announcements until the next round.
+        LOCK(cs_main);
 
         if (SendRejectsAndCheckIfBanned(pto, m_enable_bip61)) return true;
         CNodeState &state = *State(pto->GetId());
@@ -3623,6 +3891,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         //
         if (pto->IsAddrRelayPeer() && pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->cs_addrSend);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend)
@@ -3752,7 +4021,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         LOCK(cs_most_recent_block);
                         if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
                             if (state.fWantsCmpctWitness || !fWitnessesPresentInMostRecentCompactBlock)
-                                connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
+                                connman->PushMessage(pto, MakeCompactBlockMsg(most_recent_compact_block_data));
                             else {
                                 CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block, state.fWantsCmpctWitness);
                                 connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
@@ -20,6 +20,10 @@ static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61{false};
 static const bool DEFAULT_PEERBLOOMFILTERS = false;
+/** Maximum number of queued TX messages from one peer, or of orphans, whose transactions are accepted to the mempool together */
+static constexpr unsigned int MAX_TX_MESSAGES_ACCEPTED_TOGETHER = 100;
+/** Default for -earlycmpctrelay */
+static const bool DEFAULT_EARLY_CMPCT_RELAY = true;
 
 class PeerLogicValidation final : public CValidationInterface, public NetEventsInterface {
 private:
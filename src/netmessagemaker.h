@@ -29,6 +29,16 @@ public:
         return Make(0, std::move(sCommand), std::forward<Args>(args)...);
     }
 
+    /** Make a message with the given bytes as payload, sent from memory kept alive by owner */
+    static CSerializedNetMsg MakeExternal(std::string sCommand, std::shared_ptr<const void> owner, Span<const unsigned char> payload)
+    {
+        CSerializedNetMsg msg;
+        msg.command = std::move(sCommand);
+        msg.external_owner = std::move(owner);
+        msg.external_data = payload;
+        return msg;
+    }
+
 private:
     const int nVersion;
 };
@@ -0,0 +1,311 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODEPOOLMAP_H
+#define BITCOIN_NODEPOOLMAP_H
+
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** Hash map with open addressing and pooled entries.
+ *
+ * Meant as a replacement for std::unordered_map where many small entries are
+ * kept, like the coins cache. Entries are constructed in place in fixed size
+ * chunks of a pool, so that there is no allocation and allocator overhead
+ * per entry. The table only holds 32 bits of each entry's hash and its index
+ * in the pool, and uses linear probing, so that a lookup usually touches two
+ * cache lines: the table slot and the entry.
+ *
+ * Like std::unordered_map, and unlike most open-addressing tables, entries
+ * are never moved: pointers and references to them stay valid until the entry
+ * is erased. Iterators walk the pool rather than the table, so erasing an
+ * entry only invalidates iterators to that entry. Inserting may reuse the
+ * storage of erased entries, so the iteration order is unspecified.
+ *
+ * The memory of erased entries is kept for reuse until clear() is called,
+ * which releases everything.
+ */
+template <typename K, typename T, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>>
+class nodepoolmap
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+    //! Number of entries in one chunk of the pool
+    static const size_t CHUNK_ENTRIES = 64;
+
+private:
+    struct Chunk
+    {
+        //! Bit i is set when entry i is constructed
+        uint64_t used = 0;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type entries[CHUNK_ENTRIES];
+    };
+
+    struct Slot
+    {
+        //! Bits of the entry's hash, the low ones select its home slot
+        uint32_t hash;
+        //! Index of the entry in the pool plus one, 0 for an empty slot
+        uint32_t entry;
+    };
+
+    static const uint32_t NO_ENTRY = 0xFFFFFFFF;
+
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    std::vector<Slot> m_slots;
+    size_t m_size = 0;
+    //! First unused entry in allocated chunks, unused entries store the next one
+    uint32_t m_free = NO_ENTRY;
+    Hash m_hash;
+    Equal m_equal;
+
+    value_type* Entry(uint32_t index) const
+    {
+        return reinterpret_cast<value_type*>(&m_chunks[index / CHUNK_ENTRIES]->entries[index % CHUNK_ENTRIES]);
+    }
+
+    uint32_t& NextFree(uint32_t index) const
+    {
+        return *reinterpret_cast<uint32_t*>(&m_chunks[index / CHUNK_ENTRIES]->entries[index % CHUNK_ENTRIES]);
+    }
+
+    static uint32_t HashBits(uint64_t hash) { return (uint32_t)(hash ^ (hash >> 32)); }
+
+    //! Index of the first constructed entry at or after index
+    size_t NextUsed(size_t index) const
+    {
+        for (size_t chunk = index / CHUNK_ENTRIES; chunk < m_chunks.size(); chunk++) {
+            uint64_t used = m_chunks[chunk]->used;
+            if (chunk == index / CHUNK_ENTRIES) used &= ~(uint64_t)0 << (index % CHUNK_ENTRIES);
+            if (used) return chunk * CHUNK_ENTRIES + CountBits(used & (~used + 1)) - 1;
+        }
+        return m_chunks.size() * CHUNK_ENTRIES;
+    }
+
+    /** Find the slot holding key, or the empty slot where it would go. */
+    std::pair<size_t, bool> FindSlot(const K& key, uint32_t hash) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            const Slot& slot = m_slots[pos];
+            if (slot.entry == 0) return {pos, false};
+            if (slot.hash == hash && m_equal(Entry(slot.entry - 1)->first, key)) return {pos, true};
+        }
+    }
+
+    size_t FindEntry(const K& key) const
+    {
+        if (m_size == 0) return m_chunks.size() * CHUNK_ENTRIES;
+        auto found = FindSlot(key, HashBits(m_hash(key)));
+        return found.second ? m_slots[found.first].entry - 1 : m_chunks.size() * CHUNK_ENTRIES;
+    }
+
+    /** Keep the table at most 3/4 full, which keeps probe sequences short. */
+    void Reserve(size_t count)
+    {
+        if (count * 4 <= m_slots.size() * 3) return;
+        size_t buckets = m_slots.empty() ? 16 : m_slots.size();
+        while (count * 4 > buckets * 3) buckets *= 2;
+
+        std::vector<Slot> old(buckets, Slot{0, 0});
+        old.swap(m_slots);
+        const size_t mask = m_slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.entry == 0) continue;
+            size_t pos = slot.hash & mask;
+            while (m_slots[pos].entry != 0) pos = (pos + 1) & mask;
+            m_slots[pos] = slot;
+        }
+    }
+
+    uint32_t AllocateEntry()
+    {
+        if (m_free == NO_ENTRY) {
+            assert(m_chunks.size() < (NO_ENTRY / CHUNK_ENTRIES));
+            m_chunks.emplace_back(new Chunk());
+            const uint32_t first = (m_chunks.size() - 1) * CHUNK_ENTRIES;
+            for (uint32_t i = CHUNK_ENTRIES; i > 0; i--) {
+                NextFree(first + i - 1) = m_free;
+                m_free = first + i - 1;
+            }
+        }
+        const uint32_t index = m_free;
+        m_free = NextFree(index);
+        return index;
+    }
+
+    void FreeEntry(uint32_t index)
+    {
+        NextFree(index) = m_free;
+        m_free = index;
+    }
+
+    /** Remove the entry in slot pos from the table, shifting back the entries probed past it. */
+    void EraseSlot(size_t pos)
+    {
+        const size_t mask = m_slots.size() - 1;
+        size_t hole = pos;
+        for (size_t next = (pos + 1) & mask; m_slots[next].entry != 0; next = (next + 1) & mask) {
+            // An entry whose home lies cyclically in (hole, next] has to stay
+            const size_t home = m_slots[next].hash & mask;
+            if (hole <= next ? (hole < home && home <= next) : (hole < home || home <= next)) continue;
+            m_slots[hole] = m_slots[next];
+            hole = next;
+        }
+        m_slots[hole] = Slot{0, 0};
+    }
+
+    template <typename... Args>
+    std::pair<size_t, bool> EmplaceKey(const K& key, Args&&... args)
+    {
+        Reserve(m_size + 1);
+        const uint32_t hash = HashBits(m_hash(key));
+        auto found = FindSlot(key, hash);
+        if (found.second) return {m_slots[found.first].entry - 1, false};
+
+        const uint32_t index = AllocateEntry();
+        try {
+            new (Entry(index)) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            FreeEntry(index);
+            throw;
+        }
+        m_chunks[index / CHUNK_ENTRIES]->used |= (uint64_t)1 << (index % CHUNK_ENTRIES);
+        m_slots[found.first] = Slot{hash, index + 1};
+        m_size++;
+        return {index, true};
+    }
+
+    template <bool IsConst>
+    class iter_base
+    {
+        typedef typename std::conditional<IsConst, const nodepoolmap, nodepoolmap>::type map_type;
+        map_type* m_map;
+        size_t m_index;
+
+        friend class nodepoolmap;
+        template <bool> friend class iter_base;
+        iter_base(map_type* map, size_t index) : m_map(map), m_index(index) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename nodepoolmap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<IsConst, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<IsConst, const value_type&, value_type&>::type reference;
+
+        iter_base() : m_map(nullptr), m_index(0) {}
+        template <bool C = IsConst, typename = typename std::enable_if<C>::type>
+        iter_base(const iter_base<false>& it) : m_map(it.m_map), m_index(it.m_index) {}
+
+        reference operator*() const { return *m_map->Entry(m_index); }
+        pointer operator->() const { return m_map->Entry(m_index); }
+        iter_base& operator++() { m_index = m_map->NextUsed(m_index + 1); return *this; }
+        iter_base operator++(int) { iter_base copy(*this); ++(*this); return copy; }
+        bool operator==(const iter_base& other) const { return m_index == other.m_index; }
+        bool operator!=(const iter_base& other) const { return m_index != other.m_index; }
+    };
+
+public:
+    typedef iter_base<false> iterator;
+    typedef iter_base<true> const_iterator;
+
+    nodepoolmap() {}
+    nodepoolmap(const nodepoolmap&) = delete;
+    nodepoolmap& operator=(const nodepoolmap&) = delete;
+    ~nodepoolmap() { clear(); }
+
+    bool empty() const { return m_size == 0; }
+    size_type size() const { return m_size; }
+    //! Number of slots in the table
+    size_t bucket_count() const { return m_slots.size(); }
+    //! Number of chunks allocated for the pool, each holding CHUNK_ENTRIES entries
+    size_t chunk_count() const { return m_chunks.size(); }
+    static constexpr size_t chunk_size() { return sizeof(Chunk); }
+    static constexpr size_t bucket_size() { return sizeof(Slot); }
+
+    iterator begin() { return iterator(this, NextUsed(0)); }
+    iterator end() { return iterator(this, m_chunks.size() * CHUNK_ENTRIES); }
+    const_iterator begin() const { return const_iterator(this, NextUsed(0)); }
+    const_iterator end() const { return const_iterator(this, m_chunks.size() * CHUNK_ENTRIES); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    iterator find(const K& key) { return iterator(this, FindEntry(key)); }
+    const_iterator find(const K& key) const { return const_iterator(this, FindEntry(key)); }
+    size_type count(const K& key) const { return find(key) != end() ? 1 : 0; }
+
+    template <typename KArg, typename... Args>
+    std::pair<iterator, bool> emplace(std::piecewise_construct_t, std::tuple<KArg> key_args, std::tuple<Args...> args)
+    {
+        const K& key = std::get<0>(key_args);
+        auto ret = EmplaceKey(key, std::piecewise_construct, std::move(key_args), std::move(args));
+        return {iterator(this, ret.first), ret.second};
+    }
+
+    template <typename KArg, typename VArg>
+    std::pair<iterator, bool> emplace(KArg&& key, VArg&& value)
+    {
+        auto ret = EmplaceKey(key, std::forward<KArg>(key), std::forward<VArg>(value));
+        return {iterator(this, ret.first), ret.second};
+    }
+
+    T& operator[](const K& key)
+    {
+        return Entry(EmplaceKey(key, std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first)->second;
+    }
+
+    /** Erase the entry at it, returns an iterator to the next entry. */
+    iterator erase(const_iterator it)
+    {
+        const uint32_t index = (uint32_t)it.m_index;
+        value_type* entry = Entry(index);
+        const size_t pos = FindSlot(entry->first, HashBits(m_hash(entry->first))).first;
+        assert(m_slots[pos].entry == index + 1);
+        EraseSlot(pos);
+        entry->~value_type();
+        m_chunks[index / CHUNK_ENTRIES]->used &= ~((uint64_t)1 << (index % CHUNK_ENTRIES));
+        FreeEntry(index);
+        m_size--;
+        return iterator(this, NextUsed(index + 1));
+    }
+
+    size_type erase(const K& key)
+    {
+        const_iterator it = find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Remove all entries and release all memory. */
+    void clear()
+    {
+        for (size_t index = NextUsed(0); index < m_chunks.size() * CHUNK_ENTRIES; index = NextUsed(index + 1)) {
+            Entry(index)->~value_type();
+        }
+        std::vector<std::unique_ptr<Chunk>>().swap(m_chunks);
+        std::vector<Slot>().swap(m_slots);
+        m_size = 0;
+        m_free = NO_ENTRY;
+    }
+};
+
+#endif // BITCOIN_NODEPOOLMAP_H
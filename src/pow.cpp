@@ -40,14 +40,18 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
             return nProofOfWorkLimit;
     }
 
+    // Since nForkOne every block retargets from the recent block times only and
+    // the start of the interval is never used, so don't look it up.
+    if (nHeight >= params.nForkOne)
+        return CalculateNextWorkRequired(pindexLast, pindexLast->GetBlockTime(), nTargetTimespan, nTargetSpacing, params);
+
     // The 1st retarget after genesis
     if (nInterval >= nHeight)
         nInterval = nHeight - 1;
 
     // Go back by nInterval
-    const CBlockIndex* pindexFirst = pindexLast;
-    for (int i = 0; pindexFirst && i < nInterval; i++)
-        pindexFirst = pindexFirst->pprev;
+    const CBlockIndex* pindexFirst = pindexLast->GetAncestor(pindexLast->nHeight - nInterval);
+    assert(pindexFirst);
 
     return CalculateNextWorkRequired(pindexLast, pindexFirst->GetBlockTime(), nTargetTimespan, nTargetSpacing, params);
 }
@@ -63,6 +67,8 @@ unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nF
     int nActualTimespanAvg = 0;
 
     if (nHeight >= params.nForkOne) {
+        // Note that with nInterval reset to 1 only the parent block is sampled
+        // below, the short and medium windows start at time 0.
         nInterval = 1;
 
         int pindexFirstShortTime = 0;
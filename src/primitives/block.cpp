@@ -24,6 +24,22 @@ uint256 CBlockHeader::GetPoWHash(unsigned int profile) const
     return(hash);
 }
 
+void GetPoWHashes(const std::vector<const CBlockHeader*>& headers, unsigned int profile, std::vector<uint256>& hashes)
+{
+    // Like GetPoWHash, this hashes the 80 bytes of header fields starting at nVersion
+    std::vector<unsigned char> input(80 * headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        memcpy(&input[80 * i], &headers[i]->nVersion, 80);
+    }
+    std::vector<unsigned char> output(32 * headers.size());
+    NeoScryptBatch(output.data(), input.data(), headers.size(), profile);
+
+    hashes.resize(headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        memcpy(hashes[i].begin(), &output[32 * i], 32);
+    }
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -10,6 +10,8 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <atomic>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -70,6 +72,10 @@ public:
     }
 };
 
+/** Compute the proof-of-work hashes of several headers that use the same
+ *  NeoScrypt profile at once. hashes is resized to match headers. */
+void GetPoWHashes(const std::vector<const CBlockHeader*>& headers, unsigned int profile, std::vector<uint256>& hashes);
+
 
 class CBlock : public CBlockHeader
 {
@@ -77,8 +83,8 @@ public:
     // network and disk
     std::vector<CTransactionRef> vtx;
 
-    // memory only
-    mutable bool fChecked;
+    // memory only, set by CheckBlock() which may run on several threads
+    mutable std::atomic<bool> fChecked;
 
     CBlock()
     {
@@ -91,6 +97,25 @@ public:
         *(static_cast<CBlockHeader*>(this)) = header;
     }
 
+    CBlock(const CBlock& other) : CBlockHeader(other), vtx(other.vtx), fChecked(other.fChecked.load()) {}
+    CBlock(CBlock&& other) : CBlockHeader(other), vtx(std::move(other.vtx)), fChecked(other.fChecked.load()) {}
+
+    CBlock& operator=(const CBlock& other)
+    {
+        CBlockHeader::operator=(other);
+        vtx = other.vtx;
+        fChecked = other.fChecked.load();
+        return *this;
+    }
+
+    CBlock& operator=(CBlock&& other)
+    {
+        CBlockHeader::operator=(other);
+        vtx = std::move(other.vtx);
+        fChecked = other.fChecked.load();
+        return *this;
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
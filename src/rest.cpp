@@ -8,10 +8,14 @@
 #include <chainparams.h>
 #include <core_io.h>
 #include <httpserver.h>
+#include <index/addrindex.h>
 #include <index/txindex.h>
+#include <key_io.h>
+#include <optional.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <streams.h>
@@ -243,6 +247,12 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RetFormat::JSON: {
+        if (showTxDetails) {
+            WriteJSONStreamReply(req, [&](JSONStreamWriter& writer) {
+                blockToJSONStream(writer, block, tip, pblockindex);
+            });
+            return true;
+        }
         UniValue objBlock = blockToJSON(block, tip, pblockindex, showTxDetails);
         std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -323,11 +333,7 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = MempoolToJSON(::mempool, true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        WriteJSONStreamReply(req, [](JSONStreamWriter& writer) { MempoolToJSONStream(writer, ::mempool); });
         return true;
     }
     default: {
@@ -622,6 +628,128 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+/**
+ * Parse the <count>/<address>[/<after>] part of an address index request,
+ * where <after> is after_size components given by after_format. The
+ * components of <after> are left in after, empty if it was not given.
+ * Returns false after replying with an error.
+ */
+static bool ParseAddrIndexRequest(HTTPRequest* req, const std::string& param, const std::string& uri_name,
+                                  const std::string& after_format, size_t after_size,
+                                  size_t& count, CScript& script, std::vector<std::string>& after)
+{
+    if (!g_addrindex) {
+        return RESTERR(req, HTTP_NOT_FOUND, "Address index is not enabled. Use -addrindex to enable it.");
+    }
+
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    if (path.size() != 2 && path.size() != 2 + after_size) {
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Use /rest/%s/<count>/<address>.json, or /rest/%s/<count>/<address>/%s.json to resume after an entry.",
+                                                        uri_name, uri_name, after_format));
+    }
+
+    int32_t count_in;
+    if (!ParseInt32(path[0], &count_in) || count_in < 1 || count_in > (int32_t)MAX_ADDRINDEX_QUERY_COUNT) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Count out of range: " + SanitizeString(path[0]));
+    }
+    const CTxDestination dest = DecodeDestination(path[1]);
+    if (!IsValidDestination(dest)) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + SanitizeString(path[1]));
+    }
+
+    count = count_in;
+    script = GetScriptForDestination(dest);
+    after.assign(path.begin() + 2, path.end());
+    g_addrindex->BlockUntilSyncedToCurrentChain();
+    return true;
+}
+
+/** Parse a height, position or index component of <after>. Returns false after replying with an error. */
+static bool ParseAddrIndexPosition(HTTPRequest* req, const std::string& str, int32_t& n)
+{
+    if (!ParseInt32(str, &n) || n < 0) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid position: " + SanitizeString(str));
+    }
+    return true;
+}
+
+static bool rest_address_history(HTTPRequest* req, const std::string& str_uri_part)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, str_uri_part);
+    if (rf != RetFormat::JSON) {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+
+    size_t count;
+    CScript script;
+    std::vector<std::string> after_path;
+    if (!ParseAddrIndexRequest(req, param, "addresshistory", "<height>/<position>/<vout|vin>/<index>", 4, count, script, after_path)) return false;
+
+    Optional<AddrIndex::Event> after;
+    if (!after_path.empty()) {
+        int32_t height, tx_pos, index;
+        if (!ParseAddrIndexPosition(req, after_path[0], height) ||
+            !ParseAddrIndexPosition(req, after_path[1], tx_pos) ||
+            !ParseAddrIndexPosition(req, after_path[3], index)) return false;
+        if (after_path[2] != "vout" && after_path[2] != "vin") {
+            return RESTERR(req, HTTP_BAD_REQUEST, "Expected vout or vin: " + SanitizeString(after_path[2]));
+        }
+        after = AddrIndex::Event();
+        after->height = height;
+        after->tx_pos = tx_pos;
+        after->spend = after_path[2] == "vin";
+        after->index = index;
+    }
+
+    std::vector<AddrIndex::Event> events;
+    if (!g_addrindex->FindEvents(script, after ? &*after : nullptr, count, events)) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read address index");
+    }
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, AddrEventsToJSON(events).write() + "\n");
+    return true;
+}
+
+static bool rest_address_unspent(HTTPRequest* req, const std::string& str_uri_part)
+{
+    if (!CheckWarmup(req)) return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, str_uri_part);
+    if (rf != RetFormat::JSON) {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+
+    size_t count;
+    CScript script;
+    std::vector<std::string> after_path;
+    if (!ParseAddrIndexRequest(req, param, "addressunspent", "<height>/<txid>/<vout>", 3, count, script, after_path)) return false;
+
+    Optional<AddrIndex::Unspent> after;
+    if (!after_path.empty()) {
+        int32_t height, n;
+        uint256 txid;
+        if (!ParseAddrIndexPosition(req, after_path[0], height) ||
+            !ParseAddrIndexPosition(req, after_path[2], n)) return false;
+        if (!ParseHashStr(after_path[1], txid)) {
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + SanitizeString(after_path[1]));
+        }
+        after = AddrIndex::Unspent();
+        after->outpoint = COutPoint(txid, n);
+        after->height = height;
+    }
+
+    std::vector<AddrIndex::Unspent> unspent;
+    if (!g_addrindex->FindUnspent(script, after ? &*after : nullptr, count, unspent)) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read address index");
+    }
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, AddrUnspentToJSON(unspent).write() + "\n");
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -635,6 +763,8 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/addresshistory/", rest_address_history},
+      {"/rest/addressunspent/", rest_address_unspent},
 };
 
 void StartREST()
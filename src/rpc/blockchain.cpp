@@ -15,11 +15,15 @@
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <index/addrindex.h>
 #include <index/blockfilterindex.h>
+#include <key_io.h>
+#include <optional.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
@@ -44,6 +48,7 @@
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 #include <condition_variable>
+#include <limits>
 #include <memory>
 #include <mutex>
 
@@ -120,11 +125,9 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+/** Block description with the given "tx" member */
+static UniValue blockToJSONWithTxs(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, UniValue txs)
 {
-    // Serialize passed information without accessing chain state of the active chain!
-    AssertLockNotHeld(cs_main); // For performance reasons
-
     UniValue result(UniValue::VOBJ);
     result.pushKV("hash", blockindex->GetBlockHash().GetHex());
     const CBlockIndex* pnext;
@@ -137,19 +140,7 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
     result.pushKV("version", block.nVersion);
     result.pushKV("versionHex", strprintf("%08x", block.nVersion));
     result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx->GetHash().GetHex());
-    }
-    result.pushKV("tx", txs);
+    result.pushKV("tx", std::move(txs));
     result.pushKV("time", block.GetBlockTime());
     result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
     result.pushKV("nonce", (uint64_t)block.nNonce);
@@ -165,6 +156,42 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
     return result;
 }
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    // Serialize passed information without accessing chain state of the active chain!
+    AssertLockNotHeld(cs_main); // For performance reasons
+
+    UniValue txs(UniValue::VARR);
+    for(const auto& tx : block.vtx)
+    {
+        if(txDetails)
+        {
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
+            txs.push_back(objTx);
+        }
+        else
+            txs.push_back(tx->GetHash().GetHex());
+    }
+    return blockToJSONWithTxs(block, tip, blockindex, std::move(txs));
+}
+
+void blockToJSONStream(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex)
+{
+    AssertLockNotHeld(cs_main);
+
+    // Only one transaction at a time is held as a UniValue.
+    writer.ObjectWithMember(blockToJSONWithTxs(block, tip, blockindex, NullUniValue), "tx", [&] {
+        writer.BeginArray();
+        for (const auto& tx : block.vtx) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
+            writer.Value(objTx);
+        }
+        writer.EndArray();
+    });
+}
+
 static UniValue getblockcount(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getblockcount",
@@ -492,6 +519,43 @@ UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose)
     }
 }
 
+void MempoolToJSONStream(JSONStreamWriter& writer, const CTxMemPool& pool)
+{
+    std::vector<uint256> txids;
+    {
+        LOCK(pool.cs);
+        txids.reserve(pool.mapTx.size());
+        for (const CTxMemPoolEntry& e : pool.mapTx) {
+            txids.push_back(e.GetTx().GetHash());
+        }
+    }
+
+    // The entries are described in batches, so that pool.cs is not held while
+    // the writer waits for its output to be sent. Transactions that left the
+    // pool in the meantime are skipped.
+    std::vector<std::pair<uint256, UniValue>> batch;
+    writer.BeginObject();
+    for (size_t start = 0; start < txids.size(); start += MEMPOOL_JSON_STREAM_BATCH_SIZE) {
+        const size_t end = std::min(txids.size(), start + MEMPOOL_JSON_STREAM_BATCH_SIZE);
+        {
+            LOCK(pool.cs);
+            for (size_t i = start; i < end; ++i) {
+                auto it = pool.mapTx.find(txids[i]);
+                if (it == pool.mapTx.end()) continue;
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(pool, info, *it);
+                batch.emplace_back(txids[i], std::move(info));
+            }
+        }
+        for (const auto& entry : batch) {
+            writer.Key(entry.first.ToString());
+            writer.Value(entry.second);
+        }
+        batch.clear();
+    }
+    writer.EndObject();
+}
+
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getrawmempool",
@@ -522,6 +586,11 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
+    if (fVerbose && request.stream_result) {
+        *request.stream_result = [](JSONStreamWriter& writer) { MempoolToJSONStream(writer, ::mempool); };
+        return NullUniValue;
+    }
+
     return MempoolToJSON(::mempool, fVerbose);
 }
 
@@ -908,6 +977,14 @@ static UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
+    if (verbosity >= 2 && request.stream_result) {
+        auto pblock = std::make_shared<const CBlock>(std::move(block));
+        *request.stream_result = [pblock, tip, pblockindex](JSONStreamWriter& writer) {
+            blockToJSONStream(writer, *pblock, tip, pblockindex);
+        };
+        return NullUniValue;
+    }
+
     return blockToJSON(block, tip, pblockindex, verbosity >= 2);
 }
 
@@ -2253,6 +2330,193 @@ static UniValue getblockfilter(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue AddrEventsToJSON(const std::vector<AddrIndex::Event>& events)
+{
+    UniValue ret(UniValue::VARR);
+    for (const AddrIndex::Event& event : events) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", event.txid.GetHex());
+        entry.pushKV("height", event.height);
+        entry.pushKV("position", (int64_t)event.tx_pos);
+        entry.pushKV("spend", event.spend);
+        entry.pushKV(event.spend ? "vin" : "vout", (int64_t)event.index);
+        entry.pushKV("amount", ValueFromAmount(event.value));
+        if (event.spend) {
+            entry.pushKV("prevout_txid", event.prevout.hash.GetHex());
+            entry.pushKV("prevout_vout", (int64_t)event.prevout.n);
+        }
+        ret.push_back(entry);
+    }
+    return ret;
+}
+
+UniValue AddrUnspentToJSON(const std::vector<AddrIndex::Unspent>& unspent)
+{
+    UniValue ret(UniValue::VARR);
+    for (const AddrIndex::Unspent& coin : unspent) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", coin.outpoint.hash.GetHex());
+        entry.pushKV("vout", (int64_t)coin.outpoint.n);
+        entry.pushKV("height", coin.height);
+        entry.pushKV("amount", ValueFromAmount(coin.value));
+        ret.push_back(entry);
+    }
+    return ret;
+}
+
+/** Parse the address and count arguments of the address index RPCs. */
+static CScript ParseAddrIndexQuery(const JSONRPCRequest& request, size_t& count)
+{
+    if (!g_addrindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index is not enabled. Use -addrindex to enable it.");
+    }
+
+    const CTxDestination dest = DecodeDestination(request.params[0].get_str());
+    if (!IsValidDestination(dest)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    count = 100;
+    if (!request.params[1].isNull()) {
+        const int64_t count_in = request.params[1].get_int64();
+        if (count_in < 1 || count_in > (int64_t)MAX_ADDRINDEX_QUERY_COUNT) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %u", MAX_ADDRINDEX_QUERY_COUNT));
+        }
+        count = count_in;
+    }
+
+    g_addrindex->BlockUntilSyncedToCurrentChain();
+    return GetScriptForDestination(dest);
+}
+
+/** Read a non-negative integer field of the after argument of the address index RPCs. */
+static int64_t ParseAddrIndexPositionField(const UniValue& after, const std::string& key)
+{
+    const UniValue& value = find_value(after, key);
+    if (!value.isNum()) {
+        throw JSONRPCError(RPC_TYPE_ERROR, "Missing " + key);
+    }
+    const int64_t n = value.get_int64();
+    if (n < 0 || n > std::numeric_limits<int32_t>::max()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, key + " out of range");
+    }
+    return n;
+}
+
+static UniValue getaddresshistory(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getaddresshistory",
+                "\nReturns the outputs paying to an address and the inputs spending them, in chain order.\n"
+                "Requires -addrindex. Entries of the same transaction are listed outputs first.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address"},
+                    {"count", RPCArg::Type::NUM, /* default */ "100", strprintf("The number of entries to return, at most %u", MAX_ADDRINDEX_QUERY_COUNT)},
+                    {"after", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "Resume after this entry, the last one of the previous page, as returned",
+                        {
+                            {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The height of the block of the transaction"},
+                            {"position", RPCArg::Type::NUM, RPCArg::Optional::NO, "The position of the transaction in the block"},
+                            {"spend", RPCArg::Type::BOOL, RPCArg::Optional::NO, "Whether the entry is a spend"},
+                            {"vout", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The index of the output, if not a spend"},
+                            {"vin", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "The index of the input, if a spend"},
+                        },
+                        "after"},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"txid\" : \"hash\",           (string) the transaction id\n"
+            "    \"height\" : n,               (numeric) the height of the block of the transaction\n"
+            "    \"position\" : n,             (numeric) the position of the transaction in the block\n"
+            "    \"spend\" : true|false,       (boolean) whether the entry is an input spending from the address\n"
+            "    \"vout\" : n,                 (numeric) the index of the output, if not a spend\n"
+            "    \"vin\" : n,                  (numeric) the index of the input, if a spend\n"
+            "    \"amount\" : x.xxx,           (numeric) the value of the output, or of the output spent, in " + CURRENCY_UNIT + "\n"
+            "    \"prevout_txid\" : \"hash\",   (string) the transaction id of the output spent, if a spend\n"
+            "    \"prevout_vout\" : n,         (numeric) the index of the output spent, if a spend\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddresshistory", "\"71ajTX3giy7Pkt2PsMgKRGk1zWcAUMfqPV\" 100")
+            + HelpExampleCli("getaddresshistory", "\"71ajTX3giy7Pkt2PsMgKRGk1zWcAUMfqPV\" 100 '{\"height\":1000,\"position\":2,\"spend\":false,\"vout\":0}'")
+            + HelpExampleRpc("getaddresshistory", "\"71ajTX3giy7Pkt2PsMgKRGk1zWcAUMfqPV\", 100")
+                },
+            }.Check(request);
+
+    size_t count;
+    const CScript script = ParseAddrIndexQuery(request, count);
+
+    Optional<AddrIndex::Event> after;
+    if (!request.params[2].isNull()) {
+        const UniValue& after_in = request.params[2].get_obj();
+        RPCTypeCheckObj(after_in, {{"spend", UniValueType(UniValue::VBOOL)}});
+        after = AddrIndex::Event();
+        after->spend = find_value(after_in, "spend").get_bool();
+        after->height = ParseAddrIndexPositionField(after_in, "height");
+        after->tx_pos = ParseAddrIndexPositionField(after_in, "position");
+        after->index = ParseAddrIndexPositionField(after_in, after->spend ? "vin" : "vout");
+    }
+
+    std::vector<AddrIndex::Event> events;
+    if (!g_addrindex->FindEvents(script, after ? &*after : nullptr, count, events)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+    }
+    return AddrEventsToJSON(events);
+}
+
+static UniValue getaddressunspent(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getaddressunspent",
+                "\nReturns the unspent outputs paying to an address in the active chain, in chain order.\n"
+                "Requires -addrindex. Outputs spent in the memory pool are included.\n",
+                {
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address"},
+                    {"count", RPCArg::Type::NUM, /* default */ "100", strprintf("The number of outputs to return, at most %u", MAX_ADDRINDEX_QUERY_COUNT)},
+                    {"after", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "Resume after this output, the last one of the previous page, as returned",
+                        {
+                            {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The transaction id"},
+                            {"vout", RPCArg::Type::NUM, RPCArg::Optional::NO, "The index of the output"},
+                            {"height", RPCArg::Type::NUM, RPCArg::Optional::NO, "The height of the block of the transaction"},
+                        },
+                        "after"},
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"txid\" : \"hash\",           (string) the transaction id\n"
+            "    \"vout\" : n,                 (numeric) the index of the output\n"
+            "    \"height\" : n,               (numeric) the height of the block of the transaction\n"
+            "    \"amount\" : x.xxx,           (numeric) the value of the output in " + CURRENCY_UNIT + "\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddressunspent", "\"71ajTX3giy7Pkt2PsMgKRGk1zWcAUMfqPV\" 100")
+            + HelpExampleCli("getaddressunspent", "\"71ajTX3giy7Pkt2PsMgKRGk1zWcAUMfqPV\" 100 '{\"txid\":\"mytxid\",\"vout\":0,\"height\":1000}'")
+            + HelpExampleRpc("getaddressunspent", "\"71ajTX3giy7Pkt2PsMgKRGk1zWcAUMfqPV\", 100")
+                },
+            }.Check(request);
+
+    size_t count;
+    const CScript script = ParseAddrIndexQuery(request, count);
+
+    Optional<AddrIndex::Unspent> after;
+    if (!request.params[2].isNull()) {
+        const UniValue& after_in = request.params[2].get_obj();
+        after = AddrIndex::Unspent();
+        after->outpoint = COutPoint(ParseHashO(after_in, "txid"), ParseAddrIndexPositionField(after_in, "vout"));
+        after->height = ParseAddrIndexPositionField(after_in, "height");
+    }
+
+    std::vector<AddrIndex::Unspent> unspent;
+    if (!g_addrindex->FindUnspent(script, after ? &*after : nullptr, count, unspent)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read address index");
+    }
+    return AddrUnspentToJSON(unspent);
+}
+
 // RPC commands related to sync checkpoints
 // get information of sync-checkpoint (first introduced in ppcoin)
 static UniValue getcheckpoint(const JSONRPCRequest& request)
@@ -2371,6 +2635,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
     { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
+    { "blockchain",         "getaddresshistory",      &getaddresshistory,      {"address", "count", "after"} },
+    { "blockchain",         "getaddressunspent",      &getaddressunspent,      {"address", "count", "after"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
@@ -6,6 +6,7 @@
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
 #include <amount.h>
+#include <index/addrindex.h>
 #include <sync.h>
 
 #include <stdint.h>
@@ -16,10 +17,14 @@ extern RecursiveMutex cs_main;
 class CBlock;
 class CBlockIndex;
 class CTxMemPool;
+class JSONStreamWriter;
 class UniValue;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
 
+/** Number of mempool entries described per lock of the mempool when streaming */
+static constexpr size_t MEMPOOL_JSON_STREAM_BATCH_SIZE = 1000;
+
 /**
  * Get the difficulty of the net wrt to the given block index.
  *
@@ -34,15 +39,27 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false) LOCKS_EXCLUDED(cs_main);
 
+/** Verbose block description written to a JSON stream, one transaction at a time */
+void blockToJSONStream(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
+
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool& pool);
 
 /** Mempool to JSON */
 UniValue MempoolToJSON(const CTxMemPool& pool, bool verbose = false);
 
+/** Verbose mempool contents written to a JSON stream */
+void MempoolToJSONStream(JSONStreamWriter& writer, const CTxMemPool& pool);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex) LOCKS_EXCLUDED(cs_main);
 
+/** Address index history to JSON */
+UniValue AddrEventsToJSON(const std::vector<AddrIndex::Event>& events);
+
+/** Address index unspent outputs to JSON */
+UniValue AddrUnspentToJSON(const std::vector<AddrIndex::Unspent>& unspent);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
@@ -71,6 +71,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendmany", 6 , "conf_target" },
     { "deriveaddresses", 1, "range" },
     { "scantxoutset", 1, "scanobjects" },
+    { "getaddresshistory", 1, "count" },
+    { "getaddresshistory", 2, "after" },
+    { "getaddressunspent", 1, "count" },
+    { "getaddressunspent", 2, "after" },
     { "addmultisigaddress", 0, "nrequired" },
     { "addmultisigaddress", 1, "keys" },
     { "createmultisig", 0, "nrequired" },
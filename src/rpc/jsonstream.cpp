@@ -0,0 +1,127 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+
+#include <httpserver.h>
+#include <rpc/protocol.h>
+#include <util/system.h>
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(Sink sink, size_t chunk_size) : m_sink(std::move(sink)), m_chunk_size(chunk_size)
+{
+    m_buffer.reserve(m_chunk_size);
+}
+
+void JSONStreamWriter::Separate()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (m_first.empty()) return;
+    if (!m_first.back()) m_buffer += ',';
+    m_first.back() = false;
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (m_buffer.size() >= m_chunk_size) Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    m_buffer += '{';
+    m_first.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!m_first.empty() && !m_after_key);
+    m_first.pop_back();
+    m_buffer += '}';
+    MaybeFlush();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    m_buffer += '[';
+    m_first.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!m_first.empty() && !m_after_key);
+    m_first.pop_back();
+    m_buffer += ']';
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!m_after_key);
+    Separate();
+    // A string UniValue writes itself quoted and escaped, as keys are.
+    m_buffer += UniValue(key).write();
+    m_buffer += ':';
+    m_after_key = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    Separate();
+    m_buffer += value.write();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::ObjectWithMember(const UniValue& obj, const std::string& key, const std::function<void()>& write_value)
+{
+    BeginObject();
+    const std::vector<std::string>& keys = obj.getKeys();
+    const std::vector<UniValue>& values = obj.getValues();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        Key(keys[i]);
+        if (keys[i] == key) {
+            write_value();
+        } else {
+            Value(values[i]);
+        }
+    }
+    EndObject();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (m_buffer.empty()) return;
+    m_sink(m_buffer);
+    m_buffer.clear();
+}
+
+void WriteJSONStreamReply(HTTPRequest* req, const std::function<void(JSONStreamWriter&)>& write_json)
+{
+    req->WriteHeader("Content-Type", "application/json");
+    const bool has_body = req->GetRequestMethod() != HTTPRequest::HEAD;
+    req->StartChunkedReply(HTTP_OK);
+    if (!has_body) {
+        // No body is sent in reply to HEAD, so don't build one
+        req->EndChunkedReply();
+        return;
+    }
+    bool connected = true;
+    JSONStreamWriter writer([req, &connected](const std::string& chunk) {
+        if (connected) connected = req->WriteReplyChunk(chunk);
+    });
+    try {
+        write_json(writer);
+        writer.Flush();
+        if (connected) req->WriteReplyChunk("\n");
+    } catch (const std::exception& e) {
+        // The status is sent already, so all that can be done is to cut the reply short.
+        LogPrintf("%s: error writing reply to %s: %s\n", __func__, req->GetURI(), e.what());
+    }
+    req->EndChunkedReply();
+}
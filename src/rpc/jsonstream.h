@@ -0,0 +1,78 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+class HTTPRequest;
+
+/** Size of the parts a JSONStreamWriter hands to its sink */
+static const size_t DEFAULT_JSON_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document in parts, so that a large document need not be built
+ * as a UniValue tree and written into a single string. Small values are still
+ * passed as UniValues. The output is the same as that of UniValue::write()
+ * without indentation.
+ *
+ * Output is collected until it reaches the chunk size, then handed to the
+ * sink. Call Flush() once the document is complete.
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    explicit JSONStreamWriter(Sink sink, size_t chunk_size = DEFAULT_JSON_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Write the key of the next member of the current object. */
+    void Key(const std::string& key);
+
+    /** Write a value, as an array element or after Key(). */
+    void Value(const UniValue& value);
+
+    /**
+     * Write an object with the members of obj, except that the value of the
+     * member named key is written by write_value instead. The value in obj is
+     * only a placeholder keeping the place of the member.
+     */
+    void ObjectWithMember(const UniValue& obj, const std::string& key, const std::function<void()>& write_value);
+
+    /** Hand what is left of the output to the sink. */
+    void Flush();
+
+private:
+    Sink m_sink;
+    const size_t m_chunk_size;
+    std::string m_buffer;
+
+    /// For each open object or array, whether nothing was written in it yet
+    std::vector<bool> m_first;
+    /// Whether a key was written without its value
+    bool m_after_key{false};
+
+    /// Write the comma before a value or key, if one is needed
+    void Separate();
+    /// Hand the output to the sink once it reaches the chunk size
+    void MaybeFlush();
+};
+
+/**
+ * Send a HTTP reply with the JSON document written by write_json, in chunks
+ * as it is written. Writing stops being sent if the client goes away.
+ */
+void WriteJSONStreamReply(HTTPRequest* req, const std::function<void(JSONStreamWriter&)>& write_json);
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
@@ -31,6 +31,7 @@
 #include <versionbitsinfo.h>
 #include <warnings.h>
 
+#include <algorithm>
 #include <memory>
 #include <stdint.h>
 
@@ -99,6 +100,9 @@ static UniValue getnetworkhashps(const JSONRPCRequest& request)
     return GetNetworkHashPS(!request.params[0].isNull() ? request.params[0].get_int() : 120, !request.params[1].isNull() ? request.params[1].get_int() : -1);
 }
 
+/** Maximum number of nonces generateBlocks hashes at once. */
+static const size_t MAX_GENERATE_NONCE_GROUP = 16;
+
 static UniValue generateBlocks(const CScript& coinbase_script, int nGenerate, uint64_t nMaxTries)
 {
     int nHeightEnd = 0;
@@ -124,9 +128,28 @@ static UniValue generateBlocks(const CScript& coinbase_script, int nGenerate, ui
         }
         if (pblock->GetBlockTime() >= Params().GetConsensus().nNeoScryptFork)
             profile = 0x0;
-        while (nMaxTries > 0 && pblock->nNonce < std::numeric_limits<uint32_t>::max() && !CheckProofOfWork(pblock->GetPoWHash(profile), pblock->nBits, Params().GetConsensus()) && !ShutdownRequested()) {
-            ++pblock->nNonce;
-            --nMaxTries;
+        // Try nonces in growing groups so the multi-lane NeoScrypt implementation
+        // can be used, without wasting work when the target is easy to meet.
+        bool found = false;
+        size_t group_size = 1;
+        while (!found && nMaxTries > 0 && pblock->nNonce < std::numeric_limits<uint32_t>::max() && !ShutdownRequested()) {
+            const size_t count = std::min<uint64_t>({group_size, nMaxTries, std::numeric_limits<uint32_t>::max() - pblock->nNonce});
+            std::vector<CBlockHeader> candidates(count, pblock->GetBlockHeader());
+            std::vector<const CBlockHeader*> headers;
+            for (size_t i = 0; i < count; i++) {
+                candidates[i].nNonce = pblock->nNonce + i;
+                headers.push_back(&candidates[i]);
+            }
+            std::vector<uint256> hashes;
+            GetPoWHashes(headers, profile, hashes);
+            for (size_t i = 0; i < count && !found; i++) {
+                found = CheckProofOfWork(hashes[i], pblock->nBits, Params().GetConsensus());
+                if (!found) {
+                    ++pblock->nNonce;
+                    --nMaxTries;
+                }
+            }
+            group_size = std::min(2 * group_size, MAX_GENERATE_NONCE_GROUP);
         }
         if (nMaxTries == 0 || ShutdownRequested()) {
             break;
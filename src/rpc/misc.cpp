@@ -4,6 +4,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <crypto/ripemd160.h>
+#include <index/addrindex.h>
+#include <index/blockfilterindex.h>
+#include <index/txindex.h>
 #include <key_io.h>
 #include <httpserver.h>
 #include <outputtype.h>
@@ -14,6 +17,7 @@
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <util/validation.h>
+#include <validation.h>
 
 #include <stdint.h>
 #include <tuple>
@@ -535,6 +539,62 @@ UniValue logging(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue SummaryToJSON(const IndexSummary& summary, int chain_height)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("synced", summary.synced);
+    ret.pushKV("best_block_height", summary.best_block_height);
+    ret.pushKV("progress", chain_height > 0 ? std::min(1.0, (double)summary.best_block_height / chain_height) : 1.0);
+    ret.pushKV("blocks_per_second", summary.blocks_per_second);
+    return ret;
+}
+
+static UniValue getindexinfo(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getindexinfo",
+                "\nReturns the status of the enabled optional indexes, such as -txindex and -blockfilterindex.\n",
+                {
+                    {"index_name", RPCArg::Type::STR, RPCArg::Optional::OMITTED_NAMED_ARG, "Filter results for an index with a specific name."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"name\" : {                 (json object) The name of the index\n"
+            "    \"synced\" : true|false,     (boolean) Whether the index is synced with the active chain\n"
+            "    \"best_block_height\" : xx,  (numeric) The height of the last block indexed\n"
+            "    \"progress\" : x.xxx,        (numeric) The fraction of the active chain indexed [0..1]\n"
+            "    \"blocks_per_second\" : x.x, (numeric) Blocks indexed per second since the initial sync started\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+            + HelpExampleCli("getindexinfo", "txindex")
+            + HelpExampleRpc("getindexinfo", "txindex")
+                },
+            }.Check(request);
+
+    const std::string index_name = request.params[0].isNull() ? "" : request.params[0].get_str();
+    const int chain_height = WITH_LOCK(cs_main, return ::ChainActive().Height());
+
+    UniValue result(UniValue::VOBJ);
+    auto push_summary = [&](const IndexSummary& summary) {
+        if (index_name.empty() || index_name == summary.name) {
+            result.pushKV(summary.name, SummaryToJSON(summary, chain_height));
+        }
+    };
+    if (g_txindex) {
+        push_summary(g_txindex->GetSummary());
+    }
+    if (g_addrindex) {
+        push_summary(g_addrindex->GetSummary());
+    }
+    ForEachBlockFilterIndex([&](const BlockFilterIndex& index) {
+        push_summary(index.GetSummary());
+    });
+    return result;
+}
+
 static UniValue echo(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -558,6 +618,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
+    { "util",               "getindexinfo",           &getindexinfo,           {"index_name"} },
     { "util",               "validateaddress",        &validateaddress,        {"address"} },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
     { "util",               "deriveaddresses",        &deriveaddresses,        {"descriptor", "range"} },
@@ -6,10 +6,17 @@
 #ifndef BITCOIN_RPC_REQUEST_H
 #define BITCOIN_RPC_REQUEST_H
 
+#include <functional>
+#include <memory>
 #include <string>
 
 #include <univalue.h>
 
+class JSONStreamWriter;
+
+/** Writes the result of a method in parts, see JSONRPCRequest::stream_result */
+typedef std::function<void(JSONStreamWriter&)> RPCStreamWriteFn;
+
 UniValue JSONRPCRequestObj(const std::string& strMethod, const UniValue& params, const UniValue& id);
 UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
@@ -34,6 +41,12 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    /**
+     * Set by the server when the result may be written in parts. A method
+     * with a large result may then store a function writing it here and
+     * return null, after checking the request and reading what it needs.
+     */
+    std::shared_ptr<RPCStreamWriteFn> stream_result;
 
     JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
     void parse(const UniValue& valRequest);
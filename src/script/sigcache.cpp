@@ -5,14 +5,20 @@
 
 #include <script/sigcache.h>
 
+#include <clientversion.h>
+#include <crypto/hmac_sha256.h>
+#include <hash.h>
 #include <pubkey.h>
 #include <random.h>
+#include <streams.h>
 #include <uint256.h>
 #include <util/system.h>
 
 #include <cuckoocache.h>
 #include <boost/thread.hpp>
 
+static const uint64_t SCRIPT_CACHE_DUMP_VERSION = 2;
+
 namespace {
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
@@ -56,6 +62,18 @@ public:
     {
         return setValid.setup_bytes(n);
     }
+
+    bool Dump(const fs::path& path, const uint256& key)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return DumpScriptCache(path, key, nonce, setValid);
+    }
+
+    bool Load(const fs::path& path, const uint256& key)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        return LoadScriptCache(path, key, nonce, setValid);
+    }
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -79,6 +97,161 @@ void InitSignatureCache()
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+bool DumpSignatureCache()
+{
+    uint256 key;
+    if (!GetScriptCacheKey(key, true)) return false;
+    return signatureCache.Dump(GetDataDir() / "sigcache.dat", key);
+}
+
+bool LoadSignatureCache()
+{
+    uint256 key;
+    if (!GetScriptCacheKey(key, false)) return false;
+    return signatureCache.Load(GetDataDir() / "sigcache.dat", key);
+}
+
+bool ReadScriptCacheKey(const fs::path& path, uint256& key, bool create)
+{
+    if (!fs::exists(path)) {
+        if (!create) return false;
+        uint256 new_key;
+        GetStrongRandBytes(new_key.begin(), new_key.size());
+
+        fs::path path_tmp = path;
+        path_tmp += ".new";
+        FILE* file = fsbridge::fopen(path_tmp, "wb");
+        if (!file) {
+            return error("%s: Failed to open file %s", __func__, path_tmp.string());
+        }
+        boost::system::error_code ec;
+#ifndef WIN32
+        // Before the key is written, so that it is never readable by others
+        fs::permissions(path_tmp, fs::owner_read | fs::owner_write, ec);
+#endif
+        const bool written = !ec && fwrite(new_key.begin(), 1, new_key.size(), file) == new_key.size() && FileCommit(file);
+        fclose(file);
+        if (!written || !RenameOver(path_tmp, path)) {
+            fs::remove(path_tmp);
+            return error("%s: Failed to write %s", __func__, path.string());
+        }
+        key = new_key;
+        return true;
+    }
+
+#ifndef WIN32
+    boost::system::error_code ec;
+    const fs::file_status status = fs::status(path, ec);
+    if (ec || (status.permissions() & (fs::group_all | fs::others_all))) {
+        return error("%s: %s must only be readable and writable by its owner, ignoring it", __func__, path.string());
+    }
+#endif
+    FILE* file = fsbridge::fopen(path, "rb");
+    if (!file) {
+        return error("%s: Failed to open file %s", __func__, path.string());
+    }
+    uint256 file_key;
+    const bool read = fread(file_key.begin(), 1, file_key.size(), file) == file_key.size() && fgetc(file) == EOF;
+    fclose(file);
+    if (!read) {
+        return error("%s: %s is not a key file", __func__, path.string());
+    }
+    key = file_key;
+    return true;
+}
+
+bool GetScriptCacheKey(uint256& key, bool create)
+{
+    return ReadScriptCacheKey(GetDataDir() / "sigcache.key", key, create);
+}
+
+/** The HMAC the cache files end with, see DumpScriptCache */
+static uint256 ScriptCacheHMAC(const uint256& key, const CDataStream& data)
+{
+    uint256 mac;
+    CHMAC_SHA256(key.begin(), key.size()).Write((const unsigned char*)data.data(), data.size()).Finalize(mac.begin());
+    return mac;
+}
+
+bool DumpScriptCache(const fs::path& path, const uint256& key, const uint256& nonce, const CuckooCache::cache<uint256, SignatureCacheHasher>& cache)
+{
+    std::vector<uint256> entries;
+    cache.for_each([&entries](const uint256& entry) { entries.push_back(entry); });
+
+    fs::path path_tmp = path;
+    path_tmp += ".new";
+    CAutoFile fileout(fsbridge::fopen(path_tmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        return error("%s: Failed to open file %s", __func__, path_tmp.string());
+    }
+    try {
+        CDataStream data(SER_DISK, CLIENT_VERSION);
+        const uint64_t version = SCRIPT_CACHE_DUMP_VERSION;
+        const int client_version = CLIENT_VERSION;
+        data << version << client_version << nonce << entries;
+        fileout.write(data.data(), data.size());
+        fileout << ScriptCacheHMAC(key, data);
+    } catch (const std::exception& e) {
+        fileout.fclose();
+        fs::remove(path_tmp);
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get())) {
+        fileout.fclose();
+        fs::remove(path_tmp);
+        return error("%s: Failed to flush file %s", __func__, path_tmp.string());
+    }
+    fileout.fclose();
+    if (!RenameOver(path_tmp, path)) {
+        fs::remove(path_tmp);
+        return error("%s: Rename-into-place failed", __func__);
+    }
+    LogPrintf("Dumped %u entries to %s\n", entries.size(), path.filename().string());
+    return true;
+}
+
+bool LoadScriptCache(const fs::path& path, const uint256& key, uint256& nonce, CuckooCache::cache<uint256, SignatureCacheHasher>& cache)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) return false;
+
+    uint256 file_nonce;
+    std::vector<uint256> entries;
+    try {
+        // Authenticate the whole file before looking at any of it
+        const uintmax_t file_size = fs::file_size(path);
+        uint256 mac;
+        if (file_size < mac.size()) {
+            return error("%s: %s is truncated", __func__, path.filename().string());
+        }
+        CDataStream data(SER_DISK, CLIENT_VERSION);
+        data.resize(file_size - mac.size());
+        filein.read(data.data(), data.size());
+        filein >> mac;
+        if (mac != ScriptCacheHMAC(key, data)) {
+            return error("%s: %s failed authentication, ignoring it", __func__, path.filename().string());
+        }
+
+        uint64_t version;
+        int client_version;
+        data >> version >> client_version;
+        if (version != SCRIPT_CACHE_DUMP_VERSION || client_version != CLIENT_VERSION) {
+            LogPrintf("%s: %s was written by another version, ignoring it\n", __func__, path.filename().string());
+            return false;
+        }
+        data >> file_nonce >> entries;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    nonce = file_nonce;
+    for (const uint256& entry : entries) {
+        cache.insert(entry);
+    }
+    LogPrintf("Loaded %u entries from %s\n", entries.size(), path.filename().string());
+    return true;
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
@@ -6,7 +6,10 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include <cuckoocache.h>
+#include <fs.h>
 #include <script/interpreter.h>
+#include <uint256.h>
 
 #include <vector>
 
@@ -16,6 +19,8 @@
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+// Default for -persistsigcache, saving the signature and script execution caches on shutdown
+static const bool DEFAULT_PERSIST_SIGCACHE = true;
 
 class CPubKey;
 
@@ -53,4 +58,33 @@ public:
 
 void InitSignatureCache();
 
+/** Write the signature cache to sigcache.dat in the data directory */
+bool DumpSignatureCache();
+/** Load sigcache.dat into the signature cache, to be called after InitSignatureCache */
+bool LoadSignatureCache();
+
+/**
+ * Read the secret key the cache files are authenticated with from a key file,
+ * which must only be readable and writable by its owner. With create, a
+ * missing key file is created with a new random key.
+ */
+bool ReadScriptCacheKey(const fs::path& path, uint256& key, bool create);
+/** ReadScriptCacheKey for sigcache.key in the data directory */
+bool GetScriptCacheKey(uint256& key, bool create);
+
+/**
+ * Write the entries of a signature or script execution cache, with the nonce
+ * they are salted with, to a file. Entries are only loaded again by the same
+ * client version, and the file is authenticated with an HMAC under key: it
+ * makes the node skip checks, so whoever can write to it must not be able to
+ * forge entries.
+ */
+bool DumpScriptCache(const fs::path& path, const uint256& key, const uint256& nonce, const CuckooCache::cache<uint256, SignatureCacheHasher>& cache);
+/**
+ * Insert the entries of a file written by DumpScriptCache with the same key
+ * into a cache, and replace the nonce with the one they were salted with.
+ * Nothing is changed unless the whole file can be read and authenticated.
+ */
+bool LoadScriptCache(const fs::path& path, const uint256& key, uint256& nonce, CuckooCache::cache<uint256, SignatureCacheHasher>& cache);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
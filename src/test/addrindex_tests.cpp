@@ -0,0 +1,134 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addrindex.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+#include <test/setup_common.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addrindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(addrindex_initial_sync, TestChain100Setup)
+{
+    AddrIndex addrindex(1 << 20, true);
+
+    const CScript coinbase_script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    std::vector<AddrIndex::Event> events;
+    std::vector<AddrIndex::Unspent> unspent;
+
+    // Nothing should be found in the index before it is started.
+    BOOST_CHECK(addrindex.FindEvents(coinbase_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, events));
+    BOOST_CHECK(events.empty());
+
+    addrindex.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!addrindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Every coinbase output of the chain pays to the script and is unspent, in chain order.
+    BOOST_CHECK(addrindex.FindEvents(coinbase_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, events));
+    BOOST_CHECK(addrindex.FindUnspent(coinbase_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, unspent));
+    BOOST_REQUIRE_EQUAL(events.size(), m_coinbase_txns.size());
+    BOOST_REQUIRE_EQUAL(unspent.size(), m_coinbase_txns.size());
+    for (size_t i = 0; i < m_coinbase_txns.size(); i++) {
+        BOOST_CHECK_EQUAL(events[i].txid, m_coinbase_txns[i]->GetHash());
+        BOOST_CHECK_EQUAL(events[i].height, static_cast<int>(i) + 1);
+        BOOST_CHECK(!events[i].spend);
+        BOOST_CHECK_EQUAL(events[i].value, m_coinbase_txns[i]->vout[0].nValue);
+        BOOST_CHECK(unspent[i].outpoint == COutPoint(m_coinbase_txns[i]->GetHash(), 0));
+    }
+
+    // Pages are taken from the same order, resuming after the last entry of the previous page.
+    const std::vector<AddrIndex::Event> all_events = events;
+    const std::vector<AddrIndex::Unspent> all_unspent = unspent;
+    BOOST_CHECK(addrindex.FindEvents(coinbase_script, &all_events[9], 5, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 5U);
+    BOOST_CHECK_EQUAL(events[0].txid, m_coinbase_txns[10]->GetHash());
+    BOOST_CHECK(addrindex.FindUnspent(coinbase_script, &all_unspent.back(), 5, unspent));
+    BOOST_CHECK(unspent.empty());
+    std::vector<AddrIndex::Unspent> unspent_page;
+    BOOST_CHECK(addrindex.FindUnspent(coinbase_script, &all_unspent[9], 5, unspent_page));
+    BOOST_REQUIRE_EQUAL(unspent_page.size(), 5U);
+
+    // Spend the first coinbase output to another script in a new block.
+    CKey other_key;
+    other_key.MakeNewKey(true);
+    const CScript other_script = GetScriptForDestination(PKHash(other_key.GetPubKey()));
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    spend.vout.emplace_back(m_coinbase_txns[0]->vout[0].nValue - CENT, other_script);
+    std::vector<unsigned char> sig;
+    const uint256 sighash = SignatureHash(coinbase_script, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(sighash, sig));
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << sig;
+
+    std::vector<CMutableTransaction> txns{spend};
+    CreateAndProcessBlock(txns, other_script);
+    BOOST_CHECK(addrindex.BlockUntilSyncedToCurrentChain());
+
+    // The spend is the last event of the coinbase script, and its output is no longer unspent.
+    BOOST_CHECK(addrindex.FindEvents(coinbase_script, &all_events.back(), MAX_ADDRINDEX_QUERY_COUNT, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 1U);
+    BOOST_CHECK(events[0].spend);
+    BOOST_CHECK_EQUAL(events[0].txid, spend.GetHash());
+    BOOST_CHECK(events[0].prevout == spend.vin[0].prevout);
+    BOOST_CHECK(addrindex.FindUnspent(coinbase_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, unspent));
+    BOOST_REQUIRE_EQUAL(unspent.size(), m_coinbase_txns.size() - 1);
+    BOOST_CHECK(unspent[0].outpoint == COutPoint(m_coinbase_txns[1]->GetHash(), 0));
+
+    // Spending an output before the point a page resumes after does not move the page.
+    BOOST_CHECK(addrindex.FindUnspent(coinbase_script, &all_unspent[9], 5, unspent));
+    BOOST_REQUIRE_EQUAL(unspent.size(), unspent_page.size());
+    for (size_t i = 0; i < unspent.size(); i++) {
+        BOOST_CHECK(unspent[i].outpoint == unspent_page[i].outpoint);
+    }
+
+    // The other script has the output of the spend and the new coinbase output.
+    BOOST_CHECK(addrindex.FindUnspent(other_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), 2U);
+
+    // Invalidate the block of the spend, and build another block in its place.
+    // The index rewinds the spend: the output is unspent again, and the spend
+    // is gone from the history.
+    {
+        CValidationState state;
+        CBlockIndex* spend_block = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+        BOOST_CHECK(InvalidateBlock(state, Params(), spend_block));
+    }
+    CreateAndProcessBlock({}, other_script);
+    BOOST_CHECK(addrindex.BlockUntilSyncedToCurrentChain());
+
+    BOOST_CHECK(addrindex.FindEvents(coinbase_script, &all_events.back(), MAX_ADDRINDEX_QUERY_COUNT, events));
+    BOOST_CHECK(events.empty());
+    BOOST_CHECK(addrindex.FindUnspent(coinbase_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, unspent));
+    BOOST_REQUIRE_EQUAL(unspent.size(), m_coinbase_txns.size());
+    BOOST_CHECK(unspent[0].outpoint == COutPoint(m_coinbase_txns[0]->GetHash(), 0));
+    BOOST_CHECK_EQUAL(unspent[0].value, m_coinbase_txns[0]->vout[0].nValue);
+
+    // The other script only has the coinbase output of the new block.
+    BOOST_CHECK(addrindex.FindUnspent(other_script, nullptr, MAX_ADDRINDEX_QUERY_COUNT, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), 1U);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    addrindex.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
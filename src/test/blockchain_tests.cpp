@@ -5,6 +5,7 @@
 #include <chain.h>
 #include <rpc/blockchain.h>
 #include <test/setup_common.h>
+#include <validation.h>
 
 /* Equality between doubles is imprecise. Comparison should be done
  * with a small threshold of tolerance, rather than exact equality.
@@ -69,4 +70,32 @@ BOOST_AUTO_TEST_CASE(get_difficulty_for_very_high_target)
     TestDifficulty(0x12345678, 5913134931067755359633408.0);
 }
 
+BOOST_AUTO_TEST_CASE(block_index_arena)
+{
+    BlockManager blockman;
+    LOCK(cs_main);
+
+    // Entries keep their address and hash while the index grows past a chunk
+    std::vector<std::pair<uint256, CBlockIndex*>> entries;
+    for (int i = 0; i < 10000; i++) {
+        const uint256 hash = InsecureRand256();
+        CBlockIndex* pindex = blockman.InsertBlockIndex(hash);
+        BOOST_CHECK(pindex->pprev == nullptr && pindex->nHeight == 0 && pindex->nChainWork == 0);
+        pindex->nHeight = i;
+        entries.emplace_back(hash, pindex);
+    }
+    BOOST_CHECK(blockman.InsertBlockIndex(uint256()) == nullptr);
+    BOOST_CHECK_EQUAL(blockman.m_block_index_arena.size(), entries.size());
+    BOOST_CHECK(blockman.m_block_index_arena.AllocatedBytes() >= entries.size() * sizeof(CBlockIndex));
+    for (const auto& entry : entries) {
+        BOOST_CHECK(blockman.InsertBlockIndex(entry.first) == entry.second);
+        BOOST_CHECK(entry.second->GetBlockHash() == entry.first);
+    }
+    BOOST_CHECK_EQUAL(entries.back().second->nHeight, 9999);
+
+    blockman.Unload();
+    BOOST_CHECK(blockman.m_block_index.empty());
+    BOOST_CHECK_EQUAL(blockman.m_block_index_arena.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
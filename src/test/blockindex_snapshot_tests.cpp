@@ -0,0 +1,99 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <test/setup_common.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockindex_snapshot_tests, BasicTestingSetup)
+
+static CBlockIndex* AddEntry(BlockManager& blockman, CBlockIndex* pprev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    CBlockIndex* pindex = blockman.InsertBlockIndex(InsecureRand256());
+    pindex->pprev = pprev;
+    pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+    pindex->nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+    pindex->nTx = 1 + InsecureRandRange(100);
+    pindex->nFile = InsecureRandRange(10);
+    pindex->nDataPos = InsecureRand32();
+    pindex->nUndoPos = InsecureRand32();
+    pindex->nVersion = InsecureRand32();
+    pindex->hashMerkleRoot = InsecureRand256();
+    pindex->nTime = InsecureRand32();
+    pindex->nBits = InsecureRand32();
+    pindex->nNonce = InsecureRand32();
+    return pindex;
+}
+
+BOOST_AUTO_TEST_CASE(blockindex_snapshot)
+{
+    LOCK(cs_main);
+    CBlockTreeDB blocktree(1 << 20, false, true);
+
+    // A chain with a fork, sorted by height
+    BlockManager source;
+    std::vector<CBlockIndex*> chain;
+    for (int i = 0; i < 1000; i++) {
+        chain.push_back(AddEntry(source, chain.empty() ? nullptr : chain.back()));
+    }
+    CBlockIndex* pfork = chain[500];
+    for (int i = 0; i < 10; i++) pfork = AddEntry(source, pfork);
+    std::vector<const CBlockIndex*> sorted;
+    for (const auto& entry : source.m_block_index) sorted.push_back(entry.second);
+    std::sort(sorted.begin(), sorted.end(), [](const CBlockIndex* pa, const CBlockIndex* pb) { return pa->nHeight < pb->nHeight; });
+
+    BlockManager loaded;
+    auto insert = [&loaded](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return loaded.InsertBlockIndex(hash); };
+    std::vector<CBlockIndex*> vLoaded;
+
+    // Nothing to load before a snapshot is written
+    BOOST_REQUIRE(blocktree.WriteBatchSync({}, 0, sorted));
+    BOOST_CHECK(!blocktree.LoadBlockIndexSnapshot(insert, vLoaded));
+
+    BOOST_REQUIRE(blocktree.WriteBlockIndexSnapshot(sorted));
+    BOOST_REQUIRE(blocktree.LoadBlockIndexSnapshot(insert, vLoaded));
+    BOOST_REQUIRE_EQUAL(vLoaded.size(), sorted.size());
+    BOOST_CHECK_EQUAL(loaded.m_block_index.size(), sorted.size());
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const CBlockIndex* a = sorted[i];
+        const CBlockIndex* b = vLoaded[i];
+        BOOST_CHECK(a->GetBlockHash() == b->GetBlockHash());
+        BOOST_CHECK((a->pprev ? a->pprev->GetBlockHash() : uint256()) == (b->pprev ? b->pprev->GetBlockHash() : uint256()));
+        BOOST_CHECK_EQUAL(a->nHeight, b->nHeight);
+        BOOST_CHECK_EQUAL(a->nStatus, b->nStatus);
+        BOOST_CHECK_EQUAL(a->nTx, b->nTx);
+        BOOST_CHECK_EQUAL(a->nFile, b->nFile);
+        BOOST_CHECK_EQUAL(a->nDataPos, b->nDataPos);
+        BOOST_CHECK_EQUAL(a->nUndoPos, b->nUndoPos);
+        BOOST_CHECK(a->GetBlockHeader().GetHash() == b->GetBlockHeader().GetHash());
+    }
+
+    // Writing to the database makes the snapshot stale
+    loaded.Unload();
+    BOOST_REQUIRE(blocktree.WriteBatchSync({}, 0, {}));
+    BOOST_CHECK(!blocktree.LoadBlockIndexSnapshot(insert, vLoaded));
+
+    // A corrupted snapshot is rejected
+    loaded.Unload();
+    BOOST_REQUIRE(blocktree.WriteBlockIndexSnapshot(sorted));
+    {
+        FILE* file = fsbridge::fopen(GetBlocksDir() / "index.snapshot", "rb+");
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE(fseek(file, 5000, SEEK_SET) == 0);
+        int ch = fgetc(file);
+        BOOST_REQUIRE(fseek(file, 5000, SEEK_SET) == 0);
+        fputc(ch ^ 1, file);
+        fclose(file);
+    }
+    BOOST_CHECK(!blocktree.LoadBlockIndexSnapshot(insert, vLoaded));
+    loaded.Unload();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
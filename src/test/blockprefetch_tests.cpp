@@ -0,0 +1,163 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockprefetch.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <txdb.h>
+#include <test/setup_common.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockprefetch_tests, BasicTestingSetup)
+
+/** Write a few distinct blocks to the first block file and return where they are. */
+static std::vector<std::pair<uint256, FlatFilePos>> WriteBlocks(int count)
+{
+    std::vector<std::pair<uint256, FlatFilePos>> blocks;
+    FlatFilePos pos(0, 0);
+    for (int i = 0; i < count; i++) {
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].scriptSig = CScript() << i << OP_0;
+        coinbase.vout.resize(1);
+        coinbase.vout[0].nValue = 50 * COIN;
+
+        CBlock block;
+        block.nTime = 1269211443 + i;
+        block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+
+        CAutoFile file(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file << block;
+        blocks.emplace_back(block.GetHash(), pos);
+        pos.nPos += ::GetSerializeSize(block, CLIENT_VERSION);
+    }
+    return blocks;
+}
+
+BOOST_AUTO_TEST_CASE(blockprefetch_reads_ahead)
+{
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+    std::vector<std::pair<uint256, FlatFilePos>> blocks = WriteBlocks(4);
+    CCoinsViewDB coinsdb(GetDataDir() / "prefetch_coins", 1 << 20, true, false);
+    CCoinsViewCache view(&coinsdb);
+
+    // Without a worker thread nothing is read ahead
+    CBlockPrefetcher idle;
+    idle.Prefetch(blocks, &coinsdb, consensus_params);
+    BOOST_CHECK(idle.Take(blocks[1].first, view) == nullptr);
+
+    CBlockPrefetcher prefetcher;
+    boost::thread_group threads;
+    threads.create_thread([&prefetcher]() { prefetcher.Thread(DEFAULT_BLOCK_PREFETCH); });
+    prefetcher.SyncWithWorker();
+
+    // Point the third entry at the data of another block, it must not be returned
+    std::vector<std::pair<uint256, FlatFilePos>> request = blocks;
+    request[2].second = blocks[0].second;
+    prefetcher.Prefetch(request, &coinsdb, consensus_params);
+    prefetcher.SyncWithWorker();
+    std::shared_ptr<const CBlock> plast = prefetcher.Take(blocks[3].first, view);
+    BOOST_REQUIRE(plast);
+    BOOST_CHECK(plast->GetHash() == blocks[3].first);
+
+    // The second block is ready too and the mismatching one was dropped. The
+    // first one is left to the caller.
+    std::shared_ptr<const CBlock> psecond = prefetcher.Take(blocks[1].first, view);
+    BOOST_REQUIRE(psecond);
+    BOOST_CHECK(psecond->GetHash() == blocks[1].first);
+    BOOST_CHECK(prefetcher.Take(blocks[1].first, view) == nullptr);
+    BOOST_CHECK(prefetcher.Take(blocks[2].first, view) == nullptr);
+    BOOST_CHECK(prefetcher.Take(blocks[0].first, view) == nullptr);
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(blockprefetch_stages_coins)
+{
+    CCoinsViewDB coinsdb(GetDataDir() / "prefetch_coins", 1 << 20, true, false);
+
+    // Put a coin into the database and build a block that spends it
+    const COutPoint outpoint(InsecureRand256(), 0);
+    const CTxOut txout(7 * COIN, CScript() << OP_TRUE);
+    {
+        CCoinsViewCache writer(&coinsdb);
+        writer.AddCoin(outpoint, Coin(txout, 1, false), false);
+        writer.SetBestBlock(InsecureRand256());
+        BOOST_REQUIRE(writer.Flush());
+    }
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.resize(1);
+    CMutableTransaction spend;
+    spend.vin.emplace_back(outpoint);
+    spend.vout.resize(1);
+    auto pblock = std::make_shared<CBlock>();
+    pblock->vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    pblock->vtx.push_back(MakeTransactionRef(std::move(spend)));
+    const uint256 hash = pblock->GetHash();
+
+    CBlockPrefetcher prefetcher;
+    // Nothing is staged while no worker thread runs
+    prefetcher.FetchCoins(pblock, &coinsdb);
+    {
+        CCoinsViewCache view(&coinsdb);
+        BOOST_CHECK(prefetcher.Take(hash, view) == nullptr);
+    }
+
+    boost::thread_group threads;
+    threads.create_thread([&prefetcher]() { prefetcher.Thread(DEFAULT_BLOCK_PREFETCH); });
+    prefetcher.SyncWithWorker();
+
+    // The staged coin is added to the cache as if it was read there
+    prefetcher.FetchCoins(pblock, &coinsdb);
+    {
+        CCoinsViewCache view(&coinsdb);
+        BOOST_CHECK(prefetcher.Take(hash, view) == pblock);
+        BOOST_CHECK(view.HaveCoinInCache(outpoint));
+        BOOST_CHECK(view.AccessCoin(outpoint).out == txout);
+        BOOST_CHECK_EQUAL(view.GetCacheSize(), 1U);
+        // Taken once only
+        CCoinsViewCache view2(&coinsdb);
+        BOOST_CHECK(prefetcher.Take(hash, view2) == nullptr);
+        BOOST_CHECK(!view2.HaveCoinInCache(outpoint));
+    }
+
+    // An entry that is already cached is left alone
+    prefetcher.FetchCoins(pblock, &coinsdb);
+    {
+        CCoinsViewCache view(&coinsdb);
+        BOOST_CHECK(view.SpendCoin(outpoint));
+        BOOST_CHECK(prefetcher.Take(hash, view) == pblock);
+        BOOST_CHECK(!view.HaveCoinInCache(outpoint));
+        BOOST_CHECK(!view.HaveCoin(outpoint));
+    }
+
+    // Coins staged before the database was written to are dropped
+    prefetcher.FetchCoins(pblock, &coinsdb);
+    {
+        CCoinsViewCache writer(&coinsdb);
+        BOOST_CHECK(writer.SpendCoin(outpoint));
+        writer.SetBestBlock(InsecureRand256());
+        BOOST_REQUIRE(writer.Flush());
+    }
+    {
+        CCoinsViewCache view(&coinsdb);
+        BOOST_CHECK(prefetcher.Take(hash, view) == pblock);
+        BOOST_CHECK(!view.HaveCoinInCache(outpoint));
+        BOOST_CHECK(!view.HaveCoin(outpoint));
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <crypto/hkdf_sha256_32.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/neoscrypt.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -749,4 +750,22 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(neoscrypt_batch)
+{
+    for (unsigned int profile : {0x0, 0x3}) {
+        for (int i = 0; i <= 20; ++i) {
+            unsigned char in[80 * 20];
+            unsigned char out1[32 * 20], out2[32 * 20];
+            for (int j = 0; j < 80 * i; ++j) {
+                in[j] = InsecureRandBits(8);
+            }
+            for (int j = 0; j < i; ++j) {
+                neoscrypt(in + 80 * j, out1 + 32 * j, profile);
+            }
+            NeoScryptBatch(out2, in, i, profile);
+            BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,8 +6,10 @@
 #include <script/sigcache.h>
 #include <test/setup_common.h>
 #include <random.h>
+#include <util/system.h>
 #include <thread>
 #include <deque>
+#include <vector>
 
 /** Test Suite for CuckooCache
  *
@@ -363,4 +365,81 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+/* Test that a dumped cache loads back with its nonce and the entries not
+ * erased, and that a corrupted dump, or one written with another key, is not
+ * loaded at all.
+ */
+BOOST_FIXTURE_TEST_CASE(cuckoocache_dump_load, BasicTestingSetup)
+{
+    SeedInsecureRand(true);
+    const fs::path path = GetDataDir() / "cuckoocache.dat";
+    const fs::path key_path = GetDataDir() / "cuckoocache.key";
+
+    // The key is only created when asked to, and read back the same
+    uint256 key;
+    BOOST_CHECK(!ReadScriptCacheKey(key_path, key, false));
+    BOOST_REQUIRE(ReadScriptCacheKey(key_path, key, true));
+    BOOST_CHECK(!key.IsNull());
+    uint256 key_again;
+    BOOST_REQUIRE(ReadScriptCacheKey(key_path, key_again, false));
+    BOOST_CHECK(key_again == key);
+#ifndef WIN32
+    BOOST_CHECK((fs::status(key_path).permissions() & fs::perms_mask) == (fs::owner_read | fs::owner_write));
+#endif
+
+    std::vector<uint256> hashes;
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    cc.setup_bytes(1 << 20);
+    for (int x = 0; x < 1000; ++x) {
+        hashes.push_back(InsecureRand256());
+        cc.insert(hashes.back());
+    }
+    for (int x = 0; x < 500; ++x) {
+        cc.contains(hashes[x], true);
+    }
+    size_t count = 0;
+    cc.for_each([&count](const uint256&) { ++count; });
+    BOOST_CHECK_EQUAL(count, 500U);
+
+    const uint256 nonce = InsecureRand256();
+    BOOST_REQUIRE(DumpScriptCache(path, key, nonce, cc));
+
+    uint256 loaded_nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> loaded{};
+    loaded.setup_bytes(1 << 20);
+    BOOST_CHECK(!LoadScriptCache(path, InsecureRand256(), loaded_nonce, loaded));
+    BOOST_CHECK(loaded_nonce.IsNull());
+    BOOST_REQUIRE(LoadScriptCache(path, key, loaded_nonce, loaded));
+    BOOST_CHECK(loaded_nonce == nonce);
+    for (int x = 0; x < 1000; ++x) {
+        BOOST_CHECK_EQUAL(loaded.contains(hashes[x], false), x >= 500);
+    }
+
+    // Flip a bit in one of the entries
+    {
+        FILE* file = fsbridge::fopen(path, "rb+");
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE(fseek(file, 1000, SEEK_SET) == 0);
+        int ch = fgetc(file);
+        BOOST_REQUIRE(fseek(file, 1000, SEEK_SET) == 0);
+        fputc(ch ^ 1, file);
+        fclose(file);
+    }
+    uint256 untouched_nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> untouched{};
+    untouched.setup_bytes(1 << 20);
+    BOOST_CHECK(!LoadScriptCache(path, key, untouched_nonce, untouched));
+    BOOST_CHECK(untouched_nonce.IsNull());
+    count = 0;
+    untouched.for_each([&count](const uint256&) { ++count; });
+    BOOST_CHECK_EQUAL(count, 0U);
+
+#ifndef WIN32
+    // A key others can read or write is not used
+    fs::permissions(key_path, fs::owner_read | fs::owner_write | fs::group_read);
+    BOOST_CHECK(!ReadScriptCacheKey(key_path, key_again, false));
+    BOOST_CHECK(!ReadScriptCacheKey(key_path, key_again, true));
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END();
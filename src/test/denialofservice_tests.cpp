@@ -21,12 +21,20 @@
 
 #include <stdint.h>
 
+#ifndef WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 #include <boost/test/unit_test.hpp>
 
 struct CConnmanTest : public CConnman {
     using CConnman::CConnman;
+    using CConnman::InitSocketEvents;
+    using CConnman::SocketHandler;
     void AddNode(CNode& node)
     {
+        RegisterSocketEvents(&node);
         LOCK(cs_vNodes);
         vNodes.push_back(&node);
     }
@@ -38,6 +46,13 @@ struct CConnmanTest : public CConnman {
         }
         vNodes.clear();
     }
+    void StartMessageHandlers()
+    {
+        WITH_LOCK(mutexMsgProc, fMsgProcWake = false);
+        for (int i = 0; i < nMsgHandlerThreads; i++) {
+            threadMessageHandlers.emplace_back(&CConnman::ThreadMessageHandler, this, i);
+        }
+    }
 };
 
 // Tests these internal-to-net_processing.cpp methods:
@@ -45,6 +60,7 @@ extern bool AddOrphanTx(const CTransactionRef& tx, NodeId peer);
 extern void EraseOrphansFor(NodeId peer);
 extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
 extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
+extern void ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set, std::list<CTransactionRef>& removed_txn);
 
 struct COrphanTx {
     CTransactionRef tx;
@@ -447,4 +463,258 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactions.empty());
 }
 
+BOOST_FIXTURE_TEST_CASE(orphan_work_is_bounded, BasicTestingSetup)
+{
+    // Orphans no longer in the orphan pool are dropped from the work set
+    // without being tried, but still count against the bound
+    std::set<uint256> orphan_work_set;
+    while (orphan_work_set.size() < MAX_TX_MESSAGES_ACCEPTED_TOGETHER + 10) {
+        orphan_work_set.insert(InsecureRand256());
+    }
+    const uint256 last = *orphan_work_set.rbegin();
+
+    std::list<CTransactionRef> removed_txn;
+    LOCK2(cs_main, g_cs_orphans);
+    ProcessOrphanTx(nullptr, orphan_work_set, removed_txn);
+    BOOST_CHECK_EQUAL(orphan_work_set.size(), 10U);
+    BOOST_CHECK(orphan_work_set.count(last));
+
+    ProcessOrphanTx(nullptr, orphan_work_set, removed_txn);
+    BOOST_CHECK(orphan_work_set.empty());
+    BOOST_CHECK(removed_txn.empty());
+}
+
+namespace {
+/** Holds up the first peer's handler until the other peers' messages are processed. */
+class SlowPeerMsgProc : public NetEventsInterface
+{
+public:
+    static const int PEERS = 4;
+    static const int MESSAGES = 10;
+
+    std::atomic<bool> fSlowHandled{false};
+    std::atomic<bool> fOthersDone{false};
+    std::atomic<bool> fOverlap{false};
+
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        const NodeId id = pnode->GetId();
+        Enter(id);
+        bool fMoreWork = false;
+        if (id == 0) {
+            if (!fSlowHandled) {
+                WAIT_LOCK(mutex, lock);
+                fOthersDone = cond.wait_for(lock, std::chrono::seconds(10), [this] { return nProcessed == (PEERS - 1) * MESSAGES; });
+                fSlowHandled = true;
+            }
+        } else if (nCount[id] < MESSAGES) {
+            fMoreWork = ++nCount[id] < MESSAGES;
+            WITH_LOCK(mutex, nProcessed++);
+            cond.notify_all();
+        }
+        Leave(id);
+        return fMoreWork;
+    }
+
+    bool SendMessages(CNode* pnode) override
+    {
+        Enter(pnode->GetId());
+        Leave(pnode->GetId());
+        return true;
+    }
+
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override {}
+
+private:
+    Mutex mutex;
+    std::condition_variable cond;
+    int nProcessed GUARDED_BY(mutex) = 0;
+    //! Only touched by the thread handling the peer
+    int nCount[PEERS] = {};
+    std::atomic<bool> fBusy[PEERS] = {};
+
+    void Enter(NodeId id) { if (fBusy[id].exchange(true)) fOverlap = true; }
+    void Leave(NodeId id) { fBusy[id] = false; }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(slow_peer_does_not_stall_others, BasicTestingSetup)
+{
+    SlowPeerMsgProc msgproc;
+    auto connman = MakeUnique<CConnmanTest>(0x1337, 0x1337);
+    CConnman::Options options;
+    options.m_msgproc = &msgproc;
+    options.nMsgHandlerThreads = 2;
+    connman->Init(options);
+    for (NodeId id = 0; id < SlowPeerMsgProc::PEERS; id++) {
+        connman->AddNode(*new CNode(id, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(ip(id + 1), NODE_NONE), 0, 0, CAddress(), "", /*fInboundIn=*/ true));
+    }
+
+    connman->StartMessageHandlers();
+    for (int i = 0; i < 2000 && !msgproc.fSlowHandled; i++) {
+        MilliSleep(10);
+    }
+    connman->Interrupt();
+    connman->Stop();
+
+    // The other peers were handled while the first one was held up, and no
+    // peer was ever handled by two threads at once
+    BOOST_CHECK(msgproc.fSlowHandled);
+    BOOST_CHECK(msgproc.fOthersDone);
+    BOOST_CHECK(!msgproc.fOverlap);
+}
+
+#ifndef WIN32
+namespace {
+class NullMsgProc : public NetEventsInterface
+{
+public:
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override { return false; }
+    bool SendMessages(CNode* pnode) override { return true; }
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override {}
+};
+
+bool HasMessage(CNode& node)
+{
+    LOCK(node.cs_vProcessMsg);
+    return !node.vProcessMsg.empty();
+}
+} // namespace
+
+static void CheckSocketHandler(bool epoll)
+{
+    NullMsgProc msgproc;
+    auto connman = MakeUnique<CConnmanTest>(0x1337, 0x1337);
+    CConnman::Options options;
+    options.m_msgproc = &msgproc;
+    connman->Init(options);
+    if (epoll) BOOST_REQUIRE(connman->InitSocketEvents());
+
+    CNode* nodes[3];
+    int remotes[3];
+    for (NodeId id = 0; id < 3; id++) {
+        int fds[2];
+        BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        nodes[id] = new CNode(id, NODE_NETWORK, 0, fds[0], CAddress(ip(id + 1), NODE_NONE), 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+        remotes[id] = fds[1];
+        connman->AddNode(*nodes[id]);
+    }
+    std::vector<unsigned char> ping;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, ping, 0, CMessageHeader(Params().MessageStart(), NetMsgType::PING, 8), uint64_t(0));
+
+    // Only the peer that sent something has a message
+    BOOST_REQUIRE_EQUAL(write(remotes[1], ping.data(), ping.size()), (ssize_t)ping.size());
+    for (int i = 0; i < 10 && !HasMessage(*nodes[1]); i++) connman->SocketHandler();
+    BOOST_CHECK(HasMessage(*nodes[1]));
+    BOOST_CHECK(!HasMessage(*nodes[0]));
+    BOOST_CHECK(!HasMessage(*nodes[2]));
+
+    // A paused peer is read once it is resumed, without sending anything more
+    nodes[2]->fPauseRecv = true;
+    BOOST_REQUIRE_EQUAL(write(remotes[2], ping.data(), ping.size()), (ssize_t)ping.size());
+    for (int i = 0; i < 3; i++) connman->SocketHandler();
+    BOOST_CHECK(!HasMessage(*nodes[2]));
+    nodes[2]->fPauseRecv = false;
+    for (int i = 0; i < 10 && !HasMessage(*nodes[2]); i++) connman->SocketHandler();
+    BOOST_CHECK(HasMessage(*nodes[2]));
+
+    // A peer closing the connection is disconnected
+    close(remotes[0]);
+    for (int i = 0; i < 10 && !nodes[0]->fDisconnect; i++) connman->SocketHandler();
+    BOOST_CHECK(nodes[0]->fDisconnect);
+
+    connman->Stop();
+    close(remotes[1]);
+    close(remotes[2]);
+}
+
+BOOST_FIXTURE_TEST_CASE(socket_handler_reads_ready_peers, BasicTestingSetup)
+{
+    CheckSocketHandler(/* epoll */ false);
+#ifdef USE_EPOLL
+    CheckSocketHandler(/* epoll */ true);
+#endif
+}
+
+static std::vector<unsigned char> SerializeMessage(const std::string& command, const std::vector<unsigned char>& payload)
+{
+    std::vector<unsigned char> wire;
+    uint256 hash = Hash(payload.begin(), payload.end());
+    CMessageHeader hdr(Params().MessageStart(), command.c_str(), payload.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, wire, 0, hdr};
+    wire.insert(wire.end(), payload.begin(), payload.end());
+    return wire;
+}
+
+BOOST_FIXTURE_TEST_CASE(received_messages_are_recycled, BasicTestingSetup)
+{
+    NullMsgProc msgproc;
+    auto connman = MakeUnique<CConnmanTest>(0x1337, 0x1337);
+    CConnman::Options options;
+    options.m_msgproc = &msgproc;
+    connman->Init(options);
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    CNode* node = new CNode(0, NODE_NETWORK, 0, fds[0], CAddress(ip(1), NODE_NONE), 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+    connman->AddNode(*node);
+
+    // Send a message and take it off the process queue, like ProcessMessages
+    auto receive = [&](const std::string& command, const std::vector<unsigned char>& payload, std::list<CNetMessage>& msgs) {
+        std::vector<unsigned char> wire = SerializeMessage(command, payload);
+        BOOST_REQUIRE_EQUAL(write(fds[1], wire.data(), wire.size()), (ssize_t)wire.size());
+        for (int i = 0; i < 100 && !HasMessage(*node); i++) connman->SocketHandler();
+        LOCK(node->cs_vProcessMsg);
+        BOOST_REQUIRE(!node->vProcessMsg.empty());
+        msgs.splice(msgs.end(), node->vProcessMsg, node->vProcessMsg.begin());
+        node->nProcessQueueSize = 0;
+        node->fPauseRecv = false;
+        const CNetMessage& msg = msgs.back();
+        BOOST_CHECK_EQUAL(msg.hdr.GetCommand(), command);
+        BOOST_CHECK(std::equal(payload.begin(), payload.end(), msg.vRecv.begin()));
+        BOOST_CHECK_EQUAL(msg.vRecv.size(), payload.size());
+        BOOST_CHECK(msg.GetMessageHash() == Hash(payload.begin(), payload.end()));
+    };
+
+    // A processed message is reused for the next one
+    std::list<CNetMessage> msgs;
+    receive(NetMsgType::TX, std::vector<unsigned char>(300, 0x01), msgs);
+    const CNetMessage* recycled = &msgs.front();
+    node->RecycleMessages(msgs);
+    BOOST_CHECK(msgs.empty());
+    receive(NetMsgType::PING, std::vector<unsigned char>(8, 0x02), msgs);
+    BOOST_CHECK(&msgs.front() == recycled);
+
+    // It is charged for the buffer it kept from the larger message, not for the last one
+    BOOST_CHECK(msgs.front().vRecv.capacity() >= 300);
+    const size_t recycled_usage = sizeof(CNetMessage) + msgs.front().hdrbuf.capacity() + msgs.front().vRecv.capacity();
+    node->RecycleMessages(msgs);
+    BOOST_CHECK_EQUAL(WITH_LOCK(node->cs_vRecvMsgPool, return node->nRecvMsgPoolSize), recycled_usage);
+
+    // Messages are kept up to a total size, the others are left to be freed
+    for (int i = 0; i < 3; i++) {
+        msgs.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+        msgs.back().vRecv.reserve(MAX_RECYCLED_MESSAGE_BYTES / 2);
+    }
+    const size_t large_usage = sizeof(CNetMessage) + msgs.back().hdrbuf.capacity() + msgs.back().vRecv.capacity();
+    node->RecycleMessages(msgs);
+    BOOST_CHECK_EQUAL(msgs.size(), 2U);
+    {
+        LOCK(node->cs_vRecvMsgPool);
+        BOOST_CHECK_EQUAL(node->vRecvMsgPool.size(), 2U);
+        BOOST_CHECK_EQUAL(node->nRecvMsgPoolSize, recycled_usage + large_usage);
+    }
+    msgs.clear();
+
+    // Taking a message out of the pool gives back its share of the total
+    receive(NetMsgType::PING, std::vector<unsigned char>(8, 0x04), msgs);
+    BOOST_CHECK_EQUAL(WITH_LOCK(node->cs_vRecvMsgPool, return node->nRecvMsgPoolSize), large_usage);
+
+    connman->Stop();
+    close(fds[1]);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
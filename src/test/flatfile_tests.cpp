@@ -123,4 +123,43 @@ BOOST_AUTO_TEST_CASE(flatfile_flush)
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1);
 }
 
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(flatfile_map)
+{
+    const auto data_dir = GetDataDir();
+    FlatFileSeq seq(data_dir, "a", 100);
+
+    // Nothing to map before the file exists
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, 0)));
+
+    std::vector<unsigned char> data(1500);
+    for (unsigned char& ch : data) ch = InsecureRandBits(8);
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 0)), SER_DISK, CLIENT_VERSION);
+        file.write((const char*)data.data(), 1000);
+    }
+    auto mapped1 = seq.Map(FlatFilePos(0, 0));
+    BOOST_REQUIRE(mapped1);
+    BOOST_CHECK_EQUAL(mapped1->size(), 1000U);
+    BOOST_CHECK(std::equal(data.begin(), data.begin() + 1000, mapped1->data()));
+
+    // Data appended to the file is seen by a new mapping
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 1000)), SER_DISK, CLIENT_VERSION);
+        file.write((const char*)data.data() + 1000, 500);
+    }
+    auto mapped2 = seq.Map(FlatFilePos(0, 0));
+    BOOST_REQUIRE(mapped2);
+    BOOST_CHECK_EQUAL(mapped2->size(), 1500U);
+    BOOST_CHECK(std::equal(data.begin(), data.end(), mapped2->data()));
+    BOOST_CHECK_EQUAL(mapped1->size(), 1000U);
+
+    // The mappings outlive the file
+    fs::remove(seq.FileName(FlatFilePos(0, 0)));
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, 0)));
+    BOOST_CHECK(std::equal(data.begin(), data.begin() + 1000, mapped1->data()));
+    BOOST_CHECK(std::equal(data.begin(), data.end(), mapped2->data()));
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
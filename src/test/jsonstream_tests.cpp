@@ -0,0 +1,86 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.pushKV("a \"quoted\" key", 1);
+    inner.pushKV("b", UniValue(UniValue::VARR));
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("str", "x\ny");
+    expected.pushKV("inner", inner);
+    UniValue arr(UniValue::VARR);
+    arr.push_back(inner);
+    arr.push_back(NullUniValue);
+    arr.push_back(2.5);
+    expected.pushKV("arr", arr);
+    expected.pushKV("last", true);
+
+    std::string out;
+    JSONStreamWriter writer([&out](const std::string& chunk) { out += chunk; });
+    writer.BeginObject();
+    writer.Key("str");
+    writer.Value("x\ny");
+    writer.Key("inner");
+    writer.Value(inner);
+    writer.Key("arr");
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.Key("a \"quoted\" key");
+    writer.Value(1);
+    writer.Key("b");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.EndObject();
+    writer.Value(NullUniValue);
+    writer.Value(2.5);
+    writer.EndArray();
+    writer.Key("last");
+    writer.Value(true);
+    writer.EndObject();
+    BOOST_CHECK(out.empty());
+    writer.Flush();
+    BOOST_CHECK_EQUAL(out, expected.write());
+
+    // A streamed member takes the place of its placeholder.
+    UniValue with_placeholder(expected);
+    with_placeholder.pushKV("arr", NullUniValue);
+    out.clear();
+    JSONStreamWriter member_writer([&out](const std::string& chunk) { out += chunk; });
+    member_writer.ObjectWithMember(with_placeholder, "arr", [&] { member_writer.Value(arr); });
+    member_writer.Flush();
+    BOOST_CHECK_EQUAL(out, expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_chunks)
+{
+    std::vector<std::string> chunks;
+    JSONStreamWriter writer([&chunks](const std::string& chunk) { chunks.push_back(chunk); }, 100);
+    UniValue expected(UniValue::VARR);
+    writer.BeginArray();
+    for (int i = 0; i < 100; i++) {
+        writer.Value(std::string(10, 'a' + i % 26));
+        expected.push_back(std::string(10, 'a' + i % 26));
+    }
+    writer.EndArray();
+    writer.Flush();
+
+    // Output is handed over in parts of about the chunk size.
+    BOOST_CHECK(chunks.size() >= 10);
+    std::string out;
+    for (const std::string& chunk : chunks) {
+        BOOST_CHECK(chunk.size() < 100 + 20);
+        out += chunk;
+    }
+    BOOST_CHECK_EQUAL(out, expected.write());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
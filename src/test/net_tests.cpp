@@ -12,6 +12,7 @@
 #include <streams.h>
 #include <net.h>
 #include <netbase.h>
+#include <netmessagemaker.h>
 #include <chainparams.h>
 #include <util/memory.h>
 #include <util/system.h>
@@ -304,4 +305,30 @@ BOOST_AUTO_TEST_CASE(LocalAddress_BasicLifecycle)
 }
 
 
+BOOST_AUTO_TEST_CASE(push_message_external_payload)
+{
+    CConnman connman(0x1337, 0x1337);
+    CNode node_external(0, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(), 0, 0, CAddress(), "", false);
+    CNode node_copied(1, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(), 1, 1, CAddress(), "", false);
+    auto payload = std::make_shared<const std::vector<unsigned char>>(1000, 0x42);
+
+    connman.PushMessage(&node_external, CNetMsgMaker::MakeExternal(NetMsgType::BLOCK, payload, MakeSpan(*payload)));
+    connman.PushMessage(&node_copied, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::BLOCK, MakeSpan(*payload)));
+
+    // The payload is queued in place, behind the same header as a copied one
+    LOCK2(node_external.cs_vSend, node_copied.cs_vSend);
+    BOOST_REQUIRE_EQUAL(node_external.vSendMsg.size(), 2U);
+    BOOST_REQUIRE_EQUAL(node_copied.vSendMsg.size(), 2U);
+    BOOST_CHECK_EQUAL(node_external.vSendMsg[0].size(), size_t{CMessageHeader::HEADER_SIZE});
+    BOOST_CHECK(std::equal(node_external.vSendMsg[0].data(), node_external.vSendMsg[0].data() + CMessageHeader::HEADER_SIZE, node_copied.vSendMsg[0].data()));
+    BOOST_CHECK(node_external.vSendMsg[1].data() == payload->data());
+    BOOST_CHECK_EQUAL(node_external.vSendMsg[1].size(), payload->size());
+    BOOST_CHECK_EQUAL(node_external.nSendSize, node_copied.nSendSize);
+
+    // The queue holds a reference until the message is sent
+    BOOST_CHECK_EQUAL(payload.use_count(), 2);
+    node_external.vSendMsg.clear();
+    BOOST_CHECK_EQUAL(payload.use_count(), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+// Copyright (c) 2019 The Napocoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <nodepoolmap.h>
+
+#include <test/setup_common.h>
+#include <util/memory.h>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(nodepoolmap_tests, BasicTestingSetup)
+
+namespace {
+//! Puts many keys in the same home slot, so that erasing has to shift entries back
+struct CollidingHasher
+{
+    size_t operator()(uint32_t key) const { return key % 13; }
+};
+
+typedef nodepoolmap<uint32_t, std::unique_ptr<uint64_t>, CollidingHasher> TestMap;
+
+void CheckEqual(const TestMap& map, const std::map<uint32_t, uint64_t>& expected)
+{
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+    size_t count = 0;
+    for (const auto& entry : map) {
+        auto it = expected.find(entry.first);
+        BOOST_REQUIRE(it != expected.end());
+        BOOST_CHECK_EQUAL(*entry.second, it->second);
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, expected.size());
+    for (const auto& entry : expected) {
+        auto it = map.find(entry.first);
+        BOOST_REQUIRE(it != map.end());
+        BOOST_CHECK_EQUAL(*it->second, entry.second);
+    }
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(nodepoolmap_random)
+{
+    TestMap map;
+    std::map<uint32_t, uint64_t> expected;
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_EQUAL(map.count(1), 0U);
+
+    for (int i = 0; i < 20000; i++) {
+        const uint32_t key = InsecureRandRange(1000);
+        const uint64_t value = InsecureRandBits(64);
+        switch (InsecureRandRange(4)) {
+        case 0: {
+            auto ret = map.emplace(key, MakeUnique<uint64_t>(value));
+            BOOST_CHECK_EQUAL(ret.second, expected.emplace(key, value).second);
+            BOOST_CHECK_EQUAL(ret.first->first, key);
+            break;
+        }
+        case 1:
+            map[key] = MakeUnique<uint64_t>(value);
+            expected[key] = value;
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), expected.erase(key));
+            break;
+        case 3: {
+            auto it = map.find(key);
+            BOOST_CHECK_EQUAL(it != map.end(), expected.count(key) == 1);
+            if (it != map.end()) BOOST_CHECK_EQUAL(*it->second, expected[key]);
+            break;
+        }
+        }
+        if (i % 1000 == 0) CheckEqual(map, expected);
+    }
+    CheckEqual(map, expected);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(nodepoolmap_stable_entries)
+{
+    TestMap map;
+    std::map<uint32_t, const std::unique_ptr<uint64_t>*> pointers;
+    std::map<uint32_t, uint64_t> expected;
+    for (uint32_t key = 0; key < 500; key++) {
+        std::unique_ptr<uint64_t>& value = map[key];
+        value = MakeUnique<uint64_t>(key * 3);
+        pointers[key] = &value;
+        expected[key] = key * 3;
+    }
+
+    // Erasing while iterating visits every entry once, and leaves the others in place
+    for (auto it = map.begin(); it != map.end();) {
+        BOOST_CHECK(pointers.count(it->first));
+        if (it->first % 3 == 0) {
+            pointers.erase(it->first);
+            expected.erase(it->first);
+            it = map.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    CheckEqual(map, expected);
+
+    // Growing the table does not move entries
+    const size_t buckets = map.bucket_count();
+    for (uint32_t key = 1000; map.bucket_count() == buckets; key++) {
+        map[key] = MakeUnique<uint64_t>(key * 3);
+    }
+    for (const auto& entry : pointers) {
+        BOOST_CHECK(&map.find(entry.first)->second == entry.second);
+    }
+
+    // Erased entries are reused before the pool grows
+    const size_t chunks = map.chunk_count();
+    const size_t size = map.size();
+    for (uint32_t key = 0; key < 300; key += 3) map.erase(key + 1);
+    for (uint32_t key = 0; map.size() < size; key += 3) map[key] = MakeUnique<uint64_t>(0);
+    BOOST_CHECK_EQUAL(map.chunk_count(), chunks);
+}
+
+BOOST_AUTO_TEST_CASE(nodepoolmap_memusage)
+{
+    // Entries are pooled, so the map uses less memory than std::unordered_map
+    nodepoolmap<uint32_t, std::unique_ptr<uint64_t>> map;
+    std::unordered_map<uint32_t, std::unique_ptr<uint64_t>> umap;
+    for (uint32_t key = 0; key < 10000; key++) {
+        map.emplace(key, nullptr);
+        umap.emplace(key, nullptr);
+    }
+    BOOST_CHECK_EQUAL(map.chunk_count(), (10000 + TestMap::CHUNK_ENTRIES - 1) / TestMap::CHUNK_ENTRIES);
+    BOOST_CHECK(map.size() * 4 <= map.bucket_count() * 3);
+    BOOST_CHECK(memusage::DynamicUsage(map) < memusage::DynamicUsage(umap));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
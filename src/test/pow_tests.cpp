@@ -136,4 +136,59 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* GetNextWorkRequired as it was before it used the skip list, walking pprev back a whole interval */
+static unsigned int GetNextWorkRequiredByWalk(const CBlockIndex* pindexLast, const CBlockHeader* pblock, const Consensus::Params& params)
+{
+    int nHeight = pindexLast->nHeight + 1;
+    if (nHeight == params.nForkOne)
+        return UintToArith256(params.powNeoScryptLimit).GetCompact();
+    int64_t nInterval = params.nPowTargetTimespan / params.nPowTargetSpacing;
+    if (nHeight % nInterval != 0 && nHeight < params.nForkOne)
+        return pindexLast->nBits;
+    if (params.fPowAllowMinDifficultyBlocks && pblock->GetBlockTime() > pindexLast->GetBlockTime() + params.nPowTargetSpacing * 10)
+        return UintToArith256(params.powLimit).GetCompact();
+    if (nInterval >= nHeight)
+        nInterval = nHeight - 1;
+    const CBlockIndex* pindexFirst = pindexLast;
+    for (int i = 0; pindexFirst && i < nInterval; i++)
+        pindexFirst = pindexFirst->pprev;
+    return CalculateNextWorkRequired(pindexLast, pindexFirst->GetBlockTime(), params.nPowTargetTimespan, params.nPowTargetSpacing, params);
+}
+
+static void CheckNextWorkOverChain(const std::string& chain)
+{
+    const auto chainParams = CreateChainParams(chain);
+    const Consensus::Params& params = chainParams->GetConsensus();
+    const int nBlocks = params.nForkOne + 3000;
+
+    std::vector<CBlockIndex> blocks(nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockIndex& block = blocks[i];
+        block.pprev = i ? &blocks[i - 1] : nullptr;
+        block.nHeight = i;
+        // Mostly on-target spacing with some slow and backwards-in-time blocks
+        int64_t nSpacing = InsecureRandRange(4 * params.nPowTargetSpacing);
+        if (InsecureRandRange(100) == 0) nSpacing += 20 * params.nPowTargetSpacing;
+        if (InsecureRandRange(50) == 0) nSpacing = -nSpacing;
+        block.nTime = i ? blocks[i - 1].nTime + nSpacing : 1269211443;
+        if (i == 0) {
+            block.nBits = UintToArith256(params.powLimit).GetCompact();
+        } else {
+            CBlockHeader header;
+            header.nTime = block.nTime;
+            block.nBits = GetNextWorkRequired(block.pprev, &header, params);
+            BOOST_REQUIRE_EQUAL(block.nBits, GetNextWorkRequiredByWalk(block.pprev, &header, params));
+        }
+        block.BuildSkip();
+    }
+}
+
+/* The skip list lookup must give bit-identical targets to walking back block by block, across the fork */
+BOOST_AUTO_TEST_CASE(get_next_work_matches_walk)
+{
+    CheckNextWorkOverChain(CBaseChainParams::MAIN);
+    CheckNextWorkOverChain(CBaseChainParams::TESTNET);
+    CheckNextWorkOverChain(CBaseChainParams::REGTEST);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
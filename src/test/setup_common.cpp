@@ -5,10 +5,12 @@
 #include <test/setup_common.h>
 
 #include <banman.h>
+#include <blockprefetch.h>
 #include <chainparams.h>
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/neoscrypt.h>
 #include <crypto/sha256.h>
 #include <init.h>
 #include <miner.h>
@@ -51,6 +53,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     InitLogging();
     LogInstance().StartLogging();
     SHA256AutoDetect();
+    NeoScryptAutoDetect();
     ECC_Start();
     SetupEnvironment();
     SetupNetworking();
@@ -101,8 +104,12 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
     }
 
     nScriptCheckThreads = 3;
-    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+    for (int i = 0; i < nScriptCheckThreads - 1; i++) {
         threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadHeaderCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadBlockCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadCoinsFetch(i); });
+    }
 
     g_banman = MakeUnique<BanMan>(GetDataDir() / "banlist.dat", nullptr, DEFAULT_MISBEHAVING_BANTIME);
     g_connman = MakeUnique<CConnman>(0x1337, 0x1337); // Deterministic randomness for tests.
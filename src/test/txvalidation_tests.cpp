@@ -4,7 +4,9 @@
 
 #include <validation.h>
 #include <consensus/validation.h>
+#include <key.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <test/setup_common.h>
 
@@ -53,4 +55,67 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK(state.GetReason() == ValidationInvalidReason::CONSENSUS);
 }
 
+/** Spend an output paying to the coinbase key into the given number of outputs, signed with key */
+static CTransactionRef MakeSpend(const CKey& key, const CScript& scriptPubKey, const COutPoint& prevout, CAmount value, int outputs)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(outputs);
+    for (CTxOut& out : tx.vout) {
+        out.nValue = (value - CENT) / outputs;
+        out.scriptPubKey = scriptPubKey;
+    }
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return MakeTransactionRef(tx);
+}
+
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_many, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+
+    const CAmount value = m_coinbase_txns[0]->vout[0].nValue;
+    CTransactionRef parent = MakeSpend(coinbaseKey, scriptPubKey, COutPoint(m_coinbase_txns[0]->GetHash(), 0), value, 3);
+    const CAmount child_value = parent->vout[0].nValue;
+    CTransactionRef child_a = MakeSpend(coinbaseKey, scriptPubKey, COutPoint(parent->GetHash(), 0), child_value, 1);
+    CTransactionRef child_b = MakeSpend(coinbaseKey, scriptPubKey, COutPoint(parent->GetHash(), 1), child_value, 1);
+    CTransactionRef double_spend = MakeSpend(coinbaseKey, scriptPubKey, COutPoint(parent->GetHash(), 0), child_value, 2);
+    CTransactionRef bad_signature = MakeSpend(otherKey, scriptPubKey, COutPoint(parent->GetHash(), 2), child_value, 1);
+    CTransactionRef orphan = MakeSpend(coinbaseKey, scriptPubKey, COutPoint(InsecureRand256(), 0), child_value, 1);
+    CTransactionRef grandchild = MakeSpend(coinbaseKey, scriptPubKey, COutPoint(child_b->GetHash(), 0), child_b->vout[0].nValue, 1);
+
+    std::vector<MempoolAcceptEntry> entries;
+    for (const CTransactionRef& tx : {parent, child_a, child_b, double_spend, bad_signature, orphan, grandchild}) {
+        entries.emplace_back(tx, GetTime());
+    }
+
+    LOCK(cs_main);
+    const unsigned int initialPoolSize = mempool.size();
+    BOOST_CHECK_EQUAL(AcceptToMemoryPoolMany(mempool, entries, nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */), 4U);
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize + 4);
+
+    // The same outcome as one transaction after another
+    for (int i : {0, 1, 2, 6}) {
+        BOOST_CHECK(entries[i].accepted);
+        BOOST_CHECK(entries[i].state.IsValid());
+        BOOST_CHECK(mempool.exists(entries[i].tx->GetHash()));
+    }
+    BOOST_CHECK(!entries[3].accepted);
+    BOOST_CHECK_EQUAL(entries[3].state.GetRejectReason(), "txn-mempool-conflict");
+    BOOST_CHECK(!entries[4].accepted);
+    BOOST_CHECK(entries[4].state.GetReason() == ValidationInvalidReason::CONSENSUS);
+    BOOST_CHECK_EQUAL(entries[4].state.GetRejectReason().find("mandatory-script-verify-flag-failed"), 0U);
+    BOOST_CHECK(!entries[5].accepted);
+    BOOST_CHECK(entries[5].missing_inputs);
+    BOOST_CHECK(entries[5].state.IsValid());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -338,4 +338,72 @@ BOOST_AUTO_TEST_CASE(mempool_locks_reorg)
         rpc_thread.join();
     }
 }
+
+BOOST_AUTO_TEST_CASE(checkblocks_concurrent)
+{
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    uint256 prev_hash = Params().GenesisBlock().GetHash();
+    for (int i = 0; i < 8; i++) {
+        blocks.push_back(GoodBlock(prev_hash));
+        prev_hash = blocks.back()->GetHash();
+    }
+
+    // Give one block a duplicate transaction, which fails CheckBlock
+    auto pbad = std::make_shared<CBlock>(*GoodBlock(prev_hash));
+    pbad->vtx.push_back(pbad->vtx.back());
+    pbad->fChecked = false;
+    blocks.push_back(pbad);
+
+    CheckBlocks(blocks, Params().GetConsensus());
+    for (size_t i = 0; i + 1 < blocks.size(); i++) {
+        BOOST_CHECK(blocks[i]->fChecked);
+    }
+    BOOST_CHECK(!pbad->fChecked);
+
+    // The bad block is still rejected with the full state when processed
+    CValidationState state;
+    BOOST_CHECK(!CheckBlock(*pbad, state, Params().GetConsensus()));
+    BOOST_CHECK(!ProcessNewBlock(Params(), pbad, true, nullptr));
+}
+
+BOOST_AUTO_TEST_CASE(processnewblockheaders_bad_pow)
+{
+    const Consensus::Params& consensus_params = Params().GetConsensus();
+
+    std::vector<CBlockHeader> headers;
+    uint256 prev_hash = Params().GenesisBlock().GetHash();
+    for (int i = 0; i < 10; i++) {
+        headers.push_back(GoodBlock(prev_hash)->GetBlockHeader());
+        prev_hash = headers.back().GetHash();
+    }
+
+    // Break the proof of work of a header in the middle of the batch
+    CBlockHeader& bad_header = headers[5];
+    unsigned int profile = 0x3;
+    if (bad_header.GetBlockTime() >= consensus_params.nNeoScryptFork)
+        profile = 0x0;
+    while (CheckProofOfWork(bad_header.GetPoWHash(profile), bad_header.nBits, consensus_params)) {
+        ++bad_header.nNonce;
+    }
+
+    // The headers before the bad one are still accepted, the bad one is reported
+    CValidationState state;
+    CBlockHeader first_invalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(headers, state, Params(), nullptr, &first_invalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK(first_invalid.GetHash() == bad_header.GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(LookupBlockIndex(headers[4].GetHash()) != nullptr);
+        BOOST_CHECK(LookupBlockIndex(bad_header.GetHash()) == nullptr);
+    }
+
+    // Already known headers are not hashed again and are accepted as before
+    headers.resize(5);
+    CValidationState state_known;
+    const CBlockIndex* pindex = nullptr;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state_known, Params(), &pindex));
+    BOOST_CHECK(pindex != nullptr && pindex->GetBlockHash() == headers[4].GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
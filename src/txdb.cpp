@@ -5,6 +5,9 @@
 
 #include <txdb.h>
 
+#include <chainparams.h>
+#include <clientversion.h>
+#include <hash.h>
 #include <pow.h>
 #include <random.h>
 #include <shutdown.h>
@@ -14,6 +17,7 @@
 #include <util/translation.h>
 
 #include <stdint.h>
+#include <unordered_map>
 
 #include <boost/thread.hpp>
 
@@ -27,6 +31,10 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_INDEX_SNAPSHOT = 'S';
+
+//! Format version of the block index snapshot file
+static const uint32_t INDEX_SNAPSHOT_VERSION = 1;
 
 namespace {
 
@@ -86,6 +94,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
+    ++m_write_seq;
 
     uint256 old_tip = GetBestBlock();
     if (old_tip.IsNull()) {
@@ -136,6 +145,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
+    ++m_write_seq;
     LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return ret;
 }
@@ -146,6 +156,10 @@ size_t CCoinsViewDB::EstimateSize() const
 }
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+    if (!fMemory) {
+        m_snapshot_path = (gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" : GetBlocksDir()) / "index.snapshot";
+        if (fWipe) fs::remove(m_snapshot_path);
+    }
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -230,6 +244,8 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
+    // Any snapshot written before no longer matches the database
+    batch.Write(DB_INDEX_SNAPSHOT, GetRandHash());
     return WriteBatch(batch, true);
 }
 
@@ -288,6 +304,225 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
 
 namespace {
 
+//! Fixed-size entry of the block index snapshot, see CBlockTreeDB::WriteBlockIndexSnapshot
+struct SnapshotEntry
+{
+    static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+    uint256 hash;
+    //! Position of the parent's entry in the snapshot
+    uint32_t nParent;
+    int32_t nHeight;
+    uint32_t nStatus;
+    uint32_t nTx;
+    int32_t nFile;
+    uint32_t nDataPos;
+    uint32_t nUndoPos;
+    int32_t nVersion;
+    uint256 hashMerkleRoot;
+    uint32_t nTime;
+    uint32_t nBits;
+    uint32_t nNonce;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(nParent);
+        READWRITE(nHeight);
+        READWRITE(nStatus);
+        READWRITE(nTx);
+        READWRITE(nFile);
+        READWRITE(nDataPos);
+        READWRITE(nUndoPos);
+        READWRITE(nVersion);
+        READWRITE(hashMerkleRoot);
+        READWRITE(nTime);
+        READWRITE(nBits);
+        READWRITE(nNonce);
+    }
+};
+
+//! Header of the block index snapshot, ties it to the state of the database
+struct SnapshotHeader
+{
+    uint32_t nVersion = INDEX_SNAPSHOT_VERSION;
+    //! Value of DB_INDEX_SNAPSHOT when the snapshot was written
+    uint256 id;
+    //! Last block file and its size, as a second check against the database
+    int32_t nLastFile = 0;
+    uint32_t nLastFileBlocks = 0;
+    uint32_t nLastFileSize = 0;
+    uint32_t nLastFileUndoSize = 0;
+    uint64_t nEntries = 0;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(id);
+        READWRITE(nLastFile);
+        READWRITE(nLastFileBlocks);
+        READWRITE(nLastFileSize);
+        READWRITE(nLastFileUndoSize);
+        READWRITE(nEntries);
+    }
+};
+
+} // namespace
+
+bool CBlockTreeDB::ReadSnapshotState(uint256& id, int& nLastFile, CBlockFileInfo& info)
+{
+    if (!Read(DB_INDEX_SNAPSHOT, id) || !ReadLastBlockFile(nLastFile)) return false;
+    info.SetNull();
+    ReadBlockFileInfo(nLastFile, info);
+    return true;
+}
+
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& sorted)
+{
+    if (m_snapshot_path.empty()) return false;
+
+    SnapshotHeader header;
+    int nLastFile;
+    CBlockFileInfo info;
+    if (!ReadSnapshotState(header.id, nLastFile, info)) return false;
+    header.nLastFile = nLastFile;
+    header.nLastFileBlocks = info.nBlocks;
+    header.nLastFileSize = info.nSize;
+    header.nLastFileUndoSize = info.nUndoSize;
+    header.nEntries = sorted.size();
+
+    fs::path pathTmp = m_snapshot_path;
+    pathTmp += ".new";
+    CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+    }
+    try {
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        fileout << Params().MessageStart() << header;
+        hasher << Params().MessageStart() << header;
+
+        std::unordered_map<const CBlockIndex*, uint32_t> mapPos;
+        mapPos.reserve(sorted.size());
+        for (const CBlockIndex* pindex : sorted) {
+            SnapshotEntry entry;
+            entry.hash = pindex->GetBlockHash();
+            entry.nParent = SnapshotEntry::NO_PARENT;
+            if (pindex->pprev) {
+                // Parents come first, loading relies on that
+                auto it = mapPos.find(pindex->pprev);
+                if (it == mapPos.end()) {
+                    fileout.fclose();
+                    fs::remove(pathTmp);
+                    return error("%s: Block index entries not in height order", __func__);
+                }
+                entry.nParent = it->second;
+            }
+            entry.nHeight = pindex->nHeight;
+            entry.nStatus = pindex->nStatus;
+            entry.nTx = pindex->nTx;
+            entry.nFile = pindex->nFile;
+            entry.nDataPos = pindex->nDataPos;
+            entry.nUndoPos = pindex->nUndoPos;
+            entry.nVersion = pindex->nVersion;
+            entry.hashMerkleRoot = pindex->hashMerkleRoot;
+            entry.nTime = pindex->nTime;
+            entry.nBits = pindex->nBits;
+            entry.nNonce = pindex->nNonce;
+            fileout << entry;
+            hasher << entry;
+            mapPos.emplace(pindex, mapPos.size());
+        }
+        fileout << hasher.GetHash();
+    } catch (const std::exception& e) {
+        fileout.fclose();
+        fs::remove(pathTmp);
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get())) {
+        fileout.fclose();
+        fs::remove(pathTmp);
+        return error("%s: Failed to flush file %s", __func__, pathTmp.string());
+    }
+    fileout.fclose();
+    if (!RenameOver(pathTmp, m_snapshot_path)) {
+        fs::remove(pathTmp);
+        return error("%s: Rename-into-place failed", __func__);
+    }
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockIndexSnapshot(std::function<CBlockIndex*(const uint256&)> insertBlockIndex, std::vector<CBlockIndex*>& sorted)
+{
+    sorted.clear();
+    if (m_snapshot_path.empty()) return false;
+    FILE* file = fsbridge::fopen(m_snapshot_path, "rb");
+    if (!file) return false;
+    CBufferedFile filein(file, 1 << 20, 0, SER_DISK, CLIENT_VERSION);
+
+    uint256 id;
+    int nLastFile;
+    CBlockFileInfo info;
+    if (!ReadSnapshotState(id, nLastFile, info)) return false;
+
+    try {
+        CHashVerifier<CBufferedFile> verifier(&filein);
+        unsigned char pchMsgTmp[4];
+        SnapshotHeader header;
+        verifier >> pchMsgTmp >> header;
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)) || header.nVersion != INDEX_SNAPSHOT_VERSION) {
+            return error("%s: Unknown snapshot format", __func__);
+        }
+        if (header.id != id || header.nLastFile != nLastFile || header.nLastFileBlocks != info.nBlocks ||
+            header.nLastFileSize != info.nSize || header.nLastFileUndoSize != info.nUndoSize) {
+            LogPrintf("%s: Snapshot is older than the block index database, ignoring it\n", __func__);
+            return false;
+        }
+
+        sorted.reserve(header.nEntries);
+        for (uint64_t i = 0; i < header.nEntries; i++) {
+            if (i % 10000 == 0) {
+                boost::this_thread::interruption_point();
+                if (ShutdownRequested()) return false;
+            }
+            SnapshotEntry entry;
+            verifier >> entry;
+            CBlockIndex* pindex = insertBlockIndex(entry.hash);
+            if (entry.nParent != SnapshotEntry::NO_PARENT) {
+                if (entry.nParent >= i) return error("%s: Entry %u has no parent", __func__, i);
+                pindex->pprev = sorted[entry.nParent];
+            }
+            pindex->nHeight        = entry.nHeight;
+            pindex->nStatus        = entry.nStatus;
+            pindex->nTx            = entry.nTx;
+            pindex->nFile          = entry.nFile;
+            pindex->nDataPos       = entry.nDataPos;
+            pindex->nUndoPos       = entry.nUndoPos;
+            pindex->nVersion       = entry.nVersion;
+            pindex->hashMerkleRoot = entry.hashMerkleRoot;
+            pindex->nTime          = entry.nTime;
+            pindex->nBits          = entry.nBits;
+            pindex->nNonce         = entry.nNonce;
+            sorted.push_back(pindex);
+        }
+
+        uint256 hashTmp;
+        filein >> hashTmp;
+        if (hashTmp != verifier.GetHash()) {
+            return error("%s: Checksum mismatch, data corrupted", __func__);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+namespace {
+
 //! Legacy class to deserialize pre-pertxout database entries without reindex.
 class CCoins
 {
@@ -11,6 +11,7 @@
 #include <chain.h>
 #include <primitives/block.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -39,6 +40,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to all block filter index caches combined in MiB.
 static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to address index DB specific cache, if -addrindex (MiB)
+static const int64_t max_addr_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -47,6 +50,8 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Incremented before and after every BatchWrite, so it is odd during one
+    std::atomic<uint64_t> m_write_seq{0};
 public:
     /**
      * @param[in] ldb_path    Location in the filesystem where leveldb data will be stored.
@@ -62,6 +67,11 @@ public:
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
+    /**
+     * Number of writes started and finished. Coins read from other threads
+     * while it was even are still current as long as it has not changed.
+     */
+    uint64_t GetWriteSequence() const { return m_write_seq; }
     size_t EstimateSize() const override;
 };
 
@@ -90,6 +100,12 @@ private:
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
+private:
+    //! Where the block index snapshot is kept, empty for an in-memory database
+    fs::path m_snapshot_path;
+
+    bool ReadSnapshotState(uint256& id, int& nLastFile, CBlockFileInfo& info);
+
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -101,6 +117,19 @@ public:
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Write all block index entries, which must be sorted by height, to a
+     * snapshot file next to the database. The snapshot holds fixed-size
+     * entries with parent links as positions, behind a header that ties it to
+     * the current state of the database and followed by a checksum.
+     */
+    bool WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& sorted);
+    /**
+     * Load the block index from the snapshot, if there is one that matches
+     * the database. The entries are returned in height order. On failure
+     * the entries inserted so far have to be discarded.
+     */
+    bool LoadBlockIndexSnapshot(std::function<CBlockIndex*(const uint256&)> insertBlockIndex, std::vector<CBlockIndex*>& sorted);
     bool ReadSyncCheckpoint(uint256& hashCheckpoint);
     bool WriteSyncCheckpoint(uint256 hashCheckpoint);
     bool ReadCheckpointPubKey(std::string& strPubKey);
@@ -6,6 +6,7 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockprefetch.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkqueue.h>
@@ -47,6 +48,7 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <algorithm>
 #include <future>
 #include <sstream>
 #include <string>
@@ -190,6 +192,19 @@ static FILE* OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 
+/** A block file mapped for serving blocks to peers, and when it was last used */
+struct MappedBlockFile {
+    std::shared_ptr<const MappedFlatFile> file;
+    uint64_t last_use;
+};
+/** Block files mapped for serving blocks to peers, see MapRawBlockFromDisk */
+static Mutex g_mapped_block_files_mutex;
+static std::map<int, MappedBlockFile> g_mapped_block_files GUARDED_BY(g_mapped_block_files_mutex);
+/** Counts the uses of the mapped block files, to tell the least recently used one */
+static uint64_t g_mapped_block_files_uses GUARDED_BY(g_mapped_block_files_mutex){0};
+/** Number of block files to keep mapped */
+static const size_t MAX_MAPPED_BLOCK_FILES = 8;
+
 bool CheckFinalTx(const CTransaction &tx, int flags)
 {
     AssertLockHeld(cs_main);
@@ -429,6 +444,16 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, flags, cacheSigStore, true, txdata);
 }
 
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+/** Transactions with at least this many inputs have their scripts checked on the script check threads when entering the memory pool */
+static const size_t MIN_PARALLEL_MEMPOOL_SCRIPT_CHECKS = 8;
+
+void ThreadScriptCheck(int worker_num) {
+    util::ThreadRename(strprintf("scriptch.%i", worker_num));
+    scriptcheckqueue.Thread();
+}
+
 namespace {
 
 class MemPoolAccept
@@ -464,6 +489,13 @@ public:
     // Single transaction acceptance
     bool AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs& args) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    // Acceptance of transactions none of which spends another, in order. See
+    // AcceptToMemoryPoolMany. Coins of rejected transactions which were not
+    // in the coins cache before are appended to coins_to_uncache.
+    static size_t AcceptTransactions(CTxMemPool& pool, std::vector<MempoolAcceptEntry>::iterator begin, std::vector<MempoolAcceptEntry>::iterator end,
+                                     const CChainParams& chainparams, std::list<CTransactionRef>* replaced_transactions, bool bypass_limits,
+                                     const CAmount& absurd_fee, std::vector<COutPoint>& coins_to_uncache) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs);
+
 private:
     // All the intermediate state that gets passed between the various levels
     // of checking a given transaction.
@@ -922,6 +954,19 @@ bool MemPoolAccept::PolicyScriptChecks(ATMPArgs& args, Workspace& ws, Precompute
 
     // Check against previous transactions
     // This is done last to help prevent CPU exhaustion denial-of-service attacks.
+    //
+    // The inputs of a large transaction are checked on the script check
+    // threads. Only when one of them fails are they checked again one by one
+    // below, to tell how it failed, finding the signatures of the others in
+    // the signature cache.
+    if (nScriptCheckThreads && tx.vin.size() >= MIN_PARALLEL_MEMPOOL_SCRIPT_CHECKS) {
+        std::vector<CScriptCheck> vChecks;
+        CheckInputs(tx, state, m_view, scriptVerifyFlags, true, false, txdata, &vChecks);
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(vChecks);
+        if (control.Wait()) return true;
+    }
+
     if (!CheckInputs(tx, state, m_view, scriptVerifyFlags, true, false, txdata)) {
         // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
         // need to turn both off, and compare against just turning off CLEANSTACK
@@ -1048,6 +1093,127 @@ bool MemPoolAccept::AcceptSingleTransaction(const CTransactionRef& ptx, ATMPArgs
     return true;
 }
 
+size_t MemPoolAccept::AcceptTransactions(CTxMemPool& pool, std::vector<MempoolAcceptEntry>::iterator begin, std::vector<MempoolAcceptEntry>::iterator end,
+                                         const CChainParams& chainparams, std::list<CTransactionRef>* replaced_transactions, bool bypass_limits,
+                                         const CAmount& absurd_fee, std::vector<COutPoint>& coins_to_uncache)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pool.cs);
+
+    // The state of one transaction between the steps, each step is taken for
+    // all of them before the next
+    struct Pending {
+        MempoolAcceptEntry& m_entry;
+        std::vector<COutPoint> m_coins_to_uncache;
+        ATMPArgs m_args;
+        std::unique_ptr<MemPoolAccept> m_accept;
+        std::unique_ptr<Workspace> m_ws;
+        std::unique_ptr<PrecomputedTransactionData> m_txdata;
+        bool m_policy_scripts_checked{false};
+        bool m_scripts_checked{false};
+
+        Pending(CTxMemPool& pool, MempoolAcceptEntry& entry, const CChainParams& chainparams, std::list<CTransactionRef>* replaced_transactions,
+                bool bypass_limits, const CAmount& absurd_fee)
+            : m_entry(entry),
+              m_args{chainparams, entry.state, &entry.missing_inputs, entry.accept_time, replaced_transactions, bypass_limits, absurd_fee, m_coins_to_uncache, false /* test_accept */},
+              m_accept(MakeUnique<MemPoolAccept>(pool)), m_ws(MakeUnique<Workspace>(entry.tx)) {}
+    };
+
+    std::vector<std::unique_ptr<Pending>> pending;
+    for (auto it = begin; it != end; ++it) {
+        pending.push_back(MakeUnique<Pending>(pool, *it, chainparams, replaced_transactions, bypass_limits, absurd_fee));
+    }
+
+    // Bring the coins the run spends from the coins database into the coins
+    // cache in one pass, so that the checks of each transaction below, and
+    // those done again before adding it, find them in memory. As in
+    // PreChecks, coins not cached before are uncached again should their
+    // transaction not be accepted.
+    CCoinsViewCache& coins_cache = ::ChainstateActive().CoinsTip();
+    for (const auto& p : pending) {
+        for (const CTxIn& txin : p->m_entry.tx->vin) {
+            if (pool.exists(txin.prevout.hash) || coins_cache.HaveCoinInCache(txin.prevout)) continue;
+            p->m_coins_to_uncache.push_back(txin.prevout);
+            coins_cache.HaveCoin(txin.prevout);
+        }
+    }
+
+    std::vector<Pending*> to_check;
+    for (const auto& p_ptr : pending) {
+        Pending& p = *p_ptr;
+        if (!p.m_accept->PreChecks(p.m_args, *p.m_ws)) continue;
+
+        p.m_txdata = MakeUnique<PrecomputedTransactionData>(*p.m_entry.tx);
+        to_check.push_back(&p);
+    }
+
+    // Check the policy scripts of the transactions together on the script
+    // check threads. Should some fail, the range is halved until they are
+    // found on their own, so that a bad transaction doesn't cost the others
+    // a check one by one. The failing ones are left to PolicyScriptChecks
+    // below, which tells how they failed.
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (nScriptCheckThreads && !to_check.empty()) ranges.emplace_back(0, to_check.size());
+    while (!ranges.empty()) {
+        const size_t first = ranges.back().first, last = ranges.back().second;
+        ranges.pop_back();
+
+        std::vector<CScriptCheck> vChecks;
+        for (size_t i = first; i < last; ++i) {
+            Pending& p = *to_check[i];
+            CheckInputs(*p.m_entry.tx, p.m_entry.state, p.m_accept->m_view, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, *p.m_txdata, &vChecks);
+        }
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(vChecks);
+        if (control.Wait()) {
+            for (size_t i = first; i < last; ++i) to_check[i]->m_policy_scripts_checked = true;
+        } else if (last - first > 1) {
+            const size_t middle = first + (last - first) / 2;
+            ranges.emplace_back(middle, last);
+            ranges.emplace_back(first, middle);
+        }
+    }
+
+    // The consensus checks compare the coins against the memory pool, so
+    // they have to be done before any transaction is added to it
+    for (const auto& p : pending) {
+        if (!p->m_txdata) continue;
+        if (!p->m_policy_scripts_checked && !p->m_accept->PolicyScriptChecks(p->m_args, *p->m_ws, *p->m_txdata)) continue;
+        if (!p->m_accept->ConsensusScriptChecks(p->m_args, *p->m_ws, *p->m_txdata)) continue;
+        p->m_scripts_checked = true;
+    }
+
+    size_t nAccepted = 0;
+    bool fPoolChanged = false;
+    for (const auto& p : pending) {
+        if (!p->m_scripts_checked) continue;
+        MempoolAcceptEntry& entry = p->m_entry;
+
+        // Adding the transactions before this one may change the outcome of
+        // the other checks (conflicts, ancestors, fees), but not of the
+        // script checks, so only those others are done again
+        if (fPoolChanged) {
+            p->m_accept = MakeUnique<MemPoolAccept>(pool);
+            p->m_ws = MakeUnique<Workspace>(entry.tx);
+            if (!p->m_accept->PreChecks(p->m_args, *p->m_ws)) continue;
+        }
+
+        fPoolChanged = true;
+        if (!p->m_accept->Finalize(p->m_args, *p->m_ws)) continue;
+
+        GetMainSignals().TransactionAddedToMempool(entry.tx);
+        entry.accepted = true;
+        nAccepted++;
+    }
+
+    for (const auto& p : pending) {
+        if (!p->m_entry.accepted) {
+            coins_to_uncache.insert(coins_to_uncache.end(), p->m_coins_to_uncache.begin(), p->m_coins_to_uncache.end());
+        }
+    }
+    return nAccepted;
+}
+
 } // anon namespace
 
 /** (try to) add transaction to memory pool with a specified acceptance time **/
@@ -1081,6 +1247,38 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee, test_accept);
 }
 
+size_t AcceptToMemoryPoolMany(CTxMemPool& pool, std::vector<MempoolAcceptEntry>& entries, std::list<CTransactionRef>* plTxnReplaced,
+                        bool bypass_limits, const CAmount nAbsurdFee)
+{
+    const CChainParams& chainparams = Params();
+    std::vector<COutPoint> coins_to_uncache;
+    size_t nAccepted = 0;
+    {
+        LOCK(pool.cs);
+        auto begin = entries.begin();
+        while (begin != entries.end()) {
+            // Take the transactions up to the first one spending another of
+            // them, which has to wait for that one to be in the memory pool
+            std::set<uint256> txids;
+            auto end = begin;
+            for (; end != entries.end(); ++end) {
+                const std::vector<CTxIn>& vin = end->tx->vin;
+                if (std::any_of(vin.begin(), vin.end(), [&txids](const CTxIn& txin) { return txids.count(txin.prevout.hash); })) break;
+                txids.insert(end->tx->GetHash());
+            }
+            nAccepted += MemPoolAccept::AcceptTransactions(pool, begin, end, chainparams, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache);
+            begin = end;
+        }
+    }
+
+    // As in AcceptToMemoryPoolWithTime
+    for (const COutPoint& hashTx : coins_to_uncache)
+        ::ChainstateActive().CoinsTip().Uncache(hashTx);
+    CValidationState stateDummy;
+    ::ChainstateActive().FlushStateToDisk(chainparams, stateDummy, FlushStateMode::PERIODIC);
+    return nAccepted;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1146,7 +1344,7 @@ static bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos, const CMessa
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
     block.SetNull();
 
@@ -1163,6 +1361,9 @@ bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::P
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
+    if (!fCheckPOW)
+        return true;
+
     unsigned int profile = 0x3;
     if (block.GetBlockTime() >= consensusParams.nNeoScryptFork)
         profile = 0x0;
@@ -1182,7 +1383,11 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
         blockPos = pindex->GetBlockPos();
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    // Every entry in the block index went through CheckBlockHeader before it
+    // was added (AcceptBlockHeader), so its proof of work is already known to
+    // be valid. Matching the header hash below ties the data read from disk to
+    // that entry, which makes re-hashing it with NeoScrypt redundant.
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, false))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
@@ -1236,6 +1441,76 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex
     return ReadRawBlockFromDisk(block, block_pos, message_start, message_start_old);
 }
 
+/** Get a mapping of a block file covering at least min_size bytes. The file
+ *  is mapped again once blocks are appended past the end of its mapping. */
+static std::shared_ptr<const MappedFlatFile> GetMappedBlockFile(int nFile, size_t min_size)
+{
+    LOCK(g_mapped_block_files_mutex);
+    auto it = g_mapped_block_files.find(nFile);
+    if (it != g_mapped_block_files.end() && it->second.file->size() >= min_size) {
+        it->second.last_use = ++g_mapped_block_files_uses;
+        return it->second.file;
+    }
+    std::shared_ptr<const MappedFlatFile> mapped = BlockFileSeq().Map(FlatFilePos(nFile, 0));
+    if (!mapped || mapped->size() < min_size) {
+        return nullptr;
+    }
+    if (it == g_mapped_block_files.end() && g_mapped_block_files.size() >= MAX_MAPPED_BLOCK_FILES) {
+        // Drop the least recently used file, so that the files peers keep
+        // asking for stay mapped
+        auto lru = std::min_element(g_mapped_block_files.begin(), g_mapped_block_files.end(),
+            [](const std::pair<const int, MappedBlockFile>& a, const std::pair<const int, MappedBlockFile>& b) { return a.second.last_use < b.second.last_use; });
+        g_mapped_block_files.erase(lru);
+    }
+    g_mapped_block_files[nFile] = MappedBlockFile{mapped, ++g_mapped_block_files_uses};
+    return mapped;
+}
+
+bool MapRawBlockFromDisk(std::shared_ptr<const MappedFlatFile>& file, Span<const uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start, const CMessageHeader::MessageStartChars& message_start_old)
+{
+    // The block is preceded by an 8 byte meta header, see ReadRawBlockFromDisk
+    if (pos.IsNull() || pos.nPos < 8) {
+        return false;
+    }
+    std::shared_ptr<const MappedFlatFile> mapped = GetMappedBlockFile(pos.nFile, pos.nPos);
+    if (!mapped) {
+        return false;
+    }
+
+    const unsigned char* header = mapped->data() + pos.nPos - 8;
+    if (memcmp(header, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+        if (memcmp(header, message_start_old, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch", __func__);
+        }
+    }
+    const uint32_t blk_size = ReadLE32(header + CMessageHeader::MESSAGE_START_SIZE);
+    if (blk_size > MAX_SIZE) {
+        return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
+                blk_size, MAX_SIZE);
+    }
+    if (mapped->size() - pos.nPos < blk_size) {
+        mapped = GetMappedBlockFile(pos.nFile, (size_t)pos.nPos + blk_size);
+        if (!mapped) {
+            return false;
+        }
+    }
+
+    block = Span<const uint8_t>(mapped->data() + pos.nPos, blk_size);
+    file = std::move(mapped);
+    return true;
+}
+
+bool MapRawBlockFromDisk(std::shared_ptr<const MappedFlatFile>& file, Span<const uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start, const CMessageHeader::MessageStartChars& message_start_old)
+{
+    FlatFilePos block_pos;
+    {
+        LOCK(cs_main);
+        block_pos = pindex->GetBlockPos();
+    }
+
+    return MapRawBlockFromDisk(file, block, block_pos, message_start, message_start_old);
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = (nHeight + 306960) / consensusParams.nSubsidyHalvingInterval;
@@ -1491,6 +1766,22 @@ void InitScriptExecutionCache() {
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+bool DumpScriptExecutionCache()
+{
+    uint256 key;
+    if (!GetScriptCacheKey(key, true)) return false;
+    LOCK(cs_main);
+    return DumpScriptCache(GetDataDir() / "scriptcache.dat", key, scriptExecutionCacheNonce, scriptExecutionCache);
+}
+
+bool LoadScriptExecutionCache()
+{
+    uint256 key;
+    if (!GetScriptCacheKey(key, false)) return false;
+    LOCK(cs_main);
+    return LoadScriptCache(GetDataDir() / "scriptcache.dat", key, scriptExecutionCacheNonce, scriptExecutionCache);
+}
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set.
@@ -1791,11 +2082,11 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CBlockPrefetcher blockprefetcher;
 
-void ThreadScriptCheck(int worker_num) {
-    util::ThreadRename(strprintf("scriptch.%i", worker_num));
-    scriptcheckqueue.Thread();
+void ThreadBlockPrefetch(size_t max_blocks) {
+    util::ThreadRename("blockprefetch");
+    blockprefetcher.Thread(max_blocks);
 }
 
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
@@ -2154,6 +2445,23 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     return true;
 }
 
+void WriteBlockIndexSnapshot()
+{
+    AssertLockHeld(cs_main);
+    int64_t nStart = GetTimeMillis();
+    std::vector<const CBlockIndex*> vSorted;
+    vSorted.reserve(g_blockman.m_block_index.size());
+    for (const BlockMap::value_type& entry : g_blockman.m_block_index) {
+        vSorted.push_back(entry.second);
+    }
+    std::sort(vSorted.begin(), vSorted.end(), [](const CBlockIndex* pa, const CBlockIndex* pb) { return pa->nHeight < pb->nHeight; });
+    if (pblocktree->WriteBlockIndexSnapshot(vSorted)) {
+        LogPrint(BCLog::BENCH, "Wrote block index snapshot of %u entries: %dms\n", vSorted.size(), GetTimeMillis() - nStart);
+    } else {
+        LogPrintf("Failed to write block index snapshot\n");
+    }
+}
+
 bool CChainState::FlushStateToDisk(
     const CChainParams& chainparams,
     CValidationState &state,
@@ -2486,12 +2794,17 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     assert(pindexNew->pprev == m_chain.Tip());
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
+    // Also adds the coins looked up ahead for the block to the cache
+    std::shared_ptr<const CBlock> pprefetched = blockprefetcher.Take(pindexNew->GetBlockHash(), CoinsTip());
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
-            return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
+        pthisBlock = std::move(pprefetched);
+        if (!pthisBlock) {
+            std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
+                return AbortNode(state, "Failed to read block");
+            pthisBlock = pblockNew;
+        }
     } else {
         pthisBlock = pblock;
     }
@@ -2655,6 +2968,17 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        // Read the blocks after the first one ahead while it is connected
+        if (vpindexToConnect.size() > 1) {
+            std::vector<std::pair<uint256, FlatFilePos>> vPrefetch;
+            vPrefetch.reserve(vpindexToConnect.size());
+            for (const CBlockIndex* pindex : reverse_iterate(vpindexToConnect)) {
+                if (pblock && pindex == pindexMostWork) break;
+                vPrefetch.emplace_back(pindex->GetBlockHash(), pindex->GetBlockPos());
+            }
+            blockprefetcher.Prefetch(vPrefetch, &CoinsDB(), chainparams.GetConsensus());
+        }
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -3056,12 +3380,12 @@ CBlockIndex* BlockManager::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = m_block_index_arena.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
-    BlockMap::iterator mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
+    BlockMap::iterator mi = m_block_index.emplace(hash, pindexNew).first;
     pindexNew->phashBlock = &((*mi).first);
     BlockMap::iterator miPrev = m_block_index.find(block.hashPrevBlock);
     if (miPrev != m_block_index.end())
@@ -3212,6 +3536,120 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
     return true;
 }
 
+/** Outcome of the proof-of-work check of one header of a HEADERS batch */
+enum class HeaderPoW : uint8_t {
+    UNCHECKED, //!< Not hashed, because the header is known or the batch check stopped early
+    VALID,
+    INVALID,
+};
+
+/**
+ * Closure representing the context-free proof-of-work check of a group of
+ * block headers that share a NeoScrypt profile. The group is hashed at once
+ * so the multi-lane NeoScrypt implementation can be used. Used to verify a
+ * batch of headers on the header check queue.
+ *
+ * The outcome for each header is stored in its own slot of the batch's
+ * result vector, so that no two checks write the same element.
+ */
+class CHeaderPoWCheck
+{
+private:
+    std::vector<const CBlockHeader*> headers;
+    std::vector<HeaderPoW*> results;
+    unsigned int profile;
+    const Consensus::Params* pconsensusParams;
+
+public:
+    CHeaderPoWCheck() : profile(0), pconsensusParams(nullptr) {}
+    CHeaderPoWCheck(std::vector<const CBlockHeader*>&& headersIn, std::vector<HeaderPoW*>&& resultsIn, unsigned int profileIn, const Consensus::Params& consensusParamsIn) :
+        headers(std::move(headersIn)), results(std::move(resultsIn)), profile(profileIn), pconsensusParams(&consensusParamsIn) {}
+
+    bool operator()()
+    {
+        std::vector<uint256> hashes;
+        GetPoWHashes(headers, profile, hashes);
+        bool fOk = true;
+        for (size_t i = 0; i < headers.size(); i++) {
+            const bool valid = CheckProofOfWork(hashes[i], headers[i]->nBits, *pconsensusParams);
+            *results[i] = valid ? HeaderPoW::VALID : HeaderPoW::INVALID;
+            fOk &= valid;
+        }
+        return fOk;
+    }
+
+    void swap(CHeaderPoWCheck& check)
+    {
+        headers.swap(check.headers);
+        results.swap(check.results);
+        std::swap(profile, check.profile);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
+/** Maximum number of headers hashed together by one CHeaderPoWCheck. */
+static const size_t HEADER_POW_CHECK_GROUP_SIZE = 16;
+
+static CCheckQueue<CHeaderPoWCheck> headercheckqueue(16);
+
+void ThreadHeaderCheck(int worker_num) {
+    util::ThreadRename(strprintf("headerch.%i", worker_num));
+    headercheckqueue.Thread();
+}
+
+/**
+ * Verify the proof of work of every header in a HEADERS batch that is not in
+ * the block index yet, using the header check queue when worker threads are
+ * available. Only cs_main is taken briefly to look the headers up; the
+ * NeoScrypt hashing itself runs without it.
+ *
+ * The outcome for headers[i] is stored in results[i]. Once a header fails,
+ * the remaining groups may be skipped and left UNCHECKED.
+ */
+static void CheckHeadersProofOfWork(const std::vector<CBlockHeader>& headers, std::vector<HeaderPoW>& results, const Consensus::Params& consensusParams) LOCKS_EXCLUDED(cs_main)
+{
+    results.assign(headers.size(), HeaderPoW::UNCHECKED);
+    std::vector<CHeaderPoWCheck> vChecks;
+    {
+        LOCK(cs_main);
+        std::vector<const CBlockHeader*> group;
+        std::vector<HeaderPoW*> group_results;
+        unsigned int group_profile = 0;
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            if (LookupBlockIndex(header.GetHash()) != nullptr)
+                continue;
+
+            unsigned int profile = 0x3;
+            if (header.GetBlockTime() >= consensusParams.nNeoScryptFork)
+                profile = 0x0;
+
+            if (!group.empty() && (profile != group_profile || group.size() == HEADER_POW_CHECK_GROUP_SIZE)) {
+                vChecks.emplace_back(std::move(group), std::move(group_results), group_profile, consensusParams);
+                group.clear();
+                group_results.clear();
+            }
+            group.push_back(&header);
+            group_results.push_back(&results[i]);
+            group_profile = profile;
+        }
+        if (!group.empty()) {
+            vChecks.emplace_back(std::move(group), std::move(group_results), group_profile, consensusParams);
+        }
+    }
+
+    if (!nScriptCheckThreads) {
+        for (CHeaderPoWCheck& check : vChecks) {
+            if (!check()) break;
+        }
+        return;
+    }
+
+    CCheckQueueControl<CHeaderPoWCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
 {
     // These are checks that are independent of context.
@@ -3276,6 +3714,62 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     return true;
 }
 
+/**
+ * Closure representing the context-free CheckBlock() of one block. A block
+ * that fails is not an error here; it is left unchecked and rejected with
+ * the full validation state when it is processed. Used to check several
+ * blocks at once on the block check queue.
+ */
+class CBlockCheck
+{
+private:
+    std::shared_ptr<const CBlock> pblock;
+    const Consensus::Params* pconsensusParams;
+
+public:
+    CBlockCheck() : pconsensusParams(nullptr) {}
+    CBlockCheck(std::shared_ptr<const CBlock> pblockIn, const Consensus::Params& consensusParamsIn) :
+        pblock(std::move(pblockIn)), pconsensusParams(&consensusParamsIn) {}
+
+    bool operator()()
+    {
+        CValidationState state;
+        CheckBlock(*pblock, state, *pconsensusParams);
+        return true;
+    }
+
+    void swap(CBlockCheck& check)
+    {
+        pblock.swap(check.pblock);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
+static CCheckQueue<CBlockCheck> blockcheckqueue(1);
+
+void ThreadBlockCheck(int worker_num) {
+    util::ThreadRename(strprintf("blockch.%i", worker_num));
+    blockcheckqueue.Thread();
+}
+
+void CheckBlocks(const std::vector<std::shared_ptr<const CBlock>>& blocks, const Consensus::Params& consensusParams)
+{
+    std::vector<CBlockCheck> vChecks;
+    for (const std::shared_ptr<const CBlock>& pblock : blocks) {
+        if (!pblock->fChecked) vChecks.emplace_back(pblock, consensusParams);
+    }
+    if (vChecks.empty()) return;
+
+    if (!nScriptCheckThreads || vChecks.size() == 1) {
+        for (CBlockCheck& check : vChecks) check();
+        return;
+    }
+
+    CCheckQueueControl<CBlockCheck> control(&blockcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 bool IsWitnessEnabled(const CBlockIndex* pindexPrev, const Consensus::Params& params)
 {
     int height = pindexPrev == nullptr ? 0 : pindexPrev->nHeight + 1;
@@ -3502,7 +3996,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3520,7 +4014,7 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3585,11 +4079,26 @@ bool BlockManager::AcceptBlockHeader(const CBlockHeader& block, CValidationState
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Hash the whole batch before taking cs_main. The headers preceding a bad
+    // one are still accepted as before, and only a header that was skipped by
+    // the batch check is hashed again under the lock.
+    std::vector<HeaderPoW> pow_results;
+    CheckHeadersProofOfWork(headers, pow_results, chainparams.GetConsensus());
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            if (pow_results[i] == HeaderPoW::INVALID) {
+                // The header was unknown when it was hashed, and a header with
+                // the same hash cannot have been accepted since.
+                state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "high-hash", "proof of work failed");
+                error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, header.GetHash().ToString(), FormatStateMessage(state));
+                if (first_invalid) *first_invalid = header;
+                return false;
+            }
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            bool accepted = g_blockman.AcceptBlockHeader(header, state, chainparams, &pindex);
+            bool accepted = g_blockman.AcceptBlockHeader(header, state, chainparams, &pindex, pow_results[i] != HeaderPoW::VALID);
             ::ChainstateActive().CheckBlockIndex(chainparams.GetConsensus());
 
             if (!accepted) {
@@ -3719,18 +4228,18 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
 {
     AssertLockNotHeld(cs_main);
 
+    CCoinsViewDB* pcoinsdb = nullptr;
     {
         CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
         CValidationState state;
 
-        // CheckBlock() does not support multi-threaded block validation because CBlock::fChecked can cause data race.
-        // Therefore, the following critical section must include the CheckBlock() call as well.
-        LOCK(cs_main);
-
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
-        // belt-and-suspenders.
+        // belt-and-suspenders. It is context-free and CBlock::fChecked is
+        // atomic, so it runs before taking cs_main.
         bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
+
+        LOCK(cs_main);
         if (ret) {
             // Store to disk
             ret = ::ChainstateActive().AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
@@ -3739,6 +4248,14 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED (%s)", __func__, FormatStateMessage(state));
         }
+        if (pindex && pindex->pprev == ::ChainActive().Tip()) {
+            pcoinsdb = &::ChainstateActive().CoinsDB();
+        }
+    }
+
+    // Look up the coins the block spends without cs_main if it is about to be connected
+    if (pcoinsdb) {
+        blockprefetcher.FetchCoins(pblock, pcoinsdb);
     }
 
     NotifyHeaderTip();
@@ -3834,6 +4351,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         FlatFilePos pos(*it, 0);
+        // The disk space is released once blocks in flight to peers are sent
+        WITH_LOCK(g_mapped_block_files_mutex, g_mapped_block_files.erase(*it));
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3981,8 +4500,8 @@ CBlockIndex * BlockManager::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    mi = m_block_index.insert(std::make_pair(hash, pindexNew)).first;
+    CBlockIndex* pindexNew = m_block_index_arena.New();
+    mi = m_block_index.emplace(hash, pindexNew).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
@@ -3993,18 +4512,31 @@ bool BlockManager::LoadBlockIndex(
     CBlockTreeDB& blocktree,
     std::set<CBlockIndex*, CBlockIndexWorkComparator>& block_index_candidates)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
-        return false;
-
-    // Calculate nChainWork
+    auto insert_block_index = [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); };
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(m_block_index.size());
-    for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index)
-    {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+    std::vector<CBlockIndex*> vSnapshot;
+    if (blocktree.LoadBlockIndexSnapshot(insert_block_index, vSnapshot)) {
+        // The snapshot is in height order already
+        LogPrintf("Loaded %u block index entries from snapshot\n", vSnapshot.size());
+        vSortedByHeight.reserve(vSnapshot.size());
+        for (CBlockIndex* pindex : vSnapshot) {
+            vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        }
+    } else {
+        Unload();
+        if (!blocktree.LoadBlockIndexGuts(consensus_params, insert_block_index))
+            return false;
+
+        vSortedByHeight.reserve(m_block_index.size());
+        for (const std::pair<const uint256, CBlockIndex*>& item : m_block_index)
+        {
+            CBlockIndex* pindex = item.second;
+            vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+        }
+        sort(vSortedByHeight.begin(), vSortedByHeight.end());
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // Calculate nChainWork
     for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
     {
         if (ShutdownRequested()) return false;
@@ -4047,11 +4579,8 @@ void BlockManager::Unload() {
     m_failed_blocks.clear();
     m_blocks_unlinked.clear();
 
-    for (const BlockMap::value_type& entry : m_block_index) {
-        delete entry.second;
-    }
-
     m_block_index.clear();
+    m_block_index_arena.Clear();
 }
 
 bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
@@ -4514,6 +5043,7 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
     fHavePruned = false;
+    UnloadSyncCheckpoint();
 
     ::ChainstateActive().UnloadBlockIndex();
 }
@@ -4617,6 +5147,7 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
                 nRewind = blkdat.GetPos();
 
                 uint256 hash = block.GetHash();
+                bool fAccept = false;
                 {
                     LOCK(cs_main);
                     // detect out of order blocks, and store them for later
@@ -4630,19 +5161,28 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
 
                     // process in case the block isn't known yet
                     CBlockIndex* pindex = LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      CValidationState state;
-                      if (::ChainstateActive().AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+                    fAccept = !pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0;
+                    if (!fAccept && hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
                       LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
                     }
                 }
 
+                if (fAccept) {
+                    // The context-free checks don't need cs_main, AcceptBlock
+                    // reuses their result through CBlock::fChecked
+                    CValidationState dummy;
+                    CheckBlock(block, dummy, chainparams.GetConsensus());
+
+                    LOCK(cs_main);
+                    CValidationState state;
+                    if (::ChainstateActive().AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
+                        nLoaded++;
+                    }
+                    if (state.IsError()) {
+                        break;
+                    }
+                }
+
                 // Activate the genesis block so normal node progress can continue
                 if (hash == chainparams.GetConsensus().hashGenesisBlock) {
                     CValidationState state;
@@ -4660,23 +5200,35 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, FlatFi
                     uint256 head = queue.front();
                     queue.pop_front();
                     std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+
+                    // Read all children first so they can be checked concurrently
+                    std::vector<std::pair<std::shared_ptr<CBlock>, FlatFilePos>> children;
+                    std::vector<std::shared_ptr<const CBlock>> vCheck;
                     while (range.first != range.second) {
                         std::multimap<uint256, FlatFilePos>::iterator it = range.first;
                         std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus())) {
+                            children.emplace_back(pblockrecursive, it->second);
+                            vCheck.push_back(pblockrecursive);
+                        }
+                        range.first++;
+                        mapBlocksUnknownParent.erase(it);
+                    }
+                    CheckBlocks(vCheck, chainparams.GetConsensus());
+
+                    for (auto& child : children) {
+                        std::shared_ptr<CBlock>& pblockrecursive = child.first;
+                        LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                                head.ToString());
                         {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
                             LOCK(cs_main);
                             CValidationState dummy;
-                            if (::ChainstateActive().AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                            if (::ChainstateActive().AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &child.second, nullptr))
                             {
                                 nLoaded++;
                                 queue.push_back(pblockrecursive->GetHash());
                             }
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
                         NotifyHeaderTip();
                     }
                 }
@@ -4908,9 +5460,11 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+/** Number of transactions LoadMempool adds at a time */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 100;
+
 bool LoadMempool(CTxMemPool& pool)
 {
-    const CChainParams& chainparams = Params();
     int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
     FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
     CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
@@ -4925,6 +5479,30 @@ bool LoadMempool(CTxMemPool& pool)
     int64_t already_there = 0;
     int64_t nNow = GetTime();
 
+    // Transactions are added a batch at a time, with their scripts checked together
+    std::vector<MempoolAcceptEntry> batch;
+    auto accept_batch = [&] {
+        if (batch.empty()) return;
+        LOCK(cs_main);
+        AcceptToMemoryPoolMany(pool, batch, nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */);
+        for (const MempoolAcceptEntry& entry : batch) {
+            if (entry.state.IsValid()) {
+                ++count;
+            } else {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (pool.exists(entry.tx->GetHash())) {
+                    ++already_there;
+                } else {
+                    ++failed;
+                }
+            }
+        }
+        batch.clear();
+    };
+
     try {
         uint64_t version;
         file >> version;
@@ -4945,31 +5523,16 @@ bool LoadMempool(CTxMemPool& pool)
             if (amountdelta) {
                 pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
-            CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nullptr /* pfMissingInputs */, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
-                                           false /* test_accept */);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
-                }
+                batch.emplace_back(std::move(tx), nTime);
+                if (batch.size() == MEMPOOL_LOAD_BATCH_SIZE) accept_batch();
             } else {
                 ++expired;
             }
             if (ShutdownRequested())
                 return false;
         }
+        accept_batch();
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
 
@@ -4978,6 +5541,7 @@ bool LoadMempool(CTxMemPool& pool)
         }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        accept_batch();
         return false;
     }
 
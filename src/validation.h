@@ -12,11 +12,14 @@
 
 #include <amount.h>
 #include <coins.h>
+#include <consensus/validation.h>
 #include <crypto/common.h> // for ReadLE64
 #include <fs.h>
+#include <nodepoolmap.h>
 #include <policy/feerate.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <script/script_error.h>
+#include <span.h>
 #include <sync.h>
 #include <txmempool.h> // For CTxMemPool::cs
 #include <txdb.h>
@@ -42,7 +45,6 @@ class CConnman;
 class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
-class CValidationState;
 struct ChainTxData;
 
 struct DisconnectedBlockTransactions;
@@ -142,7 +144,7 @@ extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
-typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+typedef nodepoolmap<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
 extern uint256 g_best_block;
@@ -242,8 +244,20 @@ bool LoadGenesisBlock(const CChainParams& chainparams);
 bool LoadBlockIndex(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 /** Unload database information */
 void UnloadBlockIndex();
+/**
+ * Write a snapshot of the whole block index, so that the next start can skip
+ * the database scan. This sorts and writes every entry with cs_main held, so
+ * it is only done at shutdown, after the last flush of the block index.
+ */
+void WriteBlockIndexSnapshot() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadHeaderCheck(int worker_num);
+/** Run an instance of the context-free block checking thread */
+void ThreadBlockCheck(int worker_num);
+/** Run the thread that reads blocks ahead while connecting, see CBlockPrefetcher */
+void ThreadBlockPrefetch(size_t max_blocks);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr);
 /**
@@ -280,6 +294,25 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/** A transaction for AcceptToMemoryPoolMany, and what became of it */
+struct MempoolAcceptEntry {
+    CTransactionRef tx;
+    int64_t accept_time;
+    CValidationState state;
+    bool missing_inputs{false};
+    bool accepted{false};
+
+    MempoolAcceptEntry(CTransactionRef txIn, int64_t accept_timeIn) : tx(std::move(txIn)), accept_time(accept_timeIn) {}
+};
+
+/** (try to) add many transactions to memory pool, with the same outcome as
+ * AcceptToMemoryPool for each of them in order. The scripts of transactions
+ * that do not spend each other are checked together on the script check
+ * threads, and they are added under one hold of the mempool lock.
+ * Returns the number of transactions added. **/
+size_t AcceptToMemoryPoolMany(CTxMemPool& pool, std::vector<MempoolAcceptEntry>& entries, std::list<CTransactionRef>* plTxnReplaced,
+                        bool bypass_limits, const CAmount nAbsurdFee) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Get the BIP9 state for a given deployment at the current tip. */
 ThresholdState VersionBitsTipState(const Consensus::Params& params, Consensus::DeploymentPos pos);
 
@@ -359,13 +392,25 @@ public:
 
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
+/** Write the script execution cache to scriptcache.dat in the data directory */
+bool DumpScriptExecutionCache();
+/** Load scriptcache.dat into the script execution cache, to be called after InitScriptExecutionCache */
+bool LoadScriptExecutionCache();
 
 
 /** Functions for disk access for blocks */
-bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/** Read a block that is already in the block index. Its proof of work is not re-checked; the block hash must match the index entry instead. */
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start, const CMessageHeader::MessageStartChars& message_start_old);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start, const CMessageHeader::MessageStartChars& message_start_old);
+/**
+ * Point block at a block's serialized bytes in a memory mapping of its block
+ * file, which file keeps alive. Returns false if the block file cannot be
+ * mapped; ReadRawBlockFromDisk still works then.
+ */
+bool MapRawBlockFromDisk(std::shared_ptr<const MappedFlatFile>& file, Span<const uint8_t>& block, const FlatFilePos& pos, const CMessageHeader::MessageStartChars& message_start, const CMessageHeader::MessageStartChars& message_start_old);
+bool MapRawBlockFromDisk(std::shared_ptr<const MappedFlatFile>& file, Span<const uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start, const CMessageHeader::MessageStartChars& message_start_old);
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
@@ -374,6 +419,14 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
 
+/**
+ * Run CheckBlock() on several blocks concurrently on the block check queue,
+ * without holding cs_main. Blocks that pass are marked fChecked, so that
+ * ProcessNewBlock and AcceptBlock don't check them again; blocks that fail
+ * are rejected with the full validation state when they are processed.
+ */
+void CheckBlocks(const std::vector<std::shared_ptr<const CBlock>>& blocks, const Consensus::Params& consensusParams) LOCKS_EXCLUDED(cs_main);
+
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -439,6 +492,9 @@ class BlockManager {
 public:
     BlockMap m_block_index GUARDED_BY(cs_main);
 
+    //! Storage for the entries of m_block_index created by this manager
+    CBlockIndexArena m_block_index_arena GUARDED_BY(cs_main);
+
     /** In order to efficiently track invalidity of headers, we keep the set of
       * blocks which we tried to connect and found to be invalid here (ie which
       * were set to BLOCK_FAILED_VALID since the last restart). We can then
@@ -489,12 +545,14 @@ public:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to m_block_index.
+     * fCheckPOW may only be false if the caller already verified the header's proof of work.
      */
     bool AcceptBlockHeader(
         const CBlockHeader& block,
         CValidationState& state,
         const CChainParams& chainparams,
-        CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+        CBlockIndex** ppindex,
+        bool fCheckPOW = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 };
 
 /**
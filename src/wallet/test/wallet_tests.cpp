@@ -4,11 +4,13 @@
 
 #include <wallet/wallet.h>
 
+#include <deque>
 #include <memory>
 #include <stdint.h>
 #include <vector>
 
 #include <consensus/validation.h>
+#include <index/blockfilterindex.h>
 #include <interfaces/chain.h>
 #include <policy/policy.h>
 #include <rpc/server.h>
@@ -111,6 +113,108 @@ BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions, TestChain100Setup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions_block_filters, TestChain100Setup)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CreateAndProcessBlock({}, GetScriptForDestination(PKHash(key.GetPubKey())));
+    const uint256 genesis_hash = ::ChainActive().Genesis()->GetBlockHash();
+    const uint256 tip_hash = ::ChainActive().Tip()->GetBlockHash();
+    const int tip_height = ::ChainActive().Height();
+
+    auto chain = interfaces::MakeChain();
+    auto scan = [&] {
+        // The chain lock is held like in the rescan at wallet loading, the
+        // threads reading blocks ahead must not need it
+        auto locked_chain = chain->lock();
+        CWallet wallet(chain.get(), WalletLocation(), WalletDatabase::CreateDummy());
+        AddKey(wallet, key);
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        CWallet::ScanResult result = wallet.ScanForWalletTransactions(genesis_hash, {} /* stop_block */, reserver, false /* update */);
+        BOOST_CHECK_EQUAL(result.status, CWallet::ScanResult::SUCCESS);
+        BOOST_CHECK(result.last_failed_block.IsNull());
+        BOOST_CHECK_EQUAL(result.last_scanned_block, tip_hash);
+        BOOST_CHECK_EQUAL(wallet.GetBalance().m_mine_immature, 80 * COIN);
+    };
+
+    // Without block filters, every block is read
+    BOOST_CHECK(!chain->hasBlockFilterIndex(BlockFilterType::BASIC));
+    scan();
+
+    // With them, only the block paying the key is, with the same result
+    BOOST_REQUIRE(InitBlockFilterIndex(BlockFilterType::BASIC, 1 << 20, true));
+    BlockFilterIndex* filter_index = GetBlockFilterIndex(BlockFilterType::BASIC);
+    filter_index->Start();
+    const int64_t time_start = GetTimeMillis();
+    while (!filter_index->BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + 10 * 1000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+    BOOST_CHECK(chain->hasBlockFilterIndex(BlockFilterType::BASIC));
+    const CScript script = GetScriptForDestination(PKHash(key.GetPubKey()));
+    const GCSFilter::ElementSet elements{{script.begin(), script.end()}};
+    BOOST_CHECK(*chain->blockFilterMatchesAny(BlockFilterType::BASIC, tip_height, tip_hash, elements));
+    BOOST_CHECK(!*chain->blockFilterMatchesAny(BlockFilterType::BASIC, 0, genesis_hash, elements));
+    scan();
+    filter_index->Stop();
+    DestroyBlockFilterIndex(BlockFilterType::BASIC);
+}
+
+BOOST_FIXTURE_TEST_CASE(scan_for_wallet_transactions_block_filters_keypool_topup, TestChain100Setup)
+{
+    // Derive the first external keys of the HD wallet below, m/0'/0'/k'
+    CKey seed;
+    seed.MakeNewKey(true);
+    CExtKey master, account, chain_key, child;
+    master.SetSeed(seed.begin(), seed.size());
+    master.Derive(account, 0x80000000);
+    account.Derive(chain_key, 0x80000000);
+    auto derive = [&](unsigned int index) {
+        chain_key.Derive(child, index | 0x80000000);
+        return GetScriptForDestination(PKHash(child.key.GetPubKey()));
+    };
+
+    // The first block pays a key in the keypool, the second one a key only
+    // added when using the first one tops up the keypool
+    const CBlock block_keypool = CreateAndProcessBlock({}, derive(1));
+    CreateAndProcessBlock({}, derive(3));
+    const uint256 tip_hash = ::ChainActive().Tip()->GetBlockHash();
+
+    BOOST_REQUIRE(InitBlockFilterIndex(BlockFilterType::BASIC, 1 << 20, true));
+    BlockFilterIndex* filter_index = GetBlockFilterIndex(BlockFilterType::BASIC);
+    filter_index->Start();
+    const int64_t time_start = GetTimeMillis();
+    while (!filter_index->BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + 10 * 1000 > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    auto chain = interfaces::MakeChain();
+    {
+        auto locked_chain = chain->lock();
+        CWallet wallet(chain.get(), WalletLocation(), WalletDatabase::CreateDummy());
+        wallet.SetHDSeed(wallet.DeriveNewSeed(seed));
+        BOOST_REQUIRE(wallet.TopUpKeyPool(2));
+
+        // The wallet already has the first coinbase, so adding it again
+        // changes nothing in mapWallet, only the keys when rescanning with
+        // fUpdate
+        BOOST_CHECK(wallet.AddToWallet(CWalletTx(&wallet, block_keypool.vtx[0])));
+        const size_t wallet_size = WITH_LOCK(wallet.cs_wallet, return wallet.mapWallet.size());
+
+        WalletRescanReserver reserver(&wallet);
+        reserver.reserve();
+        CWallet::ScanResult result = wallet.ScanForWalletTransactions(block_keypool.GetHash(), {} /* stop_block */, reserver, true /* update */);
+        BOOST_CHECK_EQUAL(result.status, CWallet::ScanResult::SUCCESS);
+        BOOST_CHECK_EQUAL(result.last_scanned_block, tip_hash);
+        BOOST_CHECK_EQUAL(WITH_LOCK(wallet.cs_wallet, return wallet.mapWallet.size()), wallet_size + 1);
+        BOOST_CHECK_EQUAL(wallet.GetBalance().m_mine_immature, 160 * COIN);
+    }
+    filter_index->Stop();
+    DestroyBlockFilterIndex(BlockFilterType::BASIC);
+}
+
 BOOST_FIXTURE_TEST_CASE(importmulti_rescan, TestChain100Setup)
 {
     // Cap last block file size, and mine new block in a new block file.
@@ -271,7 +375,11 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     if (blockTime > 0) {
         auto locked_chain = wallet.chain().lock();
         LockAssertion lock(::cs_main);
-        auto inserted = ::BlockIndex().emplace(GetRandHash(), new CBlockIndex);
+        // Block index entries are owned by the block manager's arena, these
+        // only have to outlive the test.
+        static std::deque<CBlockIndex> blocks;
+        blocks.emplace_back();
+        auto inserted = ::BlockIndex().emplace(GetRandHash(), &blocks.back());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
@@ -460,6 +568,33 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+BOOST_FIXTURE_TEST_CASE(AvailableCoinsAbandonedSpend, ListCoinsTestingSetup)
+{
+    // A wallet transaction spending the coin, which never got to the mempool
+    CMutableTransaction spend;
+    {
+        auto locked_chain = m_chain->lock();
+        LOCK(wallet->cs_wallet);
+        std::vector<COutput> available;
+        wallet->AvailableCoins(*locked_chain, available);
+        BOOST_REQUIRE_EQUAL(available.size(), 1U);
+        spend.vin.emplace_back(COutPoint(available[0].tx->GetHash(), available[0].i));
+        spend.vout.emplace_back(1 * COIN, GetScriptForRawPubKey({}));
+    }
+    CWalletTx wtx(wallet.get(), MakeTransactionRef(spend));
+    BOOST_CHECK(wallet->AddToWallet(wtx));
+    BOOST_CHECK_EQUAL(wallet->GetAvailableBalance(), 0);
+    BOOST_CHECK_EQUAL(wallet->GetBalance().m_mine_trusted, 0);
+
+    // Abandoning it makes the coin available again
+    {
+        auto locked_chain = m_chain->lock();
+        BOOST_CHECK(wallet->AbandonTransaction(*locked_chain, wtx.GetHash()));
+    }
+    BOOST_CHECK_EQUAL(wallet->GetAvailableBalance(), 80 * COIN);
+    BOOST_CHECK_EQUAL(wallet->GetBalance().m_mine_trusted, 80 * COIN);
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain();
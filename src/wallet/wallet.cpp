@@ -33,7 +33,10 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -620,6 +623,32 @@ bool CWallet::HaveWatchOnly() const
     return (!setWatchOnly.empty());
 }
 
+GCSFilter::ElementSet CWallet::GetFilterElements() const
+{
+    GCSFilter::ElementSet elements;
+    auto insert = [&elements](const CScript& script) { elements.emplace(script.begin(), script.end()); };
+    for (const CKeyID& keyid : GetKeys()) {
+        CPubKey pubkey;
+        if (!GetPubKey(keyid, pubkey)) continue;
+        insert(GetScriptForRawPubKey(pubkey));
+        insert(GetScriptForDestination(PKHash(keyid)));
+    }
+    // Witness outputs and P2SH outputs are only ours if their script is known,
+    // the bare witness programs themselves are stored as scripts
+    for (const CScriptID& scriptid : GetCScripts()) {
+        CScript script;
+        if (!GetCScript(scriptid, script)) continue;
+        insert(script);
+        insert(GetScriptForDestination(ScriptHash(script)));
+        insert(GetScriptForDestination(WitnessV0ScriptHash(script)));
+    }
+    LOCK(cs_KeyStore);
+    for (const CScript& script : setWatchOnly) {
+        insert(script);
+    }
+    return elements;
+}
+
 bool CWallet::Unlock(const SecureString& strWalletPassphrase, bool accept_no_keys)
 {
     CCrypter crypter;
@@ -852,6 +881,50 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::UpdateUnspent(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    auto it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.tx->vout.size() || IsMine(it->second.tx->vout[outpoint.n]) == ISMINE_NO) {
+        setUnspent.erase(outpoint);
+        return;
+    }
+
+    // Abandoned and conflicted transactions may or may not spend the output,
+    // see IsSpent
+    std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+    for (TxSpends::const_iterator spend = range.first; spend != range.second; ++spend) {
+        auto mit = mapWallet.find(spend->second);
+        if (mit != mapWallet.end() && !mit->second.isAbandoned() && !mit->second.isConflicted()) {
+            setUnspent.erase(outpoint);
+            return;
+        }
+    }
+    setUnspent.insert(outpoint);
+}
+
+void CWallet::UpdateUnspent(const CWalletTx& wtx)
+{
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        UpdateUnspent(COutPoint(wtx.GetHash(), i));
+    }
+    if (wtx.IsCoinBase()) return;
+    for (const CTxIn& txin : wtx.tx->vin) {
+        UpdateUnspent(txin.prevout);
+    }
+}
+
+void CWallet::RebuildUnspent()
+{
+    AssertLockHeld(cs_wallet);
+    setUnspent.clear();
+    for (const auto& entry : mapWallet) {
+        for (unsigned int i = 0; i < entry.second.tx->vout.size(); i++) {
+            UpdateUnspent(COutPoint(entry.first, i));
+        }
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -1023,6 +1096,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        // Keys or transactions may have been added or removed
+        RebuildUnspent();
     }
 }
 
@@ -1173,6 +1248,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    UpdateUnspent(wtx);
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1349,6 +1425,7 @@ bool CWallet::AbandonTransaction(interfaces::Chain::Lock& locked_chain, const ui
             // If a transaction changes 'conflicted' state, that changes the balance
             // available of the outputs it spends. So force those to be recomputed
             MarkInputsDirty(wtx.tx);
+            UpdateUnspent(wtx);
         }
     }
 
@@ -1403,6 +1480,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // If a transaction changes 'conflicted' state, that changes the balance
             // available of the outputs it spends. So force those to be recomputed
             MarkInputsDirty(wtx.tx);
+            UpdateUnspent(wtx);
         }
     }
 }
@@ -2025,6 +2103,171 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+namespace {
+/**
+ * Reads the blocks of a rescan on several threads, ahead of the scan applying
+ * them in order. Given the wallet's filter elements, blocks whose BIP 158
+ * filter matches none of them are skipped without being read.
+ *
+ * The threads take no lock, the scan may be holding the chain lock while it
+ * waits for them. The blocks are located when queued, under that lock. What
+ * reading a block throws is passed back to the scan with the block.
+ */
+class RescanBlockReader
+{
+public:
+    RescanBlockReader(interfaces::Chain& chain, int threads) : m_chain(chain)
+    {
+        for (int i = 0; i < threads; i++) {
+            m_threads.emplace_back(&TraceThread<std::function<void()>>, "rescanread", std::function<void()>(std::bind(&RescanBlockReader::ThreadRead, this)));
+        }
+    }
+
+    ~RescanBlockReader()
+    {
+        WITH_LOCK(m_mutex, m_stop = true);
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    //! Match the blocks read from now on against these elements, or read every block if null
+    void SetFilter(std::shared_ptr<const GCSFilter::ElementSet> filter_set)
+    {
+        LOCK(m_mutex);
+        m_filter_set = std::move(filter_set);
+    }
+
+    //! Hash of the block the next Read() returns, null if none is queued
+    uint256 Front()
+    {
+        LOCK(m_mutex);
+        return m_queue.empty() ? uint256() : m_queue.front()->hash;
+    }
+
+    //! Queue a block after the ones already queued, pos is from Chain::Lock::getBlockPos()
+    void Add(const uint256& hash, int height, const Optional<FlatFilePos>& pos)
+    {
+        {
+            LOCK(m_mutex);
+            m_queue.push_back(std::make_shared<Job>(hash, height, pos));
+        }
+        m_cond.notify_one();
+    }
+
+    //! Forget the queued blocks, the ones being read are dropped once done
+    void Clear()
+    {
+        LOCK(m_mutex);
+        m_queue.clear();
+        m_next = 0;
+    }
+
+    /**
+     * Wait for the block at the front of the queue and remove it.
+     * @param[out] block    The block, if read
+     * @param[out] skipped  Set if the filter showed the block has nothing for the wallet
+     * @param[out] error    Set to what reading the block threw, if it did
+     * @return false if the block could not be read
+     */
+    bool Read(CBlock& block, bool& skipped, std::string& error)
+    {
+        WAIT_LOCK(m_mutex, lock);
+        assert(!m_queue.empty());
+        std::shared_ptr<Job> job = m_queue.front();
+        if (m_next == 0) {
+            // Not picked up by a reader thread yet, read it here
+            m_next++;
+            job->filter_set = m_filter_set;
+            lock.unlock();
+            Fetch(*job);
+            lock.lock();
+        } else {
+            m_cond.wait(lock, [&] { return job->done; });
+            if (job->skipped && job->filter_set != m_filter_set) {
+                // Matched against elements the wallet has outgrown, match again
+                job->filter_set = m_filter_set;
+                lock.unlock();
+                Fetch(*job);
+                lock.lock();
+            }
+        }
+        m_queue.pop_front();
+        m_next--;
+        skipped = job->skipped;
+        error = job->error;
+        block = std::move(job->block);
+        return job->found;
+    }
+
+private:
+    struct Job {
+        Job(const uint256& hash_in, int height_in, const Optional<FlatFilePos>& pos_in) : hash(hash_in), height(height_in), pos(pos_in) {}
+        const uint256 hash;
+        const int height;
+        const Optional<FlatFilePos> pos;
+        //! Elements the block was matched against, null if not filtered
+        std::shared_ptr<const GCSFilter::ElementSet> filter_set;
+        bool done = false;
+        bool skipped = false;
+        bool found = false;
+        //! What matching or reading the block threw, empty if nothing
+        std::string error;
+        CBlock block;
+    };
+
+    interfaces::Chain& m_chain;
+    std::vector<std::thread> m_threads;
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    std::shared_ptr<const GCSFilter::ElementSet> m_filter_set GUARDED_BY(m_mutex);
+    std::deque<std::shared_ptr<Job>> m_queue GUARDED_BY(m_mutex);
+    //! Position in m_queue of the first block no thread has picked up
+    size_t m_next GUARDED_BY(m_mutex) = 0;
+
+    //! Match the job's block against its filter elements, and read it unless it has nothing for the wallet
+    void Fetch(Job& job)
+    {
+        job.skipped = false;
+        job.error.clear();
+        try {
+            if (job.filter_set) {
+                Optional<bool> matches = m_chain.blockFilterMatchesAny(BlockFilterType::BASIC, job.height, job.hash, *job.filter_set);
+                if (matches && !*matches) {
+                    job.skipped = true;
+                    return;
+                }
+            }
+            job.found = job.pos && m_chain.readBlockFromDisk(*job.pos, job.hash, job.block);
+        } catch (const std::exception& e) {
+            job.found = false;
+            job.error = e.what();
+        } catch (...) {
+            job.found = false;
+            job.error = "unknown exception";
+        }
+    }
+
+    void ThreadRead()
+    {
+        WAIT_LOCK(m_mutex, lock);
+        while (true) {
+            m_cond.wait(lock, [this] { return m_stop || m_next < m_queue.size(); });
+            if (m_stop) return;
+            std::shared_ptr<Job> job = m_queue[m_next++];
+            job->filter_set = m_filter_set;
+            lock.unlock();
+            Fetch(*job);
+            lock.lock();
+            job->done = true;
+            m_cond.notify_all();
+        }
+    }
+};
+} // namespace
+
 /**
  * Scan the block chain (starting in start_block) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -2056,7 +2299,25 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     uint256 block_hash = start_block;
     ScanResult result;
 
-    WalletLogPrintf("Rescan started from block %s...\n", start_block.ToString());
+    // Blocks are read ahead of the scan on other threads. With block filters,
+    // only the blocks matching one of the wallet's scripts are read at all.
+    RescanBlockReader reader(chain(), std::max(1, std::min(GetNumCores(), MAX_RESCAN_READ_THREADS)));
+    const bool use_filters = chain().hasBlockFilterIndex(BlockFilterType::BASIC);
+    std::shared_ptr<const GCSFilter::ElementSet> filter_set;
+    // What the filter elements are made of only grows, so they need to be
+    // rebuilt whenever this count changes
+    auto count_filter_sources = [this] {
+        LOCK(cs_KeyStore);
+        return mapKeys.size() + mapCryptedKeys.size() + mapScripts.size() + setWatchOnly.size();
+    };
+    size_t filter_sources = 0;
+    if (use_filters) {
+        filter_sources = count_filter_sources();
+        filter_set = std::make_shared<const GCSFilter::ElementSet>(GetFilterElements());
+        reader.SetFilter(filter_set);
+    }
+
+    WalletLogPrintf("Rescan started from block %s%s...\n", start_block.ToString(), use_filters ? " using block filters" : "");
 
     fAbortRescan = false;
     ShowProgress(strprintf("%s " + _("Rescanning...").translated, GetDisplayName()), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
@@ -2065,12 +2326,30 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     Optional<int> block_height = MakeOptional(false, int());
     double progress_begin;
     double progress_end;
+    Optional<int> stop_height;
+    int queued_height = -1;
+    // Queue the blocks up to RESCAN_READ_AHEAD past the one being scanned
+    auto queue_blocks = [&](interfaces::Chain::Lock& locked_chain, int tip_height) {
+        const int max_height = std::min(*block_height + RESCAN_READ_AHEAD, stop_height ? std::min(*stop_height, tip_height) : tip_height);
+        while (queued_height < max_height) {
+            ++queued_height;
+            reader.Add(locked_chain.getBlockHash(queued_height), queued_height, locked_chain.getBlockPos(queued_height));
+        }
+    };
     {
         auto locked_chain = chain().lock();
-        if (Optional<int> tip_height = locked_chain->getHeight()) {
+        Optional<int> tip_height = locked_chain->getHeight();
+        if (tip_height) {
             tip_hash = locked_chain->getBlockHash(*tip_height);
         }
         block_height = locked_chain->getBlockHeight(block_hash);
+        if (!stop_block.IsNull()) {
+            stop_height = locked_chain->getBlockHeight(stop_block);
+        }
+        if (block_height && tip_height) {
+            queued_height = *block_height - 1;
+            queue_blocks(*locked_chain, *tip_height);
+        }
         progress_begin = chain().guessVerificationProgress(block_hash);
         progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
     }
@@ -2085,8 +2364,29 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
         }
 
+        if (reader.Front() != block_hash) {
+            // The chain changed since the blocks were queued
+            auto locked_chain = chain().lock();
+            reader.Clear();
+            reader.Add(block_hash, *block_height, locked_chain->getBlockPos(*block_height));
+            queued_height = *block_height;
+        }
         CBlock block;
-        if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+        bool skipped = false;
+        std::string read_error;
+        bool found = reader.Read(block, skipped, read_error);
+        if (!read_error.empty()) {
+            // The disk or the filter index failed, scanning on would be no better
+            WalletLogPrintf("Rescan failed to read block %s: %s\n", block_hash.ToString(), read_error);
+            result.last_failed_block = block_hash;
+            result.status = ScanResult::FAILURE;
+            break;
+        }
+        if (skipped) {
+            // nothing in the block for the wallet, it counts as scanned
+            result.last_scanned_block = block_hash;
+            result.last_scanned_height = *block_height;
+        } else if (found) {
             auto locked_chain = chain().lock();
             LOCK(cs_wallet);
             if (!locked_chain->getBlockHeight(block_hash)) {
@@ -2101,6 +2401,14 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
                 SyncTransaction(block.vtx[posInBlock], CWalletTx::Status::CONFIRMED, block_hash, posInBlock, fUpdate);
             }
+            if (use_filters && count_filter_sources() != filter_sources) {
+                // The transactions used keys from the keypool and topped it
+                // up, even ones the wallet already had when fUpdate is set:
+                // match the blocks ahead against the new keys too
+                filter_sources = count_filter_sources();
+                filter_set = std::make_shared<const GCSFilter::ElementSet>(GetFilterElements());
+                reader.SetFilter(filter_set);
+            }
             // scan succeeded, record block as most recent successfully scanned
             result.last_scanned_block = block_hash;
             result.last_scanned_height = *block_height;
@@ -2124,6 +2432,7 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             // increment block and verification progress
             block_hash = locked_chain->getBlockHash(++*block_height);
             progress_current = chain().guessVerificationProgress(block_hash);
+            queue_blocks(*locked_chain, *tip_height);
 
             // handle updated tip hash
             const uint256 prev_tip_hash = tip_hash;
@@ -2437,9 +2746,10 @@ CWallet::Balance CWallet::GetBalance(const int min_depth, bool avoid_reuse) cons
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
+        // Transactions with no output in setUnspent have no credit left
+        for (auto it = setUnspent.begin(); it != setUnspent.end(); it = setUnspent.upper_bound(COutPoint(it->hash, COutPoint::NULL_INDEX)))
         {
-            const CWalletTx& wtx = entry.second;
+            const CWalletTx& wtx = mapWallet.at(it->hash);
             const bool is_trusted{wtx.IsTrusted(*locked_chain)};
             const int tx_depth{wtx.GetDepthInMainChain(*locked_chain)};
             const CAmount tx_credit_mine{wtx.GetAvailableCredit(*locked_chain, /* fUseCache */ true, ISMINE_SPENDABLE | reuse_filter)};
@@ -2487,10 +2797,11 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     const int min_depth = {coinControl ? coinControl->m_min_depth : DEFAULT_MIN_DEPTH};
     const int max_depth = {coinControl ? coinControl->m_max_depth : DEFAULT_MAX_DEPTH};
 
-    for (const auto& entry : mapWallet)
+    // Each transaction with outputs in setUnspent, in the order of mapWallet
+    for (auto group = setUnspent.begin(); group != setUnspent.end(); group = setUnspent.upper_bound(COutPoint(group->hash, COutPoint::NULL_INDEX)))
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx& wtx = entry.second;
+        const uint256& wtxid = group->hash;
+        const CWalletTx& wtx = mapWallet.at(wtxid);
 
         if (!locked_chain.checkFinalTx(*wtx.tx)) {
             continue;
@@ -2549,14 +2860,15 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
             continue;
         }
 
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        for (auto output = group; output != setUnspent.end() && output->hash == wtxid; ++output) {
+            const unsigned int i = output->n;
             if (wtx.tx->vout[i].nValue < nMinimumAmount || wtx.tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
+            if (IsLockedCoin(wtxid, i))
                 continue;
 
             if (IsSpent(locked_chain, wtxid, i))
@@ -3393,6 +3705,9 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     if (nLoadWalletRet != DBErrors::LOAD_OK)
         return nLoadWalletRet;
 
+    // Transactions are loaded before the keys, so what is ours is only known now
+    RebuildUnspent();
+
     return DBErrors::LOAD_OK;
 }
 
@@ -3404,6 +3719,7 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
         mapWallet.erase(it);
+        setUnspent.erase(setUnspent.lower_bound(COutPoint(hash, 0)), setUnspent.upper_bound(COutPoint(hash, COutPoint::NULL_INDEX)));
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
 
@@ -7,6 +7,7 @@
 #define BITCOIN_WALLET_WALLET_H
 
 #include <amount.h>
+#include <blockfilter.h>
 #include <interfaces/chain.h>
 #include <interfaces/handler.h>
 #include <outputtype.h>
@@ -92,6 +93,11 @@ constexpr CAmount HIGH_TX_FEE_PER_KB{20 * COIN};
 //! -maxtxfee will warn if called with a higher fee than this amount (in satoshis)
 constexpr CAmount HIGH_MAX_TX_FEE{100 * HIGH_TX_FEE_PER_KB};
 
+//! Maximum number of threads reading blocks ahead of a rescan
+static const int MAX_RESCAN_READ_THREADS = 4;
+//! Number of blocks a rescan reads ahead of the one it is scanning
+static const int RESCAN_READ_AHEAD = 128;
+
 //! Pre-calculated constants for input size estimation in *virtual size*
 static constexpr size_t DUMMY_NESTED_P2WPKH_INPUT_SIZE = 91;
 
@@ -789,6 +795,21 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Outputs of wallet transactions paying to the wallet which no confirmed
+     * or unconfirmed wallet transaction spends, in the order of mapWallet.
+     * AvailableCoins and GetBalance only look at these, and still check them
+     * against the chain, as whether a conflicted transaction spends an output
+     * depends on the chain.
+     */
+    std::set<COutPoint> setUnspent GUARDED_BY(cs_wallet);
+    /* Add the outpoint to setUnspent or remove it, after it or a transaction spending it changed */
+    void UpdateUnspent(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* Update setUnspent for the outputs of a transaction and the outputs it spends */
+    void UpdateUnspent(const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* Fill setUnspent from all of mapWallet, after loading or when what is ours may have changed */
+    void RebuildUnspent() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -1076,6 +1097,9 @@ public:
     bool HaveWatchOnly() const;
     //! Fetches a pubkey from mapWatchKeys if it exists there
     bool GetWatchPubKey(const CKeyID &address, CPubKey &pubkey_out) const;
+    //! Returns every scriptPubKey IsMine may consider the wallet's, to match
+    //! against block filters. A superset: not all of them are the wallet's.
+    GCSFilter::ElementSet GetFilterElements() const;
 
     //! Holds a timestamp at which point the wallet is scheduled (externally) to be relocked. Caller must arrange for actual relocking to occur via Lock().
     int64_t nRelockTime = 0;
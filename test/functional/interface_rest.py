@@ -63,6 +63,8 @@ class RESTTest (BitcoinTestFramework):
             conn.request('GET', rest_uri)
         elif http_method == 'POST':
             conn.request('POST', rest_uri, body)
+        elif http_method == 'HEAD':
+            conn.request('HEAD', rest_uri)
         resp = conn.getresponse()
 
         assert_equal(resp.status, status)
@@ -302,6 +304,11 @@ class RESTTest (BitcoinTestFramework):
             assert_equal(json_obj[tx]['spentby'], txs[i + 1:i + 2])
             assert_equal(json_obj[tx]['depends'], txs[i - 1:i])
 
+        # The mempool contents are streamed with chunked transfer encoding
+        resp = self.test_rest_request("/mempool/contents", ret_type=RetType.OBJ)
+        assert_equal(resp.getheader('Transfer-Encoding'), 'chunked')
+        assert_equal(json.loads(resp.read().decode('utf-8'), parse_float=Decimal), self.nodes[0].getrawmempool(True))
+
         # Now mine the transactions
         newblockhash = self.nodes[1].generate(1)
         self.sync_all()
@@ -317,6 +324,18 @@ class RESTTest (BitcoinTestFramework):
         for tx in txs:
             assert tx in json_obj['tx']
 
+        # The block with transaction details is streamed with chunked transfer
+        # encoding, and matches getblock with verbosity 2
+        resp = self.test_rest_request("/block/{}".format(newblockhash[0]), ret_type=RetType.OBJ)
+        assert_equal(resp.getheader('Transfer-Encoding'), 'chunked')
+        assert_equal(json.loads(resp.read().decode('utf-8'), parse_float=Decimal), self.nodes[0].getblock(newblockhash[0], 2))
+
+        # No body is sent in reply to HEAD, and the worker doesn't wait for one to be sent
+        for _ in range(8):
+            resp = self.test_rest_request("/block/{}".format(newblockhash[0]), http_method='HEAD', ret_type=RetType.OBJ)
+            assert_equal(resp.read(), b'')
+        assert_equal(self.test_rest_request("/block/{}".format(newblockhash[0]))['hash'], newblockhash[0])
+
         self.log.info("Test the /chaininfo URI")
 
         bb_hash = self.nodes[0].getbestblockhash()
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Napocoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test and measure passing compact blocks on before the block is connected.
+
+A node that receives a cmpctblock with a valid header extending its tip
+announces it to its high-bandwidth peers right away, without waiting to
+reconstruct and connect the block.
+
+- Mine blocks along a line of nodes, node0 -> node1 -> node2 -> node3, in
+  high-bandwidth mode, and log how long each hop takes with and without
+  -earlycmpctrelay. Check that the blocks went from node to node as
+  cmpctblock messages.
+- Send node0 a compact block it cannot reconstruct (one of the transactions
+  is unknown to it), and check that a high-bandwidth peer receives the
+  cmpctblock while node0 still asks for the missing transaction and has not
+  connected the block.
+"""
+import time
+
+from test_framework.blocktools import create_block, create_coinbase
+from test_framework.messages import COutPoint, CTransaction, CTxIn, CTxOut, HeaderAndShortIDs, msg_cmpctblock, msg_sendcmpct
+from test_framework.mininode import mininode_lock, P2PInterface
+from test_framework.script import CScript, OP_TRUE
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, connect_nodes, wait_until
+
+BLOCKS = 20
+
+
+class CompactBlockPeer(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.announced_blockhashes = set()
+
+    def on_cmpctblock(self, message):
+        header = message.header_and_shortids.header
+        header.calc_sha256()
+        self.announced_blockhashes.add(header.sha256)
+
+    def request_high_bandwidth(self):
+        sendcmpct = msg_sendcmpct()
+        sendcmpct.announce = True
+        sendcmpct.version = 2
+        self.send_and_ping(sendcmpct)
+
+
+class CompactBlockRelayTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 4
+        self.setup_clean_chain = True
+
+    def run_test(self):
+        early = self.measure_hops("with early relay")
+        self.restart_line(["-earlycmpctrelay=0"])
+        late = self.measure_hops("without early relay")
+        for i in range(1, self.num_nodes):
+            self.log.info("hop node%d -> node%d: %.1f ms with early relay, %.1f ms without" % (
+                i - 1, i, 1000 * sum(early[i - 1]) / BLOCKS, 1000 * sum(late[i - 1]) / BLOCKS))
+
+        self.restart_line([])
+        self.test_relay_before_connect()
+
+    def restart_line(self, extra_args):
+        for i in range(self.num_nodes):
+            self.restart_node(i, extra_args)
+        for i in range(self.num_nodes - 1):
+            connect_nodes(self.nodes[i + 1], i)
+
+    def measure_hops(self, label):
+        """Mine BLOCKS blocks on node0, and return the time each hop took for each block."""
+        address = self.nodes[0].get_deterministic_priv_key().address
+
+        self.log.info("Mine blocks one at a time, so each node picks its neighbour for high-bandwidth relay")
+        for _ in range(5):
+            self.nodes[0].generatetoaddress(1, address)
+            self.sync_blocks()
+
+        self.log.info("Time %d blocks from node0 to node%d %s" % (BLOCKS, self.num_nodes - 1, label))
+        hops = [[] for _ in range(self.num_nodes - 1)]
+        for _ in range(BLOCKS):
+            start = time.time()
+            block_hash = self.nodes[0].generatetoaddress(1, address)[0]
+            seen = [time.time()] + [None] * (self.num_nodes - 1)
+            while None in seen:
+                for i in range(1, self.num_nodes):
+                    if seen[i] is None and self.nodes[i].getbestblockhash() == block_hash:
+                        seen[i] = time.time()
+                assert time.time() - start < 60
+            for i in range(1, self.num_nodes):
+                hops[i - 1].append(seen[i] - seen[i - 1])
+
+        for i in range(1, self.num_nodes):
+            hop = hops[i - 1]
+            self.log.info("node%d -> node%d %s: %.1f ms on average (max %.1f ms)" % (
+                i - 1, i, label, 1000 * sum(hop) / BLOCKS, 1000 * max(hop)))
+
+        self.log.info("Check that the blocks were relayed as compact blocks")
+        height = self.nodes[0].getblockcount()
+        for i in range(1, self.num_nodes):
+            assert_equal(self.nodes[i].getblockcount(), height)
+            # Each node connected out to the one before it in the line
+            upstream = [p for p in self.nodes[i].getpeerinfo() if not p['inbound']]
+            assert_equal(len(upstream), 1)
+            assert upstream[0]['bytesrecv_per_msg'].get('cmpctblock', 0) > 0
+
+        return hops
+
+    def test_relay_before_connect(self):
+        node = self.nodes[0]
+        address = node.get_deterministic_priv_key().address
+
+        self.log.info("Connect a high-bandwidth compact block peer and a peer to send a block")
+        listener = node.add_p2p_connection(CompactBlockPeer())
+        listener.request_high_bandwidth()
+        sender = node.add_p2p_connection(CompactBlockPeer())
+        sender.request_high_bandwidth()
+
+        # Have the node announce a block to the listener, so that it knows the
+        # listener has the tip the next compact block builds on
+        tip = node.generatetoaddress(1, address)[0]
+        wait_until(lambda: int(tip, 16) in listener.announced_blockhashes, timeout=30, lock=mininode_lock)
+
+        self.log.info("Send a compact block the node can't reconstruct")
+        tip_header = node.getblockheader(tip)
+        block = create_block(int(tip, 16), create_coinbase(tip_header['height'] + 1), tip_header['mediantime'] + 1)
+        block.nVersion = 0x20000000
+        unknown_tx = CTransaction()
+        unknown_tx.vin.append(CTxIn(COutPoint(0x1234, 0), b''))
+        unknown_tx.vout.append(CTxOut(1000, CScript([OP_TRUE])))
+        unknown_tx.rehash()
+        block.vtx.append(unknown_tx)
+        block.hashMerkleRoot = block.calc_merkle_root()
+        block.solve()
+
+        cmpctblock = HeaderAndShortIDs()
+        cmpctblock.initialize_from_block(block, prefill_list=[0], use_witness=True)
+        sender.send_message(msg_cmpctblock(cmpctblock.to_p2p()))
+
+        self.log.info("Check that it is passed on before the block is connected")
+        wait_until(lambda: block.sha256 in listener.announced_blockhashes, timeout=30, lock=mininode_lock)
+        wait_until(lambda: "getblocktxn" in sender.last_message, timeout=30, lock=mininode_lock)
+        assert_equal(node.getbestblockhash(), tip)
+
+
+if __name__ == '__main__':
+    CompactBlockRelayTest().main()
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Napocoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the address index RPCs getaddresshistory and getaddressunspent."""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal, assert_raises_rpc_error,
+    connect_nodes, disconnect_nodes, sync_blocks
+    )
+
+class AddrIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-addrindex"], []]
+
+    def run_test(self):
+        address = self.nodes[0].get_deterministic_priv_key().address
+        other_address = self.nodes[1].get_deterministic_priv_key().address
+
+        hashes = self.nodes[0].generatetoaddress(10, address)
+        sync_blocks(self.nodes)
+        txids = [self.nodes[0].getblock(block_hash)['tx'][0] for block_hash in hashes]
+
+        self.log.info("Check the history and unspent outputs of the coinbase address")
+        history = self.nodes[0].getaddresshistory(address)
+        assert_equal([entry['txid'] for entry in history], txids)
+        assert_equal([entry['height'] for entry in history], list(range(1, 11)))
+        assert all(not entry['spend'] and entry['vout'] == 0 for entry in history)
+        unspent = self.nodes[0].getaddressunspent(address)
+        assert_equal([entry['txid'] for entry in unspent], txids)
+        assert_equal(unspent[0]['amount'], history[0]['amount'])
+
+        self.log.info("Check pagination, resuming after the last entry of the previous page")
+        page = self.nodes[0].getaddresshistory(address, 2)
+        assert_equal([entry['txid'] for entry in page], txids[:2])
+        assert_equal([entry['txid'] for entry in self.nodes[0].getaddresshistory(address, 3, page[-1])], txids[2:5])
+        page = self.nodes[0].getaddressunspent(address, 8)
+        assert_equal([entry['txid'] for entry in self.nodes[0].getaddressunspent(address, 100, page[-1])], txids[8:])
+        assert_equal(self.nodes[0].getaddresshistory(address, 100, history[-1]), [])
+        assert_equal(self.nodes[0].getaddressunspent(address, 100, unspent[-1]), [])
+        assert_equal(self.nodes[0].getaddresshistory(other_address), [])
+
+        self.log.info("Check that a reorg removes the entries of the disconnected blocks")
+        disconnect_nodes(self.nodes[0], 1)
+        self.nodes[0].generatetoaddress(2, address)
+        assert_equal(len(self.nodes[0].getaddresshistory(address)), 12)
+        self.nodes[1].generatetoaddress(3, other_address)
+        connect_nodes(self.nodes[0], 1)
+        sync_blocks(self.nodes)
+        assert_equal([entry['txid'] for entry in self.nodes[0].getaddresshistory(address)], txids)
+        assert_equal([entry['txid'] for entry in self.nodes[0].getaddressunspent(address)], txids)
+        assert_equal(len(self.nodes[0].getaddressunspent(other_address)), 3)
+
+        self.log.info("Check errors")
+        assert_raises_rpc_error(-5, "Invalid address", self.nodes[0].getaddresshistory, "foo")
+        assert_raises_rpc_error(-8, "count must be between", self.nodes[0].getaddressunspent, address, 0)
+        assert_raises_rpc_error(-3, "Missing spend", self.nodes[0].getaddresshistory, address, 10, {'height': 1})
+        assert_raises_rpc_error(-8, "height out of range", self.nodes[0].getaddresshistory, address, 10, {'height': -1, 'position': 0, 'spend': False, 'vout': 0})
+        assert_raises_rpc_error(-3, "Missing vin", self.nodes[0].getaddresshistory, address, 10, {'height': 1, 'position': 0, 'spend': True, 'vout': 0})
+        assert_raises_rpc_error(-8, "txid must be of length 64", self.nodes[0].getaddressunspent, address, 10, {'txid': 'ab', 'vout': 0, 'height': 1})
+        assert_raises_rpc_error(-1, "Address index is not enabled", self.nodes[1].getaddresshistory, address)
+
+if __name__ == '__main__':
+    AddrIndexTest().main()
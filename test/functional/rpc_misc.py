@@ -11,6 +11,7 @@ from test_framework.util import (
     assert_equal,
     assert_greater_than,
     assert_greater_than_or_equal,
+    wait_until,
 )
 
 from test_framework.authproxy import JSONRPCException
@@ -53,6 +54,26 @@ class RpcMiscTest(BitcoinTestFramework):
         node.logging(include=['qt'])
         assert_equal(node.logging()['qt'], True)
 
+        self.log.info("test getindexinfo")
+        # Without any indexes running the RPC returns an empty object
+        assert_equal(node.getindexinfo(), {})
+
+        # Restart the node with indexes and wait for them to sync
+        self.restart_node(0, ["-txindex", "-blockfilterindex"])
+        wait_until(lambda: all(i["synced"] for i in node.getindexinfo().values()), timeout=60)
+
+        # Returns all running indexes by default
+        info = node.getindexinfo()
+        assert_equal(sorted(info.keys()), ["basic block filter index", "txindex"])
+        for summary in info.values():
+            assert_equal(summary["best_block_height"], 200)
+            assert_equal(summary["progress"], 1)
+            assert_greater_than_or_equal(summary["blocks_per_second"], 0)
+
+        # Returns a single index when it is asked for, and nothing for an unknown one
+        assert_equal(list(node.getindexinfo("txindex").keys()), ["txindex"])
+        assert_equal(node.getindexinfo("foo"), {})
+
 
 if __name__ == '__main__':
     RpcMiscTest().main()
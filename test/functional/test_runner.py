@@ -84,6 +84,7 @@ BASE_SCRIPTS = [
     'feature_block.py',
     'rpc_fundrawtransaction.py',
     'p2p_compactblocks.py',
+    'p2p_compactblocks_hb_relay.py',
     'feature_segwit.py',
     # vv Tests less than 2m vv
     'wallet_basic.py',
@@ -160,6 +161,7 @@ BASE_SCRIPTS = [
     'wallet_txn_clone.py --mineblock',
     'feature_notifications.py',
     'rpc_getblockfilter.py',
+    'rpc_addrindex.py',
     'rpc_invalidateblock.py',
     'feature_rbf.py',
     'mempool_packages.py',